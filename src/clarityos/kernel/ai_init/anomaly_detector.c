@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include "anomaly_detector.h"
+#include "system_monitor.h"
+#include "init_log.h"
+
+// What is detected on each series
+typedef struct {
+    HistoryMetric series;
+    unsigned int metric;        // METRIC_* group that refreshes the series
+    unsigned int flag;          // ANOMALY_* reported
+    int direction;              // +1: anomalous when high, -1: when low
+    double limit;               // Trend and limit target, NAN for spikes only
+    double min_deviation;       // Smaller deviations are noise, however flat the series
+    const char *name;
+} DetectorConfig;
+
+static const DetectorConfig detector_configs[] = {
+    { HISTORY_CPU_USAGE,     METRIC_CPU,       ANOMALY_HIGH_CPU,      +1, NAN,  0.10, "cpu" },
+    { HISTORY_MEMORY_USAGE,  METRIC_MEMORY,    ANOMALY_HIGH_MEMORY,   +1, 0.95, 0.05, "memory" },
+    { HISTORY_IO_USAGE,      METRIC_IO,        ANOMALY_HIGH_IO,       +1, NAN,  0.10, "io" },
+    { HISTORY_NETWORK_USAGE, METRIC_NETWORK,   ANOMALY_HIGH_NETWORK,  +1, NAN,  0.10, "network" },
+    { HISTORY_NUM_PROCESSES, METRIC_PROCESSES, ANOMALY_PROCESS_SURGE, +1, NAN,  50.0, "processes" },
+    // Only while on battery; see update_series()
+    { HISTORY_BATTERY_LEVEL, METRIC_POWER,     ANOMALY_LOW_BATTERY,   -1, 10.0, 5.0,  "battery" },
+};
+#define NUM_DETECTORS (int)(sizeof(detector_configs) / sizeof(detector_configs[0]))
+
+typedef struct {
+    double mean;
+    double variance;
+    double weight_s;            // Seconds of data seen
+} Baseline;
+
+// Streaming state of one series (monitoring thread only)
+typedef struct {
+    uint64_t last_ns;           // 0 until the first sample
+    double last_value;
+    Baseline level;
+    double rate;                // Per second
+    double rate_weight_s;
+    Baseline season[ANOMALY_SEASON_BUCKETS];
+    uint64_t reported_ns[ANOMALY_NUM_KINDS];
+    unsigned int active;        // Bit per AnomalyKind active on the previous sample
+} SeriesState;
+
+static SeriesState series_states[NUM_DETECTORS];
+
+static const char *kind_names[ANOMALY_NUM_KINDS] = { "spike", "trend", "limit" };
+
+// Queue from the monitoring thread to the decision loop (single producer,
+// single consumer)
+static AnomalyEvent event_queue[ANOMALY_EVENT_QUEUE];
+static _Atomic unsigned int queue_head;     // Next slot written
+static _Atomic unsigned int queue_tail;     // Next slot read
+static atomic_uint dropped_events;
+static int event_fd = -1;
+
+int init_anomaly_detector() {
+    memset(series_states, 0, sizeof(series_states));
+    atomic_store(&queue_head, 0);
+    atomic_store(&queue_tail, 0);
+
+    event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        log_error("Anomaly detector: eventfd: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int anomaly_event_fd() {
+    return event_fd;
+}
+
+const char *anomaly_kind_name(AnomalyKind kind) {
+    return kind >= 0 && kind < ANOMALY_NUM_KINDS ? kind_names[kind] : "unknown";
+}
+
+const char *anomaly_series_name(HistoryMetric series) {
+    for (int i = 0; i < NUM_DETECTORS; i++) {
+        if (detector_configs[i].series == series) return detector_configs[i].name;
+    }
+    return "unknown";
+}
+
+// Time-weighted EWMA update of a mean and variance (West's incremental
+// form), with alpha = 1 - exp(-dt / tau) so that adaptive sampling does not
+// change the time constant
+static void baseline_update(Baseline *baseline, double value, double dt, double tau) {
+    if (baseline->weight_s == 0.0) {
+        baseline->mean = value;
+        baseline->variance = 0.0;
+    } else {
+        double alpha = 1.0 - exp(-dt / tau);
+        double diff = value - baseline->mean;
+        double increment = alpha * diff;
+        baseline->mean += increment;
+        baseline->variance = (1.0 - alpha) * (baseline->variance + diff * increment);
+    }
+    baseline->weight_s += dt;
+}
+
+// Deviation of value from baseline in its anomalous direction, in standard
+// deviations; 0 unless it also exceeds min_deviation
+static double baseline_score(const Baseline *baseline, const DetectorConfig *config, double value) {
+    double deviation = (value - baseline->mean) * config->direction;
+    if (deviation < config->min_deviation) return 0.0;
+    double stddev = sqrt(baseline->variance);
+    return stddev > 0.0 ? deviation / stddev : INFINITY;
+}
+
+// Fill event with the anomaly to report for this sample, if any; kinds gets
+// a bit per AnomalyKind present
+static void detect_series(const DetectorConfig *config, SeriesState *state, double value, int bucket,
+                          AnomalyEvent *event, unsigned int *kinds) {
+    *kinds = 0;
+
+    double score = state->level.weight_s >= ANOMALY_WARMUP_S ? baseline_score(&state->level, config, value) : 0.0;
+    const Baseline *season = &state->season[bucket];
+    int seasonal = season->weight_s >= ANOMALY_SEASON_WARMUP_S;
+    if (score >= ANOMALY_SPIKE_SIGMA &&
+        (!seasonal || baseline_score(season, config, value) >= ANOMALY_SEASON_SIGMA)) {
+        *kinds |= 1u << ANOMALY_KIND_SPIKE;
+        event->kind = ANOMALY_KIND_SPIKE;
+        event->expected = seasonal ? season->mean : state->level.mean;
+        event->score = score;
+    }
+
+    if (isnan(config->limit)) return;
+
+    double remaining = (config->limit - value) * config->direction;
+    double rate = state->rate * config->direction;
+    if (remaining <= 0.0) {
+        *kinds |= 1u << ANOMALY_KIND_LIMIT;
+        event->kind = ANOMALY_KIND_LIMIT;
+        event->expected = config->limit;
+        event->score = 0.0;
+    } else if (state->rate_weight_s >= ANOMALY_RATE_TAU_S && rate > 0.0 &&
+               remaining / rate < ANOMALY_TREND_HORIZON_S) {
+        *kinds |= 1u << ANOMALY_KIND_TREND;
+        if (!(*kinds & (1u << ANOMALY_KIND_SPIKE))) {
+            event->kind = ANOMALY_KIND_TREND;
+            event->expected = config->limit;
+            event->score = remaining / rate;
+        }
+    }
+}
+
+// Feed one new sample; returns 1 and fills event if a new anomaly should be
+// reported
+static int update_series(const DetectorConfig *config, SeriesState *state, const SystemState *sample,
+                         int bucket, uint64_t now_ns, unsigned int *anomalies, AnomalyEvent *event) {
+    double value = state_metric_value(sample, config->series);
+    if (config->series == HISTORY_BATTERY_LEVEL) {
+        if (sample->on_ac_power) {
+            // Charging is not a trend to project
+            memset(state, 0, sizeof(*state));
+            return 0;
+        }
+    }
+
+    if (state->last_ns == 0 || now_ns <= state->last_ns) {
+        state->last_ns = now_ns;
+        state->last_value = value;
+        baseline_update(&state->level, value, 0.0, ANOMALY_LEVEL_TAU_S);
+        return 0;
+    }
+
+    double dt = (double)(now_ns - state->last_ns) / 1e9;
+
+    // Rate of change: an EWMA of the per-sample slope, weighted by time
+    double slope = (value - state->last_value) / dt;
+    double rate_alpha = 1.0 - exp(-dt / ANOMALY_RATE_TAU_S);
+    state->rate = state->rate_weight_s == 0.0 ? slope : state->rate + rate_alpha * (slope - state->rate);
+    state->rate_weight_s += dt;
+
+    // Detect against the baselines before the sample is folded into them,
+    // so a spike does not hide itself
+    memset(event, 0, sizeof(*event));
+    event->kind = ANOMALY_NUM_KINDS;
+    unsigned int kinds;
+    detect_series(config, state, value, bucket, event, &kinds);
+
+    baseline_update(&state->level, value, dt, ANOMALY_LEVEL_TAU_S);
+    baseline_update(&state->season[bucket], value, dt, ANOMALY_SEASON_TAU_S);
+    state->last_ns = now_ns;
+    state->last_value = value;
+
+    if (kinds) *anomalies |= config->flag;
+
+    // Report an anomaly when it starts, then every ANOMALY_REFIRE_MS while
+    // it persists
+    int report = 0;
+    if (event->kind != ANOMALY_NUM_KINDS) {
+        uint64_t *reported = &state->reported_ns[event->kind];
+        if (!(state->active & (1u << event->kind)) ||
+            now_ns >= *reported + (uint64_t)ANOMALY_REFIRE_MS * 1000000ull) {
+            *reported = now_ns;
+            report = 1;
+        }
+    }
+    state->active = kinds;
+
+    if (!report) return 0;
+    event->timestamp_ns = now_ns;
+    event->flag = config->flag;
+    event->series = config->series;
+    event->value = value;
+    return 1;
+}
+
+// Hour of day of the sample, in local time
+static int season_bucket(time_t timestamp) {
+    struct tm local;
+    if (timestamp == 0 || !localtime_r(&timestamp, &local)) return 0;
+    return local.tm_hour * ANOMALY_SEASON_BUCKETS / 24;
+}
+
+// Feed the current value of the series refreshed by the METRIC_* groups in
+// metrics. The history only holds one row per STATE_HISTORY_INTERVAL_MS, so
+// the published state is read instead. New anomalies are written to events (up to
+// max_events); returns the ANOMALY_* flags active on this sample.
+unsigned int anomaly_detector_update(unsigned int metrics, uint64_t now_ns, AnomalyEvent *events,
+                                     int max_events, int *num_events) {
+    unsigned int anomalies = 0;
+    SystemState sample = get_current_system_state();
+    int bucket = season_bucket(sample.last_update_time);
+
+    *num_events = 0;
+    for (int i = 0; i < NUM_DETECTORS; i++) {
+        const DetectorConfig *config = &detector_configs[i];
+        if (!(config->metric & metrics)) continue;
+
+        AnomalyEvent event;
+        if (update_series(config, &series_states[i], &sample, bucket, now_ns, &anomalies, &event) &&
+            *num_events < max_events) {
+            events[(*num_events)++] = event;
+        }
+    }
+    return anomalies;
+}
+
+// Producer side (monitoring thread): queue events and wake the decision loop
+void anomaly_queue_events(const AnomalyEvent *events, int count) {
+    if (count == 0) return;
+
+    unsigned int head = atomic_load_explicit(&queue_head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_acquire);
+    for (int i = 0; i < count; i++) {
+        if (head - tail == ANOMALY_EVENT_QUEUE) {
+            atomic_fetch_add_explicit(&dropped_events, (unsigned int)(count - i), memory_order_relaxed);
+            break;
+        }
+        event_queue[head % ANOMALY_EVENT_QUEUE] = events[i];
+        head++;
+    }
+    atomic_store_explicit(&queue_head, head, memory_order_release);
+
+    uint64_t one = 1;
+    if (event_fd >= 0 && write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        log_error("Anomaly detector: eventfd: %s", strerror(errno));
+    }
+}
+
+// Consumer side (decision loop): clear the eventfd and take up to
+// max_events queued events. Returns the number taken.
+int anomaly_poll_events(AnomalyEvent *events, int max_events) {
+    uint64_t counter;
+    if (event_fd >= 0 && read(event_fd, &counter, sizeof(counter)) < 0 && errno != EAGAIN) {
+        log_error("Anomaly detector: eventfd: %s", strerror(errno));
+    }
+
+    unsigned int tail = atomic_load_explicit(&queue_tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&queue_head, memory_order_acquire);
+    int count = 0;
+    while (tail != head && count < max_events) {
+        events[count++] = event_queue[tail % ANOMALY_EVENT_QUEUE];
+        tail++;
+    }
+    atomic_store_explicit(&queue_tail, tail, memory_order_release);
+
+    // Left unread: wake the loop again for the rest
+    uint64_t one = 1;
+    if (tail != head && event_fd >= 0 && write(event_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        log_error("Anomaly detector: eventfd: %s", strerror(errno));
+    }
+
+    unsigned int dropped = atomic_exchange_explicit(&dropped_events, 0, memory_order_relaxed);
+    if (dropped) log_warn("Anomaly detector: %u events dropped, decision loop behind", dropped);
+    return count;
+}
@@ -0,0 +1,63 @@
+#ifndef ANOMALY_DETECTOR_H
+#define ANOMALY_DETECTOR_H
+
+#include <stdint.h>
+#include "state_history.h"
+
+// Streaming anomaly detection over the state history
+//
+// Each detected series keeps a time-weighted EWMA of its level and
+// variance, an EWMA of its rate of change, and a level and variance per
+// hour of day (its seasonal baseline). Every sample updates them in O(1),
+// with no allocation. A sample is anomalous when:
+//   spike  it deviates from the level by ANOMALY_SPIKE_SIGMA standard
+//          deviations, and from the hour's baseline by ANOMALY_SEASON_SIGMA
+//          once that baseline has ANOMALY_SEASON_WARMUP_S of data (a nightly
+//          job is not an anomaly once it has been seen)
+//   trend  at the current rate of change, it reaches the series' limit
+//          within ANOMALY_TREND_HORIZON_S (a leak is reported minutes before
+//          the memory runs out)
+//   limit  it is already at or past the limit
+// Anomalies are reported as AnomalyEvents through a queue read by the
+// decision loop, which an eventfd wakes as soon as one is queued.
+
+#define ANOMALY_LEVEL_TAU_S 60.0            // Time constant of the level and variance
+#define ANOMALY_RATE_TAU_S 300.0            // Time constant of the rate of change
+#define ANOMALY_SEASON_TAU_S 7200.0         // In-bucket time constant of the seasonal baselines
+#define ANOMALY_SEASON_BUCKETS 24           // One per hour of day
+#define ANOMALY_WARMUP_S 60.0               // Of data before spikes are reported
+#define ANOMALY_SEASON_WARMUP_S 1800.0      // Of data in an hour before its baseline is used
+#define ANOMALY_SPIKE_SIGMA 4.0
+#define ANOMALY_SEASON_SIGMA 3.0
+#define ANOMALY_TREND_HORIZON_S 600.0
+#define ANOMALY_REFIRE_MS 30000             // A persisting anomaly is reported again after this
+#define ANOMALY_EVENT_QUEUE 64              // Power of two; events past it are dropped
+
+typedef enum {
+    ANOMALY_KIND_SPIKE,
+    ANOMALY_KIND_TREND,
+    ANOMALY_KIND_LIMIT,
+    ANOMALY_NUM_KINDS
+} AnomalyKind;
+
+typedef struct {
+    uint64_t timestamp_ns;      // CLOCK_MONOTONIC
+    unsigned int flag;          // ANOMALY_* of the series
+    AnomalyKind kind;
+    HistoryMetric series;
+    double value;
+    double expected;            // Spike: the baseline; trend and limit: the limit
+    double score;               // Spike: standard deviations; trend: seconds to the limit
+} AnomalyEvent;
+
+// Function prototypes
+int init_anomaly_detector();
+unsigned int anomaly_detector_update(unsigned int metrics, uint64_t now_ns, AnomalyEvent *events,
+                                     int max_events, int *num_events);
+void anomaly_queue_events(const AnomalyEvent *events, int count);
+int anomaly_event_fd();
+int anomaly_poll_events(AnomalyEvent *events, int max_events);
+const char *anomaly_kind_name(AnomalyKind kind);
+const char *anomaly_series_name(HistoryMetric series);
+
+#endif /* ANOMALY_DETECTOR_H */
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "system_state.h"
+#include "learning_engine.h"
+#include "resource_governor.h"
+#include "learning_log.h"
+#include "latency_stats.h"
+#include "init_log.h"
+
+// Decision replay harness
+//
+// Feeds a recorded trace of system and hardware states through the periodic decision
+// pipeline: the resource policy and process adjustment heads, as
+// generate_resource_policy() and get_process_adjustments() compute them,
+// batched into one run_decision_heads() call like the decision loop does.
+// It then reports throughput and the per-decision latency distribution,
+// followed by the per-stage histograms the pipeline recorded.
+//
+// The trace is a learning log, whose STATE records are replayed in order
+// with the hardware state of the HARDWARE records that follow them.
+// Without one, a synthetic random-walk trace of REPLAY_SYNTHETIC_STATES
+// states is used, so the harness runs anywhere.
+
+#define REPLAY_SYNTHETIC_STATES 20000
+#define REPLAY_MAX_STATES 1000000
+#define REPLAY_SYNTHETIC_CPUS 8
+
+typedef struct {
+    SystemState state;
+    HardwareState hardware;
+} ReplaySample;
+
+static int load_trace(const char *path, ReplaySample *samples, int max) {
+    LearningLogReader reader;
+    if (open_learning_log_reader(path, &reader) < 0) {
+        fprintf(stderr, "Cannot read trace %s\n", path);
+        return -1;
+    }
+
+    int n = 0;
+    uint64_t state_ns = 0;
+    const LearningRecord *records;
+    int num_records;
+    while ((records = learning_log_next_chunk(&reader, &num_records))) {
+        for (int i = 0; i < num_records; i++) {
+            if (records[i].type == LOG_RECORD_STATE && n < max) {
+                samples[n].state = learning_record_state(&records[i], &samples[n].hardware);
+                state_ns = records[i].timestamp_ns;
+                n++;
+            } else if (records[i].type == LOG_RECORD_HARDWARE && n > 0 && records[i].timestamp_ns == state_ns) {
+                learning_record_hardware(&records[i], &samples[n - 1].hardware);
+            }
+        }
+    }
+    close_learning_log_reader(&reader);
+    return n;
+}
+
+static double clamp_unit(double value) {
+    return value < 0.0 ? 0.0 : value > 1.0 ? 1.0 : value;
+}
+
+static int synthesize_trace(ReplaySample *samples, int n) {
+    SystemState state;
+    memset(&state, 0, sizeof(state));
+    state.cpu_usage = 0.2;
+    state.memory_usage = 0.4;
+    state.num_processes = 150;
+    state.battery_level = 100.0;
+    state.on_ac_power = 1;
+
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        state.last_update_time = i;
+        state.cpu_usage = clamp_unit(state.cpu_usage + (rand() % 201 - 100) / 2000.0);
+        state.memory_usage = clamp_unit(state.memory_usage + (rand() % 201 - 100) / 10000.0);
+        state.io_usage = clamp_unit(state.io_usage + (rand() % 201 - 100) / 4000.0);
+        state.network_usage = clamp_unit(state.network_usage + (rand() % 201 - 100) / 4000.0);
+        state.num_processes += rand() % 5 - 2;
+        samples[i].state = state;
+
+        // Cores scattered around the overall load
+        HardwareState *hardware = &samples[i].hardware;
+        memset(hardware, 0, sizeof(*hardware));
+        hardware->num_cpus = REPLAY_SYNTHETIC_CPUS;
+        for (int c = 0; c < REPLAY_SYNTHETIC_CPUS; c++) {
+            hardware->core_usage[c] = (float)clamp_unit(state.cpu_usage + (rand() % 201 - 100) / 1000.0);
+        }
+        hardware->psi_cpu_some = (float)(state.cpu_usage > 0.8 ? (state.cpu_usage - 0.8) * 100.0 : 0.0);
+        hardware->cpufreq_mean_ratio = hardware->cpufreq_min_ratio = 1.0f;
+        hardware->thermal_max_celsius = (float)(40.0 + 40.0 * state.cpu_usage);
+    }
+    return n;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+int main(int argc, char **argv) {
+    set_log_level(LOG_LEVEL_WARN);
+
+    ReplaySample *samples = malloc(sizeof(ReplaySample) * REPLAY_MAX_STATES);
+    if (!samples) return EXIT_FAILURE;
+
+    int n = argc > 1 ? load_trace(argv[1], samples, REPLAY_MAX_STATES)
+                     : synthesize_trace(samples, REPLAY_SYNTHETIC_STATES);
+    if (n <= 0) {
+        fprintf(stderr, "No states to replay\n");
+        return EXIT_FAILURE;
+    }
+
+    init_learning_engine();
+
+    uint64_t *latencies = malloc(sizeof(uint64_t) * (size_t)n);
+    if (!latencies) return EXIT_FAILURE;
+
+    uint64_t start = latency_now();
+    for (int i = 0; i < n; i++) {
+        uint64_t decision_start = latency_now();
+
+        static DecisionResult decisions;
+        run_decision_heads(samples[i].state, &samples[i].hardware,
+                           DECISION_RESOURCE_POLICY | DECISION_PROCESS_ADJUST, &decisions);
+
+        latencies[i] = latency_now() - decision_start;
+    }
+    double elapsed = (latency_now() - start) / 1e9;
+
+    qsort(latencies, (size_t)n, sizeof(uint64_t), compare_u64);
+    printf("%s: %d decisions in %.3f s, %.0f decisions/s\n",
+           argc > 1 ? argv[1] : "synthetic trace", n, elapsed, n / elapsed);
+    printf("decision latency: p50 %.1f us, p99 %.1f us, max %.1f us\n",
+           latencies[n / 2] / 1e3, latencies[(int)((n - 1) * 0.99)] / 1e3, latencies[n - 1] / 1e3);
+
+    for (int s = 0; s < NUM_LATENCY_STAGES; s++) {
+        if (latency_count(s) == 0) continue;
+        printf("  %-20s p50 %8.1f us  p99 %8.1f us  max %8.1f us  (%llu)\n", latency_stage_name(s),
+               latency_percentile(s, 50.0) / 1e3, latency_percentile(s, 99.0) / 1e3,
+               latency_max(s) / 1e3, (unsigned long long)latency_count(s));
+    }
+
+    shutdown_learning_log();
+    free(latencies);
+    free(samples);
+    return EXIT_SUCCESS;
+}
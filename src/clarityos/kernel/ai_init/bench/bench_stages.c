@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "system_state.h"
+#include "learning_engine.h"
+#include "model_runtime.h"
+#include "native_model.h"
+#include "resource_governor.h"
+#include "learning_log.h"
+#include "latency_stats.h"
+#include "init_log.h"
+
+// Per-stage microbenchmarks
+//
+// Each benchmark runs BENCH_BATCHES batches after a warm-up batch and reports
+// the mean and the best batch in ns per operation. The best batch is the
+// number to compare across builds; the mean also shows scheduling noise.
+// Cgroup knobs and the learning log live under BENCH_DIR (see the Makefile).
+
+#define BENCH_BATCHES 10
+#define BENCH_NATIVE_HIDDEN 64
+
+typedef void (*BenchFn)(void *arg);
+
+// settle, if given, runs untimed after every batch
+static void run_bench_settled(const char *name, BenchFn fn, BenchFn settle, void *arg, int iterations) {
+    int batch = iterations / BENCH_BATCHES;
+    if (batch < 1) batch = 1;
+
+    for (int i = 0; i < batch; i++) fn(arg);
+    if (settle) settle(arg);
+
+    uint64_t total = 0;
+    uint64_t best = UINT64_MAX;
+    for (int b = 0; b < BENCH_BATCHES; b++) {
+        uint64_t start = latency_now();
+        for (int i = 0; i < batch; i++) fn(arg);
+        uint64_t elapsed = latency_now() - start;
+        total += elapsed;
+        if (elapsed < best) best = elapsed;
+        if (settle) settle(arg);
+    }
+
+    printf("%-24s %10.1f ns/op mean %10.1f ns/op best   (%d ops)\n", name,
+           (double)total / ((double)batch * BENCH_BATCHES), (double)best / batch, batch * BENCH_BATCHES);
+}
+
+static void run_bench(const char *name, BenchFn fn, void *arg, int iterations) {
+    run_bench_settled(name, fn, NULL, arg, iterations);
+}
+
+static void bench_parse_cpu(void *arg) { (void)arg; get_cpu_usage(); }
+static void bench_parse_memory(void *arg) { (void)arg; get_memory_usage(); }
+static void bench_parse_io(void *arg) { (void)arg; get_io_usage(); }
+static void bench_parse_network(void *arg) { (void)arg; get_network_usage(); }
+static void bench_parse_processes(void *arg) { (void)arg; count_processes(); }
+static void bench_parse_hardware(void *arg) { update_hardware_state(arg); }
+
+// Publishes the working state without sampling anything
+static void bench_state_publish(void *arg) { (void)arg; update_system_state_metrics(0); }
+static void bench_state_read(void *arg) { (void)arg; get_current_system_state(); }
+
+static void bench_tensor_build(void *arg) {
+    SystemState state;
+    HardwareState hardware;
+    get_published_state(&state, &hardware);
+    create_system_state_tensor(arg, state, &hardware);
+}
+
+static void bench_inference(void *arg) {
+    ModelHandle *model = arg;
+    run_model_inference(model, &model->input);
+}
+
+static ProcessTableView bench_processes;
+
+static void bench_policy_diff(void *arg) { apply_resource_policy(arg, &bench_processes); }
+
+static void bench_log_append(void *arg) { learning_log_append(LOG_PRODUCER_MAIN, arg); }
+
+// Lets the writer empty the queue, so the next batch measures appends
+// rather than drops
+static void drain_log(void *arg) {
+    (void)arg;
+    while (learning_log_pending(LOG_PRODUCER_MAIN) > 0) usleep(1000);
+}
+
+// A two-layer MLP over the state tensor, the shape a native head would have
+static int write_native_model(const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return -1;
+
+    NativeModelHeader header = { NATIVE_MODEL_MAGIC, NATIVE_MODEL_VERSION, NATIVE_MODEL_MLP,
+                                 SYSTEM_STATE_TENSOR_SIZE, SYSTEM_STATE_TENSOR_SIZE * 2, 2, 0 };
+    fwrite(&header, sizeof(header), 1, file);
+
+    uint32_t widths[] = { SYSTEM_STATE_TENSOR_SIZE, BENCH_NATIVE_HIDDEN, SYSTEM_STATE_TENSOR_SIZE * 2 };
+    for (int l = 0; l < 2; l++) {
+        NativeLayerHeader layer = { widths[l + 1], widths[l],
+                                    l == 0 ? NATIVE_ACTIVATION_RELU : NATIVE_ACTIVATION_SIGMOID, 0 };
+        fwrite(&layer, sizeof(layer), 1, file);
+        for (uint32_t i = 0; i < layer.rows * layer.cols + layer.rows; i++) {
+            float weight = (float)((i * 7919) % 200) / 1000.0f - 0.1f;
+            fwrite(&weight, sizeof(weight), 1, file);
+        }
+    }
+
+    return fclose(file);
+}
+
+// Stand-in cgroup knob files, so the governor's diffing runs against open fds
+static void prepare_cgroup(const char *name) {
+    static const char *knobs[] = { "cpu.max", "memory.high", "memory.max", "io.weight",
+                                   "cpuset.mems", "cpuset.cpus" };
+    char path[512];
+
+    snprintf(path, sizeof(path), "%s/%s", RESOURCE_CGROUP_ROOT, name);
+    mkdir(RESOURCE_CGROUP_ROOT, 0755);
+    mkdir(path, 0755);
+    for (int k = 0; k < (int)(sizeof(knobs) / sizeof(knobs[0])); k++) {
+        snprintf(path, sizeof(path), "%s/%s/%s", RESOURCE_CGROUP_ROOT, name, knobs[k]);
+        int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) close(fd);
+    }
+}
+
+int main(int argc, char **argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 100000;
+    if (iterations <= 0) iterations = 100000;
+
+    set_log_level(LOG_LEVEL_WARN);
+    init_system_state();
+    init_model_runtime();
+
+    run_bench("parse_cpu", bench_parse_cpu, NULL, iterations / 10);
+    run_bench("parse_memory", bench_parse_memory, NULL, iterations / 10);
+    run_bench("parse_io", bench_parse_io, NULL, iterations / 10);
+    run_bench("parse_network", bench_parse_network, NULL, iterations / 10);
+    run_bench("parse_processes", bench_parse_processes, NULL, iterations / 10);
+    static HardwareState hardware;
+    run_bench("parse_hardware", bench_parse_hardware, &hardware, iterations / 10);
+
+    run_bench("state_publish", bench_state_publish, NULL, iterations);
+    run_bench("state_read", bench_state_read, NULL, iterations);
+
+    // The dummy backend needs no model file
+    ModelHandle *dummy_model = load_model(BENCH_DIR "/dummy_model.onnx");
+    if (dummy_model) {
+        run_bench("tensor_build", bench_tensor_build, dummy_model, iterations);
+        run_bench("inference_dummy", bench_inference, dummy_model, iterations);
+    }
+
+    ModelHandle *native_model = NULL;
+    if (write_native_model(BENCH_DIR "/bench_model" NATIVE_MODEL_SUFFIX) == 0) {
+        native_model = load_model(BENCH_DIR "/bench_model" NATIVE_MODEL_SUFFIX);
+    }
+    if (native_model && native_model->backend == MODEL_BACKEND_NATIVE) {
+        run_bench("inference_native", bench_inference, native_model, iterations);
+    }
+
+    // ONNX needs a real model: BENCH_ONNX_MODEL=/path/to/model.onnx
+    const char *onnx_path = getenv("BENCH_ONNX_MODEL");
+    ModelHandle *onnx_model = onnx_path && model_runtime_has_onnx() ? load_model(onnx_path) : NULL;
+    if (onnx_model && onnx_model->backend == MODEL_BACKEND_ONNX) {
+        run_bench("inference_onnx", bench_inference, onnx_model, iterations / 10);
+    }
+
+    // After the first call every knob is cached, so this is the pure diff
+    register_decision_processes();
+    update_process_view(&bench_processes);
+    static DecisionResult decisions;
+    tensor_to_resource_policy(NULL, &decisions);
+    ResourcePolicy *policy = &decisions.policy;
+    for (int i = 0; i < policy->num_processes; i++) {
+        prepare_cgroup(process_name(policy->process_policies[i].process));
+    }
+    if (init_resource_governor() == 0) {
+        run_bench("policy_diff", bench_policy_diff, policy, iterations);
+        shutdown_resource_governor();
+    }
+
+    if (init_learning_log(LEARNING_LOG_PATH) == 0) {
+        LearningRecord record;
+        memset(&record, 0, sizeof(record));
+        record.type = LOG_RECORD_STATE;
+        uint64_t dropped = learning_log_dropped();
+        // A batch must fit in the queue
+        int log_iterations = iterations < (LOG_QUEUE_CAPACITY - 1) * BENCH_BATCHES
+                             ? iterations : (LOG_QUEUE_CAPACITY - 1) * BENCH_BATCHES;
+        run_bench_settled("log_append", bench_log_append, drain_log, &record, log_iterations);
+        shutdown_learning_log();
+        printf("%-24s %10llu records dropped (queue full)\n", "log_append",
+               (unsigned long long)(learning_log_dropped() - dropped));
+    }
+
+    if (native_model) unload_model(native_model);
+    if (dummy_model) unload_model(dummy_model);
+    if (onnx_model) unload_model(onnx_model);
+    return 0;
+}
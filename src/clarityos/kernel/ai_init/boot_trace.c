@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "boot_trace.h"
+#include "learning_log.h"
+#include "init_log.h"
+
+typedef struct {
+    char name[64];
+    uint64_t start_ns;
+    uint64_t end_ns;            // 0 while open
+} BootSpan;
+
+typedef struct {
+    uint64_t events[NUM_BOOT_EVENTS];   // CLOCK_MONOTONIC, 0 if not seen
+    ProcessId released_by;
+    int critical;
+} ProcessTrace;
+
+// Spans may be opened by any thread (models load on first use); process
+// events come from the main thread only
+static pthread_mutex_t span_lock = PTHREAD_MUTEX_INITIALIZER;
+static BootSpan spans[BOOT_TRACE_MAX_SPANS];
+static int num_spans = 0;
+
+static ProcessTrace processes[MAX_MANAGED_PROCESSES];
+static int processes_initialized = 0;
+
+static atomic_int trace_finished = 0;
+
+// Pseudo-pids grouping the tracks in the viewer
+#define TRACE_PID_INIT      1
+#define TRACE_PID_PROCESSES 2
+#define TRACE_PID_CRITICAL  3
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int boot_trace_begin(const char *name) {
+    if (atomic_load(&trace_finished)) return -1;
+
+    pthread_mutex_lock(&span_lock);
+    int span = num_spans < BOOT_TRACE_MAX_SPANS ? num_spans++ : -1;
+    if (span >= 0) {
+        snprintf(spans[span].name, sizeof(spans[span].name), "%s", name);
+        spans[span].start_ns = monotonic_ns();
+        spans[span].end_ns = 0;
+    }
+    pthread_mutex_unlock(&span_lock);
+    return span;
+}
+
+void boot_trace_end(int span) {
+    if (span < 0) return;
+
+    pthread_mutex_lock(&span_lock);
+    spans[span].end_ns = monotonic_ns();
+    pthread_mutex_unlock(&span_lock);
+}
+
+static void init_process_traces() {
+    if (processes_initialized) return;
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) processes[i].released_by = PROCESS_ID_NONE;
+    processes_initialized = 1;
+}
+
+static ProcessTrace *get_trace(ProcessId process) {
+    if (atomic_load(&trace_finished) || process < 0 || process >= MAX_MANAGED_PROCESSES) return NULL;
+    init_process_traces();
+    return &processes[process];
+}
+
+void boot_trace_process(ProcessId process, BootTraceEvent event) {
+    ProcessTrace *trace = get_trace(process);
+    if (trace && !trace->events[event]) trace->events[event] = monotonic_ns();
+}
+
+void boot_trace_released_by(ProcessId process, ProcessId dependency) {
+    ProcessTrace *trace = get_trace(process);
+    if (trace && trace->released_by == PROCESS_ID_NONE) trace->released_by = dependency;
+}
+
+// Trace origin: the earliest timestamp recorded
+static uint64_t trace_origin() {
+    uint64_t origin = UINT64_MAX;
+    for (int s = 0; s < num_spans; s++) {
+        if (spans[s].start_ns < origin) origin = spans[s].start_ns;
+    }
+    for (int p = 0; p < process_table_size(); p++) {
+        for (int e = 0; e < NUM_BOOT_EVENTS; e++) {
+            if (processes[p].events[e] && processes[p].events[e] < origin) origin = processes[p].events[e];
+        }
+    }
+    return origin;
+}
+
+// Walk back from the process that became ready last. Returns that process.
+static ProcessId mark_critical_path(int *length) {
+    ProcessId last = PROCESS_ID_NONE;
+    for (int p = 0; p < process_table_size(); p++) {
+        uint64_t ready = processes[p].events[BOOT_EVENT_READY];
+        if (ready && (last == PROCESS_ID_NONE || ready > processes[last].events[BOOT_EVENT_READY])) last = p;
+    }
+
+    *length = 0;
+    for (ProcessId p = last; p != PROCESS_ID_NONE && !processes[p].critical; p = processes[p].released_by) {
+        processes[p].critical = 1;
+        (*length)++;
+    }
+    return last;
+}
+
+static void write_json_string(FILE *file, const char *s) {
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fprintf(file, "\\%c", *s);
+        } else if ((unsigned char)*s < 0x20) {
+            fprintf(file, "\\u%04x", *s);
+        } else {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void write_metadata(FILE *file, const char *kind, int pid, int tid, const char *name) {
+    fprintf(file, ",\n{\"ph\":\"M\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", kind, pid, tid);
+    write_json_string(file, name);
+    fprintf(file, "}}");
+}
+
+static void write_span(FILE *file, const char *name, int pid, int tid, uint64_t origin,
+                       uint64_t start_ns, uint64_t end_ns, int critical) {
+    if (!start_ns || end_ns < start_ns) return;
+    fprintf(file, ",\n{\"ph\":\"X\",\"name\":");
+    write_json_string(file, name);
+    fprintf(file, ",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", pid, tid,
+            (start_ns - origin) / 1e3, (end_ns - start_ns) / 1e3);
+    if (critical) fprintf(file, ",\"args\":{\"critical\":true}");
+    fprintf(file, "}");
+}
+
+static void write_instant(FILE *file, const char *name, int pid, int tid, uint64_t origin, uint64_t ns) {
+    if (!ns) return;
+    fprintf(file, ",\n{\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}",
+            name, pid, tid, (ns - origin) / 1e3);
+}
+
+static int export_trace(const char *path, uint64_t origin) {
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        mkdir(dir, 0755);
+    }
+
+    FILE *file = fopen(path, "we");
+    if (!file) {
+        log_error("Boot trace: cannot write %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"args\":{\"name\":\"ai_init\"}}",
+            TRACE_PID_INIT);
+    write_metadata(file, "process_name", TRACE_PID_PROCESSES, 0, "services");
+    write_metadata(file, "process_name", TRACE_PID_CRITICAL, 0, "critical path");
+
+    uint64_t now = monotonic_ns();
+    for (int s = 0; s < num_spans; s++) {
+        write_span(file, spans[s].name, TRACE_PID_INIT, 0, origin, spans[s].start_ns,
+                   spans[s].end_ns ? spans[s].end_ns : now, 0);
+    }
+
+    for (ProcessId p = 0; p < process_table_size(); p++) {
+        ProcessTrace *trace = &processes[p];
+        uint64_t *ev = trace->events;
+        if (!ev[BOOT_EVENT_QUEUED] && !ev[BOOT_EVENT_SPAWN]) continue;
+
+        int tid = p + 1;
+        uint64_t end = ev[BOOT_EVENT_READY] ? ev[BOOT_EVENT_READY] : ev[BOOT_EVENT_FAILED];
+        write_metadata(file, "thread_name", TRACE_PID_PROCESSES, tid, process_name(p));
+        write_span(file, "queued", TRACE_PID_PROCESSES, tid, origin, ev[BOOT_EVENT_QUEUED],
+                   ev[BOOT_EVENT_SPAWN] ? ev[BOOT_EVENT_SPAWN] : end, trace->critical);
+        write_span(file, "starting", TRACE_PID_PROCESSES, tid, origin, ev[BOOT_EVENT_SPAWN],
+                   end, trace->critical);
+        write_instant(file, "ready", TRACE_PID_PROCESSES, tid, origin, ev[BOOT_EVENT_READY]);
+        write_instant(file, "first heartbeat", TRACE_PID_PROCESSES, tid, origin, ev[BOOT_EVENT_HEARTBEAT]);
+        write_instant(file, "failed", TRACE_PID_PROCESSES, tid, origin, ev[BOOT_EVENT_FAILED]);
+
+        if (trace->critical) {
+            uint64_t start = ev[BOOT_EVENT_QUEUED] ? ev[BOOT_EVENT_QUEUED] : ev[BOOT_EVENT_SPAWN];
+            write_span(file, process_name(p), TRACE_PID_CRITICAL, 0, origin, start, end, 1);
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) {
+        log_error("Boot trace: cannot write %s: %s", path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// One outcome record per booted process, plus one for the critical path,
+// so the boot model can be trained on time to ready
+static void log_process_outcomes(uint64_t origin, ProcessId last, int length) {
+    for (ProcessId p = 0; p < process_table_size(); p++) {
+        const uint64_t *ev = processes[p].events;
+        if (!ev[BOOT_EVENT_SPAWN] || !ev[BOOT_EVENT_READY]) continue;
+
+        uint64_t queued = ev[BOOT_EVENT_QUEUED] ? ev[BOOT_EVENT_QUEUED] : ev[BOOT_EVENT_SPAWN];
+        float values[] = {
+            (float)p,
+            (float)((ev[BOOT_EVENT_SPAWN] - queued) / 1e9),
+            (float)((ev[BOOT_EVENT_READY] - ev[BOOT_EVENT_SPAWN]) / 1e9),
+            (float)((ev[BOOT_EVENT_READY] - origin) / 1e9),
+            (float)processes[p].critical
+        };
+        learning_log_event(LOG_PRODUCER_MAIN, LOG_RECORD_OUTCOME, LOG_OUTCOME_PROCESS_READY, values, 5);
+    }
+
+    if (last != PROCESS_ID_NONE) {
+        float values[] = {
+            (float)((processes[last].events[BOOT_EVENT_READY] - origin) / 1e9),
+            (float)length,
+            (float)last
+        };
+        learning_log_event(LOG_PRODUCER_MAIN, LOG_RECORD_OUTCOME, LOG_OUTCOME_CRITICAL_PATH, values, 3);
+    }
+}
+
+int finish_boot_trace(const char *path) {
+    if (atomic_exchange(&trace_finished, 1)) return 0;
+
+    // No span is opened from now on; ends are held off until the export is done
+    pthread_mutex_lock(&span_lock);
+    init_process_traces();
+    uint64_t origin = trace_origin();
+    if (origin == UINT64_MAX) {
+        pthread_mutex_unlock(&span_lock);
+        return 0;
+    }
+
+    int length;
+    ProcessId last = mark_critical_path(&length);
+    if (last != PROCESS_ID_NONE) {
+        log_info("Boot: critical path of %d processes, %s ready after %.3f s", length,
+                 process_name(last), (processes[last].events[BOOT_EVENT_READY] - origin) / 1e9);
+    }
+
+    log_process_outcomes(origin, last, length);
+    int rc = export_trace(path, origin);
+    pthread_mutex_unlock(&span_lock);
+    return rc;
+}
@@ -0,0 +1,38 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include "process_manager.h"
+
+// Boot timeline
+//
+// Records ai_init's own startup phases as spans, and the first occurrence of
+// each lifecycle event of every process. Each process also remembers the
+// dependency whose completion released it. Walking those links back from
+// the last process to become ready gives the critical path that boot
+// actually took. finish_boot_trace() exports everything as Chrome trace
+// JSON (loadable in Perfetto or chrome://tracing), logs the per-process
+// timings to the learning log, and stops recording.
+
+#ifndef BOOT_TRACE_PATH
+#define BOOT_TRACE_PATH "/run/ai_init/boot_trace.json"
+#endif
+
+#define BOOT_TRACE_MAX_SPANS 64
+
+typedef enum {
+    BOOT_EVENT_QUEUED,          // Dependencies satisfied, waiting for a start slot
+    BOOT_EVENT_SPAWN,
+    BOOT_EVENT_READY,           // READY=1, spawned (non-notify), or exited with 0
+    BOOT_EVENT_HEARTBEAT,       // First WATCHDOG=1
+    BOOT_EVENT_FAILED,          // Failed or skipped
+    NUM_BOOT_EVENTS
+} BootTraceEvent;
+
+// Function prototypes
+int boot_trace_begin(const char *name);
+void boot_trace_end(int span);
+void boot_trace_process(ProcessId process, BootTraceEvent event);
+void boot_trace_released_by(ProcessId process, ProcessId dependency);
+int finish_boot_trace(const char *path);
+
+#endif /* BOOT_TRACE_H */
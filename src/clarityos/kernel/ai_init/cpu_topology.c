@@ -0,0 +1,305 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include "cpu_topology.h"
+#include "init_log.h"
+
+#define SYSFS_LIST_BUF_SIZE 1024
+#define MAX_CACHE_INDEXES 8
+
+static CpuMask online_cpus;
+static int num_cpus = 0;
+
+static int cpu_node[TOPOLOGY_MAX_CPUS];
+static int cpu_primary[TOPOLOGY_MAX_CPUS];      // First SMT sibling of the core
+
+static CpuMask node_cpus[TOPOLOGY_MAX_NODES];
+static int num_nodes = 0;                       // Highest node id with CPUs, plus one
+
+static CpuMask llc_cpus[TOPOLOGY_MAX_LLC_DOMAINS];
+static int llc_node[TOPOLOGY_MAX_LLC_DOMAINS];
+static int num_llc_domains = 0;
+
+static CpuMask housekeeping_cpus[NUM_HOUSEKEEPING_ROLES];
+static int housekeeping_pinned = 0;
+
+static void mask_set(CpuMask *mask, int cpu) {
+    mask->bits[cpu / 64] |= 1ull << (cpu % 64);
+}
+
+static int mask_test(const CpuMask *mask, int cpu) {
+    return (mask->bits[cpu / 64] >> (cpu % 64)) & 1;
+}
+
+static int mask_first(const CpuMask *mask) {
+    for (int w = 0; w < TOPOLOGY_MAX_CPUS / 64; w++) {
+        if (mask->bits[w]) return w * 64 + __builtin_ctzll(mask->bits[w]);
+    }
+    return -1;
+}
+
+static int mask_count(const CpuMask *mask) {
+    int count = 0;
+    for (int w = 0; w < TOPOLOGY_MAX_CPUS / 64; w++) count += __builtin_popcountll(mask->bits[w]);
+    return count;
+}
+
+// Read a small sysfs file, formatted from a path pattern and an index, into
+// buf and NUL-terminate it. Returns -1 if it does not exist.
+static int read_sysfs(char *buf, size_t len, const char *pattern, int index, int subindex) {
+    char path[256];
+    snprintf(path, sizeof(path), pattern, index, subindex);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) return -1;
+
+    buf[n] = '\0';
+    return 0;
+}
+
+// Parse a kernel cpulist ("0-3,8-11") into mask. Returns the number of CPUs.
+int parse_cpu_list(const char *list, CpuMask *mask) {
+    memset(mask, 0, sizeof(*mask));
+
+    const char *p = list;
+    while (*p >= '0' && *p <= '9') {
+        char *end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (*end == '-') last = strtol(end + 1, &end, 10);
+
+        for (long cpu = first; cpu <= last && cpu < TOPOLOGY_MAX_CPUS; cpu++) mask_set(mask, (int)cpu);
+
+        p = *end == ',' ? end + 1 : end;
+    }
+    return mask_count(mask);
+}
+
+static void read_node_cpus() {
+    char buf[SYSFS_LIST_BUF_SIZE];
+
+    // Node ids may have gaps; memory-only nodes have no CPUs
+    for (int node = 0; node < TOPOLOGY_MAX_NODES; node++) {
+        if (read_sysfs(buf, sizeof(buf), TOPOLOGY_SYSFS_ROOT "/node/node%d/cpulist", node, 0) < 0) continue;
+        if (parse_cpu_list(buf, &node_cpus[node]) > 0) num_nodes = node + 1;
+    }
+
+    if (num_nodes == 0) {
+        node_cpus[0] = online_cpus;
+        num_nodes = 1;
+    }
+
+    for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+        cpu_node[cpu] = 0;
+        for (int node = 0; node < num_nodes; node++) {
+            if (mask_test(&node_cpus[node], cpu)) cpu_node[cpu] = node;
+        }
+    }
+}
+
+// CPUs sharing the highest-level cache with cpu, or an empty mask
+static void read_llc_cpus(int cpu, CpuMask *shared) {
+    char buf[SYSFS_LIST_BUF_SIZE];
+    int best_level = 0;
+
+    memset(shared, 0, sizeof(*shared));
+    for (int index = 0; index < MAX_CACHE_INDEXES; index++) {
+        if (read_sysfs(buf, sizeof(buf), TOPOLOGY_SYSFS_ROOT "/cpu/cpu%d/cache/index%d/level", cpu, index) < 0) {
+            break;
+        }
+        int level = atoi(buf);
+        if (level <= best_level ||
+            read_sysfs(buf, sizeof(buf), TOPOLOGY_SYSFS_ROOT "/cpu/cpu%d/cache/index%d/shared_cpu_list",
+                       cpu, index) < 0) {
+            continue;
+        }
+        if (parse_cpu_list(buf, shared) > 0) best_level = level;
+    }
+}
+
+// Create the LLC domain of cpu, unless one of its CPUs already did. A
+// cache spanning several nodes (sub-NUMA clustering off) is split by node.
+static void assign_llc_domain(int cpu) {
+    CpuMask shared;
+    read_llc_cpus(cpu, &shared);
+    if (mask_count(&shared) == 0) shared = node_cpus[cpu_node[cpu]];
+
+    CpuMask domain;
+    memset(&domain, 0, sizeof(domain));
+    for (int c = 0; c < TOPOLOGY_MAX_CPUS; c++) {
+        if (mask_test(&shared, c) && mask_test(&online_cpus, c) && cpu_node[c] == cpu_node[cpu]) {
+            mask_set(&domain, c);
+        }
+    }
+    mask_set(&domain, cpu);
+
+    int first = mask_first(&domain);
+    for (int d = 0; d < num_llc_domains; d++) {
+        if (mask_first(&llc_cpus[d]) == first) return;
+    }
+
+    // Past the limit, the remaining CPUs join the last domain
+    if (num_llc_domains == TOPOLOGY_MAX_LLC_DOMAINS) {
+        mask_set(&llc_cpus[num_llc_domains - 1], cpu);
+        return;
+    }
+    llc_cpus[num_llc_domains] = domain;
+    llc_node[num_llc_domains] = cpu_node[cpu];
+    num_llc_domains++;
+}
+
+int init_cpu_topology() {
+    char buf[SYSFS_LIST_BUF_SIZE];
+
+    if (read_sysfs(buf, sizeof(buf), TOPOLOGY_SYSFS_ROOT "/cpu/online", 0, 0) < 0 ||
+        parse_cpu_list(buf, &online_cpus) == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        log_warn("CPU topology: %s/cpu/online unavailable, assuming CPUs 0-%ld", TOPOLOGY_SYSFS_ROOT, n - 1);
+        memset(&online_cpus, 0, sizeof(online_cpus));
+        for (long cpu = 0; cpu < n && cpu < TOPOLOGY_MAX_CPUS; cpu++) mask_set(&online_cpus, (int)cpu);
+    }
+    num_cpus = mask_count(&online_cpus);
+
+    read_node_cpus();
+
+    int smt_threads = 0;
+    for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+        if (!mask_test(&online_cpus, cpu)) continue;
+
+        CpuMask siblings;
+        cpu_primary[cpu] = cpu;
+        if (read_sysfs(buf, sizeof(buf), TOPOLOGY_SYSFS_ROOT "/cpu/cpu%d/topology/thread_siblings_list",
+                       cpu, 0) == 0 &&
+            parse_cpu_list(buf, &siblings) > 0) {
+            cpu_primary[cpu] = mask_first(&siblings);
+        }
+        if (cpu_primary[cpu] != cpu) smt_threads++;
+
+        assign_llc_domain(cpu);
+    }
+
+    log_info("CPU topology: %d CPUs (%d SMT siblings), %d nodes, %d LLC domains",
+             num_cpus, smt_threads, num_nodes, num_llc_domains);
+    return 0;
+}
+
+int topology_num_cpus() {
+    return num_cpus;
+}
+
+int topology_num_nodes() {
+    return num_nodes;
+}
+
+int topology_num_llc_domains() {
+    return num_llc_domains;
+}
+
+int topology_llc_node(int domain) {
+    return domain >= 0 && domain < num_llc_domains ? llc_node[domain] : -1;
+}
+
+// CPUs of a placement: the LLC domain if given, else the node if given,
+// else all online CPUs; with smt_exclusive, only the first hardware thread
+// of each core. Returns the number of CPUs, 0 if the placement is invalid.
+int topology_placement(int node, int llc_domain, int smt_exclusive, CpuMask *cpus) {
+    if (llc_domain >= num_llc_domains || node >= num_nodes) {
+        memset(cpus, 0, sizeof(*cpus));
+        return 0;
+    }
+
+    *cpus = llc_domain >= 0 ? llc_cpus[llc_domain] : node >= 0 ? node_cpus[node] : online_cpus;
+    if (smt_exclusive) {
+        for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS; cpu++) {
+            if (mask_test(cpus, cpu) && cpu_primary[cpu] != cpu) cpus->bits[cpu / 64] &= ~(1ull << (cpu % 64));
+        }
+    }
+    return mask_count(cpus);
+}
+
+// Format mask as a cpulist, collapsing runs into ranges. Returns the length.
+int format_cpu_list(const CpuMask *mask, char *buf, size_t len) {
+    size_t used = 0;
+    buf[0] = '\0';
+
+    for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS && used < len; cpu++) {
+        if (!mask_test(mask, cpu)) continue;
+
+        int last = cpu;
+        while (last + 1 < TOPOLOGY_MAX_CPUS && mask_test(mask, last + 1)) last++;
+
+        int n = last > cpu ? snprintf(buf + used, len - used, "%s%d-%d", used ? "," : "", cpu, last)
+                           : snprintf(buf + used, len - used, "%s%d", used ? "," : "", cpu);
+        used += (size_t)n;
+        cpu = last;
+    }
+    return used < len ? (int)used : (int)len - 1;
+}
+
+// Remove the CPUs of a sysfs cpulist from mask. nohz_full reads "(null)"
+// when unset, which parses as no CPUs.
+static void mask_remove_sysfs_list(CpuMask *mask, const char *path) {
+    char buf[SYSFS_LIST_BUF_SIZE];
+    CpuMask reserved;
+    if (read_sysfs(buf, sizeof(buf), path, 0, 0) < 0 || parse_cpu_list(buf, &reserved) == 0) return;
+
+    for (int w = 0; w < TOPOLOGY_MAX_CPUS / 64; w++) mask->bits[w] &= ~reserved.bits[w];
+}
+
+// Call after init_cpu_topology(). Returns the number of housekeeping CPUs,
+// 0 if threads are not pinned.
+int init_housekeeping_cpus(const char *cpu_list) {
+    CpuMask cpus = online_cpus;
+    housekeeping_pinned = 0;
+
+    if (cpu_list && *cpu_list) {
+        CpuMask requested;
+        parse_cpu_list(cpu_list, &requested);
+        for (int w = 0; w < TOPOLOGY_MAX_CPUS / 64; w++) cpus.bits[w] &= requested.bits[w];
+        if (mask_count(&cpus) == 0) {
+            log_warn("Housekeeping CPUs \"%s\" include no online CPU, not pinning", cpu_list);
+            return 0;
+        }
+    } else {
+        mask_remove_sysfs_list(&cpus, TOPOLOGY_SYSFS_ROOT "/cpu/isolated");
+        mask_remove_sysfs_list(&cpus, TOPOLOGY_SYSFS_ROOT "/cpu/nohz_full");
+        if (mask_count(&cpus) == 0 || mask_count(&cpus) == num_cpus) return 0;
+    }
+
+    int count = mask_count(&cpus);
+    housekeeping_cpus[HOUSEKEEPING_MONITOR] = cpus;
+    housekeeping_cpus[HOUSEKEEPING_WORKER] = cpus;
+    if (count >= 2) {
+        int first = mask_first(&cpus);
+        memset(&housekeeping_cpus[HOUSEKEEPING_MONITOR], 0, sizeof(CpuMask));
+        mask_set(&housekeeping_cpus[HOUSEKEEPING_MONITOR], first);
+        housekeeping_cpus[HOUSEKEEPING_WORKER].bits[first / 64] &= ~(1ull << (first % 64));
+    }
+    housekeeping_pinned = 1;
+
+    char list[TOPOLOGY_CPU_LIST_MAX];
+    format_cpu_list(&cpus, list, sizeof(list));
+    log_info("Housekeeping CPUs: %s%s", list, count >= 2 ? " (first reserved for the monitor)" : "");
+    return count;
+}
+
+// Returns 0, also when nothing is pinned, or an errno value
+int pin_housekeeping_thread(pthread_t thread, HousekeepingRole role) {
+    if (!housekeeping_pinned) return 0;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu = 0; cpu < TOPOLOGY_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+        if (mask_test(&housekeeping_cpus[role], cpu)) CPU_SET(cpu, &set);
+    }
+    int ret = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (ret != 0) log_warn("Cannot pin thread to housekeeping CPUs: %s", strerror(ret));
+    return ret;
+}
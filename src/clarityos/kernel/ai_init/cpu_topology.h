@@ -0,0 +1,56 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+
+// CPU topology
+//
+// Read once from sysfs at startup: the online CPUs, the NUMA node of each,
+// its SMT siblings, and the last-level cache (LLC) it shares. CPUs sharing
+// an LLC form a domain; domains are numbered in order of their first CPU,
+// and each lies within one node. Without NUMA information every CPU is on
+// node 0; without cache information each node is one domain.
+
+#ifndef TOPOLOGY_SYSFS_ROOT
+#define TOPOLOGY_SYSFS_ROOT "/sys/devices/system"
+#endif
+
+#define TOPOLOGY_MAX_CPUS 256
+#define TOPOLOGY_MAX_NODES 16
+#define TOPOLOGY_MAX_LLC_DOMAINS 64
+
+// Longest cpulist formatted for TOPOLOGY_MAX_CPUS ("0,2,4,...")
+#define TOPOLOGY_CPU_LIST_MAX 1024
+
+typedef struct {
+    uint64_t bits[TOPOLOGY_MAX_CPUS / 64];
+} CpuMask;
+
+// Housekeeping CPUs, the ones ai_init's own threads run on: a given
+// cpulist, or else the online CPUs the kernel does not reserve for tenants
+// (isolated, nohz_full). With two or more, the monitor thread gets the
+// first to itself and the other threads share the rest. Without reserved
+// CPUs nothing is pinned. HOUSEKEEPING_CPUS_ENV gives the cpulist to ai_init.
+#define HOUSEKEEPING_CPUS_ENV "AI_INIT_HOUSEKEEPING_CPUS"
+
+typedef enum {
+    HOUSEKEEPING_MONITOR,
+    HOUSEKEEPING_WORKER,
+    NUM_HOUSEKEEPING_ROLES
+} HousekeepingRole;
+
+// Function prototypes
+int init_cpu_topology();
+int topology_num_cpus();
+int topology_num_nodes();
+int topology_num_llc_domains();
+int topology_llc_node(int domain);
+int topology_placement(int node, int llc_domain, int smt_exclusive, CpuMask *cpus);
+int parse_cpu_list(const char *list, CpuMask *mask);
+int format_cpu_list(const CpuMask *mask, char *buf, size_t len);
+int init_housekeeping_cpus(const char *cpu_list);
+int pin_housekeeping_thread(pthread_t thread, HousekeepingRole role);
+
+#endif /* CPU_TOPOLOGY_H */
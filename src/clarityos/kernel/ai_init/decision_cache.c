@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "decision_cache.h"
+#include "init_log.h"
+
+// Decision cache
+//
+// System state barely changes from one tick to the next, so the learning
+// engine consults this cache before running inference. The key packs the
+// bucketed cpu/memory/io/network usage, battery level and AC power flag into
+// one integer, with coarse summaries of the hardware state the models also
+// see: PSI stalls, throttling, temperature, the busiest and idlest core and
+// the fullest NUMA node. Two states in the same buckets map to the same
+// decision. A hit
+// copies the memoized outputs back into the model's bound output tensors, so
+// callers cannot tell a cached result from a fresh one.
+//
+// Each cache is used by one thread at a time (the thread that owns the model
+// for inference); it is not internally synchronized.
+
+static uint64_t monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static uint64_t quantize(double value, double max, int buckets) {
+    if (value <= 0.0) return 0;
+    if (value >= max) return buckets;
+    return (uint64_t)(value / max * buckets);
+}
+
+// Single writer: a plain increment, without a locked read-modify-write
+static void count(atomic_ulong *counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+}
+
+static int slot_for_key(uint64_t key) {
+    // Fibonacci hashing spreads neighbouring buckets across the table
+    return (int)((key * 0x9E3779B97F4A7C15ULL) >> 58) & (DECISION_CACHE_ENTRIES - 1);
+}
+
+static float *entry_storage(DecisionCache *cache, int slot) {
+    return cache->storage + (size_t)slot * cache->entry_floats;
+}
+
+// Entry storage depends on the model's output sizes, which are only known
+// once the model is loaded; a cache attached to a deferred model allocates
+// it on the first store.
+static int ensure_cache_storage(ModelHandle *model) {
+    DecisionCache *cache = model->cache;
+    if (cache->storage) return 0;
+
+    cache->entry_floats = 0;
+    for (int i = 0; i < model->num_outputs; i++) {
+        cache->entry_floats += model->outputs[i].size;
+    }
+    if (cache->entry_floats == 0) return -1;
+
+    cache->storage = malloc(sizeof(float) * (size_t)cache->entry_floats * DECISION_CACHE_ENTRIES);
+    return cache->storage ? 0 : -1;
+}
+
+int attach_decision_cache(ModelHandle *model) {
+    DecisionCache *cache = calloc(1, sizeof(DecisionCache));
+    if (!cache) return -1;
+
+    long ttl_ms = DECISION_CACHE_DEFAULT_TTL_MS;
+    const char *setting = getenv(DECISION_CACHE_TTL_ENV);
+    if (setting) {
+        char *end;
+        long value = strtol(setting, &end, 10);
+        if (*setting && !*end && value >= 0) {
+            ttl_ms = value;
+        } else {
+            log_warn("Decision cache: ignoring %s=%s", DECISION_CACHE_TTL_ENV, setting);
+        }
+    }
+    cache->ttl_ns = (uint64_t)ttl_ms * 1000000ULL;
+    model->cache = cache;
+
+    if (atomic_load(&model->loaded)) ensure_cache_storage(model);
+
+    return 0;
+}
+
+void detach_decision_cache(ModelHandle *model) {
+    if (!model->cache) return;
+
+    free(model->cache->storage);
+    free(model->cache);
+    model->cache = NULL;
+}
+
+uint64_t decision_cache_key(SystemState state, const HardwareState *hardware) {
+    // 5 bits per usage metric, 4 bits of battery, 1 bit of AC power
+    uint64_t key = 0;
+    key |= quantize(state.cpu_usage, 1.0, DECISION_CACHE_USAGE_BUCKETS);
+    key |= quantize(state.memory_usage, 1.0, DECISION_CACHE_USAGE_BUCKETS) << 5;
+    key |= quantize(state.io_usage, 1.0, DECISION_CACHE_USAGE_BUCKETS) << 10;
+    key |= quantize(state.network_usage, 1.0, DECISION_CACHE_USAGE_BUCKETS) << 15;
+    key |= quantize(state.battery_level, 100.0, DECISION_CACHE_BATTERY_BUCKETS) << 20;
+    key |= (uint64_t)(state.on_ac_power ? 1 : 0) << 24;
+
+    // Then 3 bits per hardware summary. Stalls past 50% and temperatures
+    // past 100 C share the top bucket.
+    double core_max = 0.0;
+    double core_min = hardware->num_cpus > 0 ? 1.0 : 0.0;
+    for (int c = 0; c < hardware->num_cpus && c < HW_MAX_CPUS; c++) {
+        if (hardware->core_usage[c] > core_max) core_max = hardware->core_usage[c];
+        if (hardware->core_usage[c] < core_min) core_min = hardware->core_usage[c];
+    }
+    double node_max = 0.0;
+    for (int n = 0; n < hardware->num_numa_nodes && n < HW_MAX_NUMA_NODES; n++) {
+        if (hardware->node_memory_usage[n] > node_max) node_max = hardware->node_memory_usage[n];
+    }
+
+    const double summaries[] = {
+        hardware->psi_cpu_some / 50.0, hardware->psi_memory_some / 50.0, hardware->psi_memory_full / 50.0,
+        hardware->psi_io_some / 50.0, hardware->psi_io_full / 50.0, hardware->cpufreq_min_ratio,
+        hardware->thermal_max_celsius / 100.0, core_max, core_min, node_max
+    };
+    for (int i = 0; i < (int)(sizeof(summaries) / sizeof(summaries[0])); i++) {
+        key |= quantize(summaries[i], 1.0, DECISION_CACHE_HARDWARE_BUCKETS) << (25 + 3 * i);
+    }
+
+    return key;
+}
+
+// On a hit, restore the memoized outputs into the model's output tensors
+// and return 1. Returns 0 on a miss.
+int decision_cache_lookup(ModelHandle *model, uint64_t key) {
+    DecisionCache *cache = model->cache;
+    if (!cache) return 0;
+
+    int slot = slot_for_key(key);
+    DecisionCacheEntry *entry = &cache->entries[slot];
+
+    if (!entry->valid || entry->key != key) {
+        count(&cache->misses);
+        return 0;
+    }
+
+    if (monotonic_ns() - entry->stored_ns > cache->ttl_ns) {
+        entry->valid = 0;
+        count(&cache->misses);
+        count(&cache->expired);
+        return 0;
+    }
+
+    const float *stored = entry_storage(cache, slot);
+    for (int i = 0; i < model->num_outputs; i++) {
+        memcpy(model->outputs[i].data, stored, sizeof(float) * model->outputs[i].size);
+        stored += model->outputs[i].size;
+    }
+
+    count(&cache->hits);
+    return 1;
+}
+
+// Memoize the model's current outputs under key
+void decision_cache_store(ModelHandle *model, uint64_t key) {
+    DecisionCache *cache = model->cache;
+    if (!cache || ensure_cache_storage(model) < 0) return;
+
+    int slot = slot_for_key(key);
+    float *stored = entry_storage(cache, slot);
+
+    for (int i = 0; i < model->num_outputs; i++) {
+        memcpy(stored, model->outputs[i].data, sizeof(float) * model->outputs[i].size);
+        stored += model->outputs[i].size;
+    }
+
+    cache->entries[slot].key = key;
+    cache->entries[slot].stored_ns = monotonic_ns();
+    cache->entries[slot].valid = 1;
+}
+
+DecisionCacheStats decision_cache_get_stats(ModelHandle *model) {
+    DecisionCacheStats stats = { 0, 0, 0 };
+    if (!model->cache) return stats;
+
+    stats.hits = atomic_load_explicit(&model->cache->hits, memory_order_relaxed);
+    stats.misses = atomic_load_explicit(&model->cache->misses, memory_order_relaxed);
+    stats.expired = atomic_load_explicit(&model->cache->expired, memory_order_relaxed);
+    return stats;
+}
+
+// Counters of each slot's cache, in the Prometheus text format. A model
+// replaced by the updater starts its counters over.
+void write_decision_cache_metrics(FILE *file) {
+    static const char *slot_names[NUM_MODEL_SLOTS] = { "boot", "resource", "process", "fused" };
+    static const char *counters[] = { "hits", "misses", "expired" };
+    static const char *help[] = { "Lookups answered from the cache", "Lookups that ran inference",
+                                  "Misses caused by an entry outliving its TTL" };
+    DecisionCacheStats stats[NUM_MODEL_SLOTS];
+    int cached[NUM_MODEL_SLOTS];
+
+    int token = models_read_lock();
+    for (int s = 0; s < NUM_MODEL_SLOTS; s++) {
+        ModelHandle *model = get_slot_model((ModelSlot)s);
+        cached[s] = model && model->cache;
+        if (cached[s]) stats[s] = decision_cache_get_stats(model);
+    }
+    models_read_unlock(token);
+
+    for (int c = 0; c < 3; c++) {
+        fprintf(file, "# HELP ai_init_decision_cache_%s_total %s, per model slot.\n", counters[c], help[c]);
+        fprintf(file, "# TYPE ai_init_decision_cache_%s_total counter\n", counters[c]);
+        for (int s = 0; s < NUM_MODEL_SLOTS; s++) {
+            if (!cached[s]) continue;
+            unsigned long value = c == 0 ? stats[s].hits : c == 1 ? stats[s].misses : stats[s].expired;
+            fprintf(file, "ai_init_decision_cache_%s_total{slot=\"%s\"} %lu\n", counters[c],
+                    slot_names[s], value);
+        }
+    }
+}
+
+// Cache snapshot (see restart_snapshot.h): the valid entries with their
+// outputs. Entry times are CLOCK_MONOTONIC, which runs on across an exec,
+// so restored entries expire on schedule.
+typedef struct {
+    uint32_t num_entries;
+    uint32_t entry_floats;
+    uint64_t ttl_ns;
+    uint32_t key_version;       // DECISION_CACHE_KEY_VERSION
+    uint32_t reserved;
+} CacheSnapshot;
+
+typedef struct {
+    uint64_t key;
+    uint64_t stored_ns;
+    uint32_t slot;
+    uint32_t reserved;
+} CacheEntrySnapshot;
+
+static size_t cache_snapshot_size(int num_entries, int entry_floats) {
+    return sizeof(CacheSnapshot) +
+           (size_t)num_entries * (sizeof(CacheEntrySnapshot) + sizeof(float) * (size_t)entry_floats);
+}
+
+// 0 when the model has nothing cached
+size_t decision_cache_snapshot_size(ModelHandle *model) {
+    DecisionCache *cache = model->cache;
+    if (!cache || !cache->storage) return 0;
+
+    int valid = 0;
+    for (int i = 0; i < DECISION_CACHE_ENTRIES; i++) valid += cache->entries[i].valid;
+    return valid ? cache_snapshot_size(valid, cache->entry_floats) : 0;
+}
+
+void snapshot_decision_cache(ModelHandle *model, void *buf) {
+    DecisionCache *cache = model->cache;
+    CacheSnapshot *snapshot = buf;
+    CacheEntrySnapshot *records = (CacheEntrySnapshot *)(snapshot + 1);
+
+    int n = 0;
+    for (int i = 0; i < DECISION_CACHE_ENTRIES; i++) {
+        if (!cache->entries[i].valid) continue;
+        records[n].key = cache->entries[i].key;
+        records[n].stored_ns = cache->entries[i].stored_ns;
+        records[n].slot = (uint32_t)i;
+        records[n].reserved = 0;
+        n++;
+    }
+
+    float *outputs = (float *)(records + n);
+    for (int r = 0; r < n; r++) {
+        memcpy(outputs + (size_t)r * cache->entry_floats, entry_storage(cache, (int)records[r].slot),
+               sizeof(float) * (size_t)cache->entry_floats);
+    }
+    snapshot->num_entries = (uint32_t)n;
+    snapshot->entry_floats = (uint32_t)cache->entry_floats;
+    snapshot->ttl_ns = cache->ttl_ns;
+    snapshot->key_version = DECISION_CACHE_KEY_VERSION;
+    snapshot->reserved = 0;
+}
+
+// The model must be loaded with the same output sizes it had when the
+// snapshot was taken
+int restore_decision_cache(ModelHandle *model, const void *buf, size_t size) {
+    const CacheSnapshot *snapshot = buf;
+    if (!model->cache || !atomic_load(&model->loaded) || ensure_cache_storage(model) < 0) return -1;
+
+    DecisionCache *cache = model->cache;
+    if (size < sizeof(*snapshot) || snapshot->num_entries > DECISION_CACHE_ENTRIES ||
+        snapshot->entry_floats != (uint32_t)cache->entry_floats ||
+        snapshot->key_version != DECISION_CACHE_KEY_VERSION ||
+        size != cache_snapshot_size((int)snapshot->num_entries, cache->entry_floats)) {
+        return -1;
+    }
+
+    const CacheEntrySnapshot *records = (const CacheEntrySnapshot *)(snapshot + 1);
+    const float *outputs = (const float *)(records + snapshot->num_entries);
+    for (uint32_t r = 0; r < snapshot->num_entries; r++) {
+        int slot = slot_for_key(records[r].key);
+        memcpy(entry_storage(cache, slot), outputs + (size_t)r * cache->entry_floats,
+               sizeof(float) * (size_t)cache->entry_floats);
+        cache->entries[slot].key = records[r].key;
+        cache->entries[slot].stored_ns = records[r].stored_ns;
+        cache->entries[slot].valid = 1;
+    }
+    cache->ttl_ns = snapshot->ttl_ns;
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef DECISION_CACHE_H
+#define DECISION_CACHE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include "learning_engine.h"
+
+// Entries per model cache (direct mapped, power of two)
+#define DECISION_CACHE_ENTRIES 64
+
+// Default time-to-live of a cached inference result; DECISION_CACHE_TTL_ENV
+// overrides it for every cache attached afterwards, 0 disabling caching
+#define DECISION_CACHE_DEFAULT_TTL_MS 5000
+#define DECISION_CACHE_TTL_ENV "AI_INIT_DECISION_CACHE_TTL_MS"
+
+// Quantization steps used to build cache keys
+#define DECISION_CACHE_USAGE_BUCKETS    20  // 5% steps for cpu/mem/io/net
+#define DECISION_CACHE_BATTERY_BUCKETS  10  // 10% steps for battery level
+#define DECISION_CACHE_HARDWARE_BUCKETS 7   // 3 bits per hardware summary
+
+// Layout of the keys; cached entries of another layout are not restored
+#define DECISION_CACHE_KEY_VERSION 2
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long expired;      // Misses caused by an entry outliving its TTL
+} DecisionCacheStats;
+
+typedef struct {
+    uint64_t key;
+    uint64_t stored_ns;
+    int valid;
+} DecisionCacheEntry;
+
+// Memoized model outputs keyed on the quantized system state. Output storage
+// for every entry is allocated on the first store, once the model's output
+// sizes are known. The counters are only written by the thread using the
+// cache, but read by the decision loop for the metrics.
+typedef struct DecisionCache {
+    DecisionCacheEntry entries[DECISION_CACHE_ENTRIES];
+    float *storage;
+    int entry_floats;           // Floats per entry across all model outputs
+    uint64_t ttl_ns;
+    atomic_ulong hits;
+    atomic_ulong misses;
+    atomic_ulong expired;
+} DecisionCache;
+
+// Function prototypes
+int attach_decision_cache(ModelHandle *model);
+void detach_decision_cache(ModelHandle *model);
+uint64_t decision_cache_key(SystemState state, const HardwareState *hardware);
+int decision_cache_lookup(ModelHandle *model, uint64_t key);
+void decision_cache_store(ModelHandle *model, uint64_t key);
+DecisionCacheStats decision_cache_get_stats(ModelHandle *model);
+void write_decision_cache_metrics(FILE *file);
+
+// Re-exec (see restart_snapshot.h)
+size_t decision_cache_snapshot_size(ModelHandle *model);
+void snapshot_decision_cache(ModelHandle *model, void *buf);
+int restore_decision_cache(ModelHandle *model, const void *buf, size_t size);
+
+#endif /* DECISION_CACHE_H */
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/eventfd.h>
+#include "decision_pipeline.h"
+#include "cpu_topology.h"
+#include "latency_stats.h"
+#include "init_log.h"
+
+typedef struct {
+    SystemState state;
+    HardwareState hardware;
+    ProcessTableView processes; // For the enforcement worker
+    unsigned int heads;
+    uint64_t submitted_ns;
+    int status;                 // Of run_decision_heads()
+    DecisionResult result;
+} DecisionJob;
+
+// Bounded SPSC queue of jobs. It holds every job at once, so a push never
+// finds it full. The eventfd counts pushes for the consumer to block on.
+typedef struct {
+    DecisionJob *jobs[DECISION_PIPELINE_DEPTH];
+    _Atomic unsigned int head;  // Next slot written (producer)
+    _Atomic unsigned int tail;  // Next slot read (consumer)
+    int event_fd;
+} JobQueue;
+
+static DecisionJob jobs[DECISION_PIPELINE_DEPTH];
+
+// Jobs not in flight (decision loop only)
+static DecisionJob *free_jobs[DECISION_PIPELINE_DEPTH];
+static int num_free_jobs = 0;
+
+static JobQueue inference_queue;
+static JobQueue enforcement_queue;
+static JobQueue completion_queue;   // Back to the decision loop
+
+static pthread_t worker_threads[2];
+static int num_workers = 0;
+static atomic_int pipeline_running = 0;
+
+static void queue_push(JobQueue *queue, DecisionJob *job) {
+    unsigned int head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    queue->jobs[head % DECISION_PIPELINE_DEPTH] = job;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    uint64_t one = 1;
+    if (write(queue->event_fd, &one, sizeof(one)) < 0) {
+        log_error("Decision pipeline: eventfd: %s", strerror(errno));
+    }
+}
+
+static DecisionJob *queue_pop(JobQueue *queue) {
+    unsigned int tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    if (tail == atomic_load_explicit(&queue->head, memory_order_acquire)) return NULL;
+
+    DecisionJob *job = queue->jobs[tail % DECISION_PIPELINE_DEPTH];
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return job;
+}
+
+// Block until something was pushed (or the pipeline stops). Returns 0 once
+// the worker should exit, after draining what is queued.
+static int queue_wait(JobQueue *queue) {
+    uint64_t count;
+    while (read(queue->event_fd, &count, sizeof(count)) < 0 && errno == EINTR) {
+    }
+    return atomic_load(&pipeline_running);
+}
+
+static int queue_init(JobQueue *queue, int flags) {
+    atomic_store(&queue->head, 0);
+    atomic_store(&queue->tail, 0);
+    queue->event_fd = eventfd(0, EFD_CLOEXEC | flags);
+    return queue->event_fd < 0 ? -1 : 0;
+}
+
+static void queue_close(JobQueue *queue) {
+    if (queue->event_fd >= 0) close(queue->event_fd);
+    queue->event_fd = -1;
+}
+
+static void *inference_worker(void *arg) {
+    (void)arg;
+    pin_housekeeping_thread(pthread_self(), HOUSEKEEPING_WORKER);
+    set_decision_log_producer(LOG_PRODUCER_INFERENCE);
+
+    for (;;) {
+        int running = queue_wait(&inference_queue);
+        DecisionJob *job;
+        while ((job = queue_pop(&inference_queue)) != NULL) {
+            job->status = run_decision_heads(job->state, &job->hardware, job->heads, &job->result);
+            queue_push(&enforcement_queue, job);
+        }
+        if (!running) return NULL;
+    }
+}
+
+static void *enforcement_worker(void *arg) {
+    (void)arg;
+    pin_housekeeping_thread(pthread_self(), HOUSEKEEPING_WORKER);
+
+    for (;;) {
+        int running = queue_wait(&enforcement_queue);
+        DecisionJob *job;
+        while ((job = queue_pop(&enforcement_queue)) != NULL) {
+            if (job->status == 0 && (job->heads & DECISION_RESOURCE_POLICY)) {
+                apply_resource_policy(&job->result.policy, &job->processes);
+            }
+            queue_push(&completion_queue, job);
+        }
+        if (!running) return NULL;
+    }
+}
+
+int start_decision_pipeline() {
+    const char *setting = getenv(DECISION_PIPELINE_ENV);
+    if (setting && strcmp(setting, "0") == 0) {
+        log_info("Decision pipeline disabled, deciding inline");
+        return 0;
+    }
+
+    num_free_jobs = 0;
+    for (int i = 0; i < DECISION_PIPELINE_DEPTH; i++) {
+        memset(&jobs[i], 0, sizeof(jobs[i]));
+        free_jobs[num_free_jobs++] = &jobs[i];
+    }
+
+    // The decision loop polls the completion queue; the workers block
+    if (queue_init(&inference_queue, 0) < 0 || queue_init(&enforcement_queue, 0) < 0 ||
+        queue_init(&completion_queue, EFD_NONBLOCK) < 0) {
+        log_error("Decision pipeline: eventfd: %s", strerror(errno));
+        queue_close(&inference_queue);
+        queue_close(&enforcement_queue);
+        queue_close(&completion_queue);
+        return -1;
+    }
+
+    atomic_store(&pipeline_running, 1);
+    num_workers = 0;
+    void *(*workers[])(void *) = { inference_worker, enforcement_worker };
+    for (int i = 0; i < 2; i++) {
+        if (pthread_create(&worker_threads[i], NULL, workers[i], NULL) != 0) {
+            log_error("Failed to create decision pipeline worker");
+            stop_decision_pipeline();
+            return -1;
+        }
+        num_workers++;
+    }
+
+    log_info("Decision pipeline started (%d decisions in flight)", DECISION_PIPELINE_DEPTH);
+    return 0;
+}
+
+void stop_decision_pipeline() {
+    if (!atomic_load(&pipeline_running)) return;
+
+    // Stopped in pipeline order, each worker draining its queue before it
+    // exits, so every submitted decision has its resource policy enforced
+    atomic_store(&pipeline_running, 0);
+    JobQueue *queues[] = { &inference_queue, &enforcement_queue };
+    for (int i = 0; i < num_workers; i++) {
+        uint64_t one = 1;
+        if (write(queues[i]->event_fd, &one, sizeof(one)) < 0) {
+            log_error("Decision pipeline: cannot signal stop: %s", strerror(errno));
+        }
+        pthread_join(worker_threads[i], NULL);
+    }
+    num_workers = 0;
+
+    // Process adjustments not yet taken by complete_decisions() are dropped,
+    // as is anything left over if the enforcement worker never started
+    while (queue_pop(&enforcement_queue) != NULL) {
+    }
+    while (queue_pop(&completion_queue) != NULL) {
+    }
+
+    queue_close(&inference_queue);
+    queue_close(&enforcement_queue);
+    queue_close(&completion_queue);
+}
+
+int decision_pipeline_running() {
+    return atomic_load(&pipeline_running);
+}
+
+// Readable when decisions have come back to the decision loop
+int decision_pipeline_event_fd() {
+    return atomic_load(&pipeline_running) ? completion_queue.event_fd : -1;
+}
+
+// Decision loop: start a decision on state. Returns 0, or -1 if every
+// job is still in flight.
+int submit_decision(SystemState state, const HardwareState *hardware, unsigned int heads) {
+    if (num_free_jobs == 0) return -1;
+
+    DecisionJob *job = free_jobs[--num_free_jobs];
+    job->state = state;
+    job->hardware = *hardware;
+    update_process_view(&job->processes);
+    job->heads = heads;
+    job->submitted_ns = latency_now();
+    job->status = -1;
+    queue_push(&inference_queue, job);
+    return 0;
+}
+
+// Decision loop: reconcile and apply the process adjustments of finished
+// decisions. Returns the number completed.
+int complete_decisions() {
+    uint64_t count;
+    if (read(completion_queue.event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        log_error("Decision pipeline: eventfd: %s", strerror(errno));
+    }
+
+    int completed = 0;
+    DecisionJob *job;
+    while ((job = queue_pop(&completion_queue)) != NULL) {
+        if (job->status == 0) apply_process_adjustments(&job->result.adjustments);
+        latency_record(LATENCY_DECISION_PIPELINE, job->submitted_ns);
+
+        free_jobs[num_free_jobs++] = job;
+        completed++;
+    }
+    return completed;
+}
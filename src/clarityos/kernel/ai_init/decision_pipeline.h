@@ -0,0 +1,37 @@
+#ifndef DECISION_PIPELINE_H
+#define DECISION_PIPELINE_H
+
+#include "learning_engine.h"
+
+// Decision pipeline
+//
+// Decisions made after boot run in stages, each on its own thread,
+// connected by bounded single-producer single-consumer queues:
+//
+//   decision loop -> inference worker -> enforcement worker -> decision loop
+//   (submit_decision)  feature build,     resource policy      process adjustments
+//                      inference, logging (cgroup writes)      (reconcile, apply)
+//
+// Process adjustments come back to the decision loop because the process
+// table belongs to it; the workers only use process ids, and each job
+// carries the ProcessTableView the enforcement worker resolves them with. At most DECISION_PIPELINE_DEPTH decisions are in
+// flight; a submission finding them all busy is refused, so a slow stage
+// sheds ticks instead of queueing stale work. There is one worker per
+// stage: a model binds a single set of tensors and an unsynchronized
+// decision cache, so one model's inferences cannot be spread over several
+// workers. The workers run on the housekeeping CPUs (cpu_topology.h).
+// Setting DECISION_PIPELINE_ENV to 0 runs decisions inline on the decision
+// loop instead.
+
+#define DECISION_PIPELINE_DEPTH 4      // Power of two
+#define DECISION_PIPELINE_ENV "AI_INIT_DECISION_PIPELINE"
+
+// Function prototypes
+int start_decision_pipeline();
+void stop_decision_pipeline();
+int decision_pipeline_running();
+int decision_pipeline_event_fd();
+int submit_decision(SystemState state, const HardwareState *hardware, unsigned int heads);
+int complete_decisions();
+
+#endif /* DECISION_PIPELINE_H */
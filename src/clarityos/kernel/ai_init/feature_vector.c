@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include "feature_vector.h"
+#include "init_log.h"
+
+// The hardware features are copied straight out of HardwareState, so its
+// float fields must stay in feature order
+_Static_assert(offsetof(HardwareState, node_memory_usage) ==
+               (FEATURE_NODE_MEMORY_USAGE - FEATURE_HARDWARE_BASE) * sizeof(float),
+               "HardwareState fields out of feature order");
+_Static_assert(offsetof(HardwareState, core_usage) ==
+               (FEATURE_CORE_USAGE - FEATURE_HARDWARE_BASE) * sizeof(float),
+               "HardwareState fields out of feature order");
+_Static_assert(offsetof(HardwareState, service_cpu_max) ==
+               (FEATURE_SERVICE_LOAD - FEATURE_HARDWARE_BASE) * sizeof(float),
+               "HardwareState fields out of feature order");
+_Static_assert(offsetof(HardwareState, num_numa_nodes) ==
+               (FEATURE_VECTOR_SIZE - FEATURE_HARDWARE_BASE) * sizeof(float),
+               "HardwareState fields out of feature order");
+
+typedef struct {
+    const char *name;
+    float scale;                // Default normalization: x * scale
+} FeatureInfo;
+
+// Scalar features, by index; the per-node and per-core features follow as
+// "node_memory_usage.<n>" and "core_usage.<n>", already in 0..1
+static const FeatureInfo scalar_features[FEATURE_NODE_MEMORY_USAGE] = {
+    { "cpu_usage", 1.0f },
+    { "memory_usage", 1.0f },
+    { "io_usage", 1.0f },
+    { "network_usage", 1.0f },
+    { "num_processes", 0.001f },
+    { "num_users", 0.1f },
+    { "battery_level", 0.01f },
+    { "on_ac_power", 1.0f },
+    { "psi_cpu_some", 0.01f },
+    { "psi_memory_some", 0.01f },
+    { "psi_memory_full", 0.01f },
+    { "psi_io_some", 0.01f },
+    { "psi_io_full", 0.01f },
+    { "cpufreq_mean_ratio", 1.0f },
+    { "cpufreq_min_ratio", 1.0f },
+    { "thermal_max_celsius", 0.01f },
+};
+
+// Service load features, after the per-core ones
+static const FeatureInfo service_features[FEATURE_VECTOR_SIZE - FEATURE_SERVICE_LOAD] = {
+    { "service_cpu_max", 0.125f },
+    { "service_cpu_throttled", 1.0f },
+    { "service_io_mib_per_s", 0.01f },
+    { "service_rss_max", 1.0f },
+};
+
+static float default_scale(int feature) {
+    if (feature < FEATURE_NODE_MEMORY_USAGE) return scalar_features[feature].scale;
+    if (feature >= FEATURE_SERVICE_LOAD) return service_features[feature - FEATURE_SERVICE_LOAD].scale;
+    return 1.0f;
+}
+
+// Index of a named feature, or -1
+static int parse_feature_name(const char *name) {
+    for (int i = 0; i < FEATURE_NODE_MEMORY_USAGE; i++) {
+        if (strcmp(name, scalar_features[i].name) == 0) return i;
+    }
+    for (int i = 0; i < FEATURE_VECTOR_SIZE - FEATURE_SERVICE_LOAD; i++) {
+        if (strcmp(name, service_features[i].name) == 0) return FEATURE_SERVICE_LOAD + i;
+    }
+
+    const char *dot = strchr(name, '.');
+    if (!dot) return -1;
+
+    char *end;
+    long n = strtol(dot + 1, &end, 10);
+    if (end == dot + 1 || *end || n < 0) return -1;
+
+    size_t len = (size_t)(dot - name);
+    if (len == strlen("node_memory_usage") && strncmp(name, "node_memory_usage", len) == 0) {
+        return n < HW_MAX_NUMA_NODES ? FEATURE_NODE_MEMORY_USAGE + (int)n : -1;
+    }
+    if (len == strlen("core_usage") && strncmp(name, "core_usage", len) == 0) {
+        return n < HW_MAX_CPUS ? FEATURE_CORE_USAGE + (int)n : -1;
+    }
+    return -1;
+}
+
+// Fill the coefficients of the first size features of a model, and zero
+// the padding after them: the defaults, overridden by the model's metadata
+// file if it has one. Returns the number of features the metadata set.
+int load_feature_normalization(const char *model_path, float *scale, float *offset, int size) {
+    for (int i = 0; i < FEATURE_PADDED(size); i++) {
+        scale[i] = i >= size ? 0.0f : default_scale(i);
+        offset[i] = 0.0f;
+    }
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s" FEATURE_METADATA_SUFFIX, model_path);
+    FILE *file = fopen(path, "re");
+    if (!file) {
+        if (errno != ENOENT) log_warn("Features: cannot read %s: %s", path, strerror(errno));
+        return 0;
+    }
+
+    char line[256];
+    int line_number = 0;
+    int num_set = 0;
+    while (fgets(line, sizeof(line), file)) {
+        line_number++;
+
+        char name[64];
+        float mean, stddev;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        if (sscanf(p, "%63s %f %f", name, &mean, &stddev) != 3 || !(stddev > 0.0f)) {
+            log_warn("Features: %s:%d: expected \"<feature> <mean> <stddev>\"", path, line_number);
+            continue;
+        }
+
+        int feature = parse_feature_name(name);
+        if (feature < 0) {
+            log_warn("Features: %s:%d: unknown feature %s", path, line_number, name);
+            continue;
+        }
+        if (feature >= size) continue;     // Beyond the model's inputs
+
+        scale[feature] = 1.0f / stddev;
+        offset[feature] = -mean / stddev;
+        num_set++;
+    }
+    fclose(file);
+
+    log_info("Features: %d normalized by %s", num_set, path);
+    return num_set;
+}
+
+// Raw features into FEATURE_PADDED(FEATURE_VECTOR_SIZE) floats
+void build_feature_vector(const SystemState *state, const HardwareState *hardware, float *features) {
+    features[FEATURE_CPU_USAGE] = (float)state->cpu_usage;
+    features[FEATURE_MEMORY_USAGE] = (float)state->memory_usage;
+    features[FEATURE_IO_USAGE] = (float)state->io_usage;
+    features[FEATURE_NETWORK_USAGE] = (float)state->network_usage;
+    features[FEATURE_NUM_PROCESSES] = (float)state->num_processes;
+    features[FEATURE_NUM_USERS] = (float)state->num_users;
+    features[FEATURE_BATTERY_LEVEL] = (float)state->battery_level;
+    features[FEATURE_ON_AC_POWER] = (float)state->on_ac_power;
+    memcpy(features + FEATURE_HARDWARE_BASE, hardware,
+           sizeof(float) * (FEATURE_VECTOR_SIZE - FEATURE_HARDWARE_BASE));
+    memset(features + FEATURE_VECTOR_SIZE, 0,
+           sizeof(float) * (FEATURE_PADDED(FEATURE_VECTOR_SIZE) - FEATURE_VECTOR_SIZE));
+}
+
+// One pass over the features, a cache line at a time. The fixed-width
+// inner loop has no remainder to handle, so it is vectorized even at -O2.
+void normalize_features(const float *restrict features, const float *restrict scale,
+                        const float *restrict offset, float *restrict output, int size) {
+    for (int line = 0; line < size; line += FEATURE_LANES) {
+        for (int i = line; i < line + FEATURE_LANES; i++) {
+            output[i] = features[i] * scale[i] + offset[i];
+        }
+    }
+}
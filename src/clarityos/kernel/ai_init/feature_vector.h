@@ -0,0 +1,48 @@
+#ifndef FEATURE_VECTOR_H
+#define FEATURE_VECTOR_H
+
+#include "system_state.h"
+
+// Model input features
+//
+// Models see the system as FEATURE_VECTOR_SIZE features in a fixed order:
+// the SystemState fields, then the HardwareState ones in struct order,
+// ending with the load of the governed services. A
+// model with fewer inputs takes the leading features; inputs past the end
+// stay zero.
+//
+// Every feature is normalized as x * scale + offset. A model's metadata
+// sets the coefficients: "<model path>" FEATURE_METADATA_SUFFIX holds one
+// "<feature> <mean> <stddev>" line per feature, giving (x - mean) / stddev.
+// Features it does not list keep a built-in default that maps their usual
+// range onto 0..1. The coefficients are computed once, when the model is
+// loaded, so building an input is one multiply-add pass. The pass runs
+// over whole cache lines of FEATURE_LANES floats: every buffer it touches
+// is padded to a multiple of that, with zero coefficients in the padding.
+
+#define FEATURE_METADATA_SUFFIX ".features"
+
+#define FEATURE_CPU_USAGE           0
+#define FEATURE_MEMORY_USAGE        1
+#define FEATURE_IO_USAGE            2
+#define FEATURE_NETWORK_USAGE       3
+#define FEATURE_NUM_PROCESSES       4
+#define FEATURE_NUM_USERS           5
+#define FEATURE_BATTERY_LEVEL       6
+#define FEATURE_ON_AC_POWER         7
+#define FEATURE_HARDWARE_BASE       8   // HardwareState, psi_cpu_some onwards
+#define FEATURE_NODE_MEMORY_USAGE   (FEATURE_HARDWARE_BASE + 8)
+#define FEATURE_CORE_USAGE          (FEATURE_NODE_MEMORY_USAGE + HW_MAX_NUMA_NODES)
+#define FEATURE_SERVICE_LOAD        (FEATURE_CORE_USAGE + HW_MAX_CPUS)
+#define FEATURE_VECTOR_SIZE         (FEATURE_SERVICE_LOAD + 4)
+
+#define FEATURE_LANES 16                // Floats per cache line
+#define FEATURE_PADDED(n) (((n) + FEATURE_LANES - 1) / FEATURE_LANES * FEATURE_LANES)
+
+// Function prototypes
+int load_feature_normalization(const char *model_path, float *scale, float *offset, int size);
+void build_feature_vector(const SystemState *state, const HardwareState *hardware, float *features);
+void normalize_features(const float *restrict features, const float *restrict scale,
+                        const float *restrict offset, float *restrict output, int size);
+
+#endif /* FEATURE_VECTOR_H */
@@ -0,0 +1,253 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include "init_log.h"
+
+atomic_int log_threshold = LOG_LEVEL_INFO;
+
+typedef struct {
+    int level;
+    char text[LOG_LINE_MAX];
+} LogEntry;
+
+// Single-producer ring owned by one thread. Rings are never released;
+// ai_init's threads live as long as the process.
+typedef struct {
+    _Atomic uint32_t head;      // Advanced by the owning thread
+    _Atomic uint32_t tail;      // Advanced by the log thread
+    atomic_uint dropped;        // Messages lost to a full ring
+    LogEntry entries[LOG_RING_ENTRIES];
+} LogRing;
+
+static LogRing rings[LOG_MAX_THREADS];
+static atomic_int num_rings = 0;
+static _Thread_local LogRing *thread_ring;
+static _Thread_local int thread_ring_claimed;
+
+static pthread_t log_thread;
+static atomic_int log_running = 0;
+static atomic_int wake_fd = -1;
+
+// /dev/kmsg when running as PID 1, stderr otherwise
+static int out_fd = STDERR_FILENO;
+static int use_kmsg = 0;
+
+// Syslog priorities used for the /dev/kmsg prefix, by LogLevel
+static const int kmsg_priorities[] = { 3, 4, 6, 7 };
+
+static uint64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// Returns 1 if the site may emit now, with the number of its messages
+// suppressed since the last one it emitted
+static int admit_site(LogSite *site, int *suppressed) {
+    uint64_t now = monotonic_ms();
+    uint64_t start = atomic_load_explicit(&site->window_start_ms, memory_order_relaxed);
+    if (now - start >= LOG_SITE_WINDOW_MS &&
+        atomic_compare_exchange_strong(&site->window_start_ms, &start, now)) {
+        atomic_store(&site->emitted, 0);
+    }
+
+    if (atomic_fetch_add(&site->emitted, 1) >= LOG_SITE_BURST) {
+        atomic_fetch_add(&site->suppressed, 1);
+        return 0;
+    }
+    *suppressed = atomic_exchange(&site->suppressed, 0);
+    return 1;
+}
+
+static void format_entry(LogEntry *entry, LogLevel level, int suppressed, const char *format, va_list args) {
+    entry->level = level;
+    int len = vsnprintf(entry->text, sizeof(entry->text), format, args);
+    if (len < 0) len = 0;
+    if (suppressed > 0 && len < (int)sizeof(entry->text)) {
+        snprintf(entry->text + len, sizeof(entry->text) - (size_t)len,
+                 " (%d similar messages suppressed)", suppressed);
+    }
+}
+
+static void emit_entry(const LogEntry *entry) {
+    char line[LOG_LINE_MAX + 16];
+    int len;
+    if (use_kmsg) {
+        len = snprintf(line, sizeof(line), "<%d>ai_init: %s\n", kmsg_priorities[entry->level], entry->text);
+    } else {
+        len = snprintf(line, sizeof(line), "%s\n", entry->text);
+    }
+    if (len > (int)sizeof(line) - 1) len = sizeof(line) - 1;
+
+    // One write per message: /dev/kmsg takes one record per write
+    if (write(out_fd, line, (size_t)len) < 0) {
+        // Nowhere left to report it
+    }
+}
+
+static LogRing *get_thread_ring() {
+    if (!thread_ring_claimed) {
+        thread_ring_claimed = 1;
+        int index = atomic_fetch_add(&num_rings, 1);
+        thread_ring = index < LOG_MAX_THREADS ? &rings[index] : NULL;
+    }
+    return thread_ring;
+}
+
+void log_write(LogSite *site, LogLevel level, const char *format, ...) {
+    int suppressed = 0;
+    if (!admit_site(site, &suppressed)) return;
+
+    va_list args;
+    va_start(args, format);
+
+    // Without the log thread, or beyond LOG_MAX_THREADS, write directly
+    LogRing *ring = atomic_load(&log_running) ? get_thread_ring() : NULL;
+    if (!ring) {
+        LogEntry entry;
+        format_entry(&entry, level, suppressed, format, args);
+        va_end(args);
+        emit_entry(&entry);
+        return;
+    }
+
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail >= LOG_RING_ENTRIES) {
+        va_end(args);
+        atomic_fetch_add(&ring->dropped, 1);
+        return;
+    }
+
+    format_entry(&ring->entries[head & (LOG_RING_ENTRIES - 1)], level, suppressed, format, args);
+    va_end(args);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    if (level == LOG_LEVEL_ERROR) {
+        uint64_t one = 1;
+        int fd = atomic_load(&wake_fd);
+        if (fd >= 0 && write(fd, &one, sizeof(one)) < 0) {
+            // Flushed at the next interval instead
+        }
+    }
+}
+
+static void drain_rings() {
+    int count = atomic_load(&num_rings);
+    if (count > LOG_MAX_THREADS) count = LOG_MAX_THREADS;
+
+    for (int r = 0; r < count; r++) {
+        LogRing *ring = &rings[r];
+        uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        for (; tail != head; tail++) {
+            emit_entry(&ring->entries[tail & (LOG_RING_ENTRIES - 1)]);
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+
+        unsigned int dropped = atomic_exchange(&ring->dropped, 0);
+        if (dropped > 0) {
+            LogEntry entry = { LOG_LEVEL_WARN, "" };
+            snprintf(entry.text, sizeof(entry.text), "Log: %u messages dropped", dropped);
+            emit_entry(&entry);
+        }
+    }
+}
+
+static void *log_thread_func(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { atomic_load(&wake_fd), POLLIN, 0 };
+
+    while (atomic_load(&log_running)) {
+        if (poll(&pfd, 1, LOG_FLUSH_INTERVAL_MS) > 0) {
+            uint64_t value;
+            if (read(pfd.fd, &value, sizeof(value)) < 0) {
+                // Spurious wakeup
+            }
+        }
+        drain_rings();
+    }
+
+    drain_rings();
+    return NULL;
+}
+
+static int parse_log_level(const char *name) {
+    static const char *names[] = { "error", "warn", "info", "debug" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        if (strcasecmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+int init_logging() {
+    const char *level_name = getenv(LOG_LEVEL_ENV);
+    if (level_name) {
+        int level = parse_log_level(level_name);
+        if (level >= 0) {
+            set_log_level(level);
+        } else {
+            log_warn("Log: unknown level %s", level_name);
+        }
+    }
+
+    // The console is slow and shared; as PID 1, log to the kernel buffer
+    if (getpid() == 1) {
+        int fd = open("/dev/kmsg", O_WRONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            out_fd = fd;
+            use_kmsg = 1;
+        }
+    }
+
+    int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (fd < 0) {
+        log_error("Log: eventfd: %s", strerror(errno));
+        return -1;
+    }
+    atomic_store(&wake_fd, fd);
+
+    atomic_store(&log_running, 1);
+    if (pthread_create(&log_thread, NULL, log_thread_func, NULL) != 0) {
+        atomic_store(&log_running, 0);
+        atomic_store(&wake_fd, -1);
+        close(fd);
+        log_error("Log: cannot start log thread; logging synchronously");
+        return -1;
+    }
+    return 0;
+}
+
+void shutdown_logging() {
+    if (atomic_load(&log_running)) {
+        atomic_store(&log_running, 0);
+        uint64_t one = 1;
+        if (write(atomic_load(&wake_fd), &one, sizeof(one)) < 0) {
+            // The thread still exits at its next poll timeout
+        }
+        pthread_join(log_thread, NULL);
+
+        close(atomic_exchange(&wake_fd, -1));
+    }
+
+    // init_logging() opens /dev/kmsg again
+    if (use_kmsg) {
+        close(out_fd);
+        out_fd = STDERR_FILENO;
+        use_kmsg = 0;
+    }
+}
+
+void set_log_level(LogLevel level) {
+    atomic_store(&log_threshold, level);
+}
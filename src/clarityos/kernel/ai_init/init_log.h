@@ -0,0 +1,61 @@
+#ifndef INIT_LOG_H
+#define INIT_LOG_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Leveled diagnostics
+//
+// A message below the current level costs one relaxed load. An enabled one is
+// formatted into the calling thread's own ring and written out by the log
+// thread, to /dev/kmsg when running as PID 1 and to stderr otherwise, so no
+// caller ever blocks on the console. Each call site may emit at most
+// LOG_SITE_BURST messages per LOG_SITE_WINDOW_MS; the rest are counted and
+// reported with the site's next message.
+
+typedef enum {
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG
+} LogLevel;
+
+#define LOG_LEVEL_ENV "AI_INIT_LOG_LEVEL"  // error, warn, info or debug
+
+#define LOG_LINE_MAX 240                // Including the terminating NUL
+#define LOG_RING_ENTRIES 64             // Per thread, power of two
+#define LOG_MAX_THREADS 16
+#define LOG_FLUSH_INTERVAL_MS 100       // Errors are flushed immediately
+
+#define LOG_SITE_BURST 10
+#define LOG_SITE_WINDOW_MS 10000
+
+// Rate limit state of one call site
+typedef struct {
+    _Atomic uint64_t window_start_ms;
+    atomic_int emitted;                 // In the current window
+    atomic_int suppressed;              // Not yet reported
+} LogSite;
+
+extern atomic_int log_threshold;
+
+#define log_message(level, ...) do { \
+        if ((int)(level) <= atomic_load_explicit(&log_threshold, memory_order_relaxed)) { \
+            static LogSite log_site_; \
+            log_write(&log_site_, (level), __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define log_error(...) log_message(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...)  log_message(LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_info(...)  log_message(LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_debug(...) log_message(LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+// Function prototypes
+int init_logging();
+void shutdown_logging();
+void set_log_level(LogLevel level);
+void log_write(LogSite *site, LogLevel level, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#endif /* INIT_LOG_H */
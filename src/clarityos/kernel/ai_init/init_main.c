@@ -0,0 +1,283 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "process_manager.h"
+#include "resource_governor.h"
+#include "system_monitor.h"
+#include "anomaly_detector.h"
+#include "system_state.h"
+#include "learning_engine.h"
+#include "learning_log.h"
+#include "model_updater.h"
+#include "memory_reclaimer.h"
+#include "process_telemetry.h"
+#include "decision_pipeline.h"
+#include "cpu_topology.h"
+#include "restart_snapshot.h"
+#include "latency_stats.h"
+#include "boot_trace.h"
+#include "init_log.h"
+
+// Interval between periodic resource and process adjustment decisions
+#define DECISION_INTERVAL_MS 10000
+
+// Anomaly events bring the next decision forward, but decisions stay at
+// least this far apart
+#define ANOMALY_DECISION_MIN_INTERVAL_MS 1000
+
+// epoll tags of the decision loop
+enum {
+    LOOP_PROCESS_EVENTS,
+    LOOP_ANOMALY_EVENTS,
+    LOOP_DECISION_RESULTS,
+    LOOP_REEXEC
+};
+
+// Set when this image resumed from a re-exec snapshot instead of booting
+static int resumed = 0;
+
+static uint64_t monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static void run_boot_sequence() {
+    SystemState state = get_current_system_state();
+    int span = boot_trace_begin("generate_optimal_sequence");
+    ProcessGroup *groups = generate_optimal_sequence(state);
+    boot_trace_end(span);
+    if (!groups) {
+        log_error("No boot sequence generated");
+        return;
+    }
+
+    struct timespec start, end;
+    span = boot_trace_begin("start_process_groups");
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int failed = start_process_groups(groups) < 0;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    boot_trace_end(span);
+
+    if (failed) {
+        log_error("Boot completed with essential process failures");
+    } else {
+        log_info("Boot sequence completed");
+    }
+    free_process_groups(groups);
+
+    // Outcome of the boot decision, for training
+    float outcome[] = {
+        (float)(end.tv_sec - start.tv_sec) + (float)(end.tv_nsec - start.tv_nsec) / 1e9f,
+        (float)failed
+    };
+    learning_log_event(LOG_PRODUCER_MAIN, LOG_RECORD_OUTCOME, LOG_OUTCOME_BOOT, outcome, 2);
+}
+
+// With the pipeline running, the decision is only submitted here; its
+// process adjustments are applied by complete_decisions()
+static void run_decisions() {
+    unsigned int heads = DECISION_RESOURCE_POLICY | DECISION_PROCESS_ADJUST;
+    SystemState state;
+    HardwareState hardware;
+    get_published_state(&state, &hardware);
+
+    if (decision_pipeline_running()) {
+        if (submit_decision(state, &hardware, heads) < 0) {
+            log_debug("Decision pipeline busy, skipping decision");
+        }
+    } else {
+        static DecisionResult decisions;
+        if (run_decision_heads(state, &hardware, heads, &decisions) < 0) return;
+        apply_process_adjustments(&decisions.adjustments);
+        static ProcessTableView processes;
+        update_process_view(&processes);
+        apply_resource_policy(&decisions.policy, &processes);
+    }
+
+    // The housekeeping threads see the process table only as published here
+    update_reclaimer_processes();
+    update_telemetry_services();
+
+    write_latency_metrics(LATENCY_METRICS_PATH);
+
+    // By the first tick, processes have had time to send a heartbeat. A
+    // resumed image keeps the trace of the boot it resumed from.
+    if (!resumed) finish_boot_trace(BOOT_TRACE_PATH);
+}
+
+// Returns the number of anomaly events taken from the detector's queue
+static int take_anomaly_events() {
+    AnomalyEvent events[16];
+    int total = 0;
+    int n;
+
+    while ((n = anomaly_poll_events(events, 16)) > 0) {
+        for (int i = 0; i < n; i++) {
+            log_debug("Decision loop: %s %s anomaly", anomaly_series_name(events[i].series),
+                      anomaly_kind_name(events[i].kind));
+        }
+        total += n;
+    }
+    return total;
+}
+
+static void watch_decision_results(int loop_fd) {
+    if (decision_pipeline_event_fd() < 0) return;
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = LOOP_DECISION_RESULTS };
+    epoll_ctl(loop_fd, EPOLL_CTL_ADD, decision_pipeline_event_fd(), &ev);
+}
+
+// Replace this image with a fresh execve of the binary (restart_snapshot.h).
+// Returns only if that fails, with everything running again.
+static void reexec(int loop_fd) {
+    log_info("Re-exec requested");
+    stop_decision_pipeline();
+    stop_process_telemetry();
+    stop_memory_reclaimer();
+    stop_model_updater();
+
+    int snapshot_fd = write_restart_snapshot();
+    if (snapshot_fd >= 0) {
+        // The monitor is the last thread still logging; it must not append
+        // to the learning log or write log lines while either is reopened
+        pause_system_monitor();
+        shutdown_learning_log();
+        shutdown_logging();
+        exec_restart(snapshot_fd);
+        init_logging();
+        init_learning_storage();
+        resume_system_monitor();
+    }
+
+    log_error("Re-exec failed, continuing");
+    start_model_updater();
+    start_memory_reclaimer();
+    start_process_telemetry();
+    start_decision_pipeline();
+    watch_decision_results(loop_fd);
+}
+
+// Decisions run every DECISION_INTERVAL_MS, measured from the previous one
+// so that process events do not postpone them, and early on anomalies
+static void run_decision_loop() {
+    int loop_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop_fd < 0) {
+        log_error("epoll_create1: %s", strerror(errno));
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = LOOP_PROCESS_EVENTS };
+    epoll_ctl(loop_fd, EPOLL_CTL_ADD, process_manager_event_fd(), &ev);
+    if (anomaly_event_fd() >= 0) {
+        ev.data.u32 = LOOP_ANOMALY_EVENTS;
+        epoll_ctl(loop_fd, EPOLL_CTL_ADD, anomaly_event_fd(), &ev);
+    }
+    if (restart_signal_fd() >= 0) {
+        ev.data.u32 = LOOP_REEXEC;
+        epoll_ctl(loop_fd, EPOLL_CTL_ADD, restart_signal_fd(), &ev);
+    }
+    watch_decision_results(loop_fd);
+
+    uint64_t last_decision = monotonic_ms();
+    uint64_t next_decision = last_decision + DECISION_INTERVAL_MS;
+
+    for (;;) {
+        uint64_t now = monotonic_ms();
+        struct epoll_event events[4];
+        int n = epoll_wait(loop_fd, events, 4, next_decision > now ? (int)(next_decision - now) : 0);
+        if (n < 0 && errno != EINTR) {
+            log_error("epoll_wait: %s", strerror(errno));
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u32 == LOOP_PROCESS_EVENTS) {
+                handle_process_events();
+            } else if (events[i].data.u32 == LOOP_DECISION_RESULTS) {
+                complete_decisions();
+            } else if (events[i].data.u32 == LOOP_REEXEC) {
+                if (take_reexec_request()) reexec(loop_fd);
+            } else if (take_anomaly_events() > 0) {
+                uint64_t earliest = last_decision + ANOMALY_DECISION_MIN_INTERVAL_MS;
+                if (earliest < next_decision) next_decision = earliest;
+            }
+        }
+
+        now = monotonic_ms();
+        if (now < next_decision) continue;
+
+        run_decisions();
+        last_decision = now;
+        next_decision = now + DECISION_INTERVAL_MS;
+    }
+    close(loop_fd);
+}
+
+int main(int argc, char **argv) {
+    (void)argc;
+    log_info("ClarityOS AI init starting");
+
+    // Before the process manager, which copies the environment for services
+    int restored = init_restart(argv);
+
+    // First thread-wise: blocks SIGCHLD before any thread exists
+    int span = boot_trace_begin("init_process_manager");
+    if (init_process_manager() < 0) {
+        log_error("Failed to initialize process manager");
+        return EXIT_FAILURE;
+    }
+    boot_trace_end(span);
+    init_logging();
+    if (restored) {
+        // The services are still running; without their table, boot again
+        resumed = restore_snapshot(SNAPSHOT_PROCESS_TABLE) == 0;
+        if (resumed) restore_snapshot(SNAPSHOT_STATE_HISTORY);
+    }
+
+    const char *adaptive = getenv(ADAPTIVE_SAMPLING_ENV);
+    if (adaptive && strcmp(adaptive, "0") == 0) set_adaptive_sampling(0);
+    span = boot_trace_begin("init_system_monitor");
+    init_system_monitor();
+    boot_trace_end(span);
+    span = boot_trace_begin("init_learning_engine");
+    init_learning_engine();
+    boot_trace_end(span);
+    if (init_resource_governor() < 0) {
+        log_warn("Resource policies will not be enforced");
+    }
+    // The main thread stays unpinned: the processes it starts inherit its affinity
+    init_housekeeping_cpus(getenv(HOUSEKEEPING_CPUS_ENV));
+    pin_system_monitor();
+
+    if (!resumed) run_boot_sequence();
+    span = boot_trace_begin("load_deferred_models");
+    load_deferred_models();
+    boot_trace_end(span);
+    if (resumed) restore_snapshot(SNAPSHOT_DECISION_CACHE);
+    release_restart_snapshot();
+
+    // Models are only refit once boot no longer competes for the CPU
+    start_model_updater();
+    start_memory_reclaimer();
+    start_process_telemetry();
+    if (start_decision_pipeline() < 0) {
+        log_warn("Decisions will run inline");
+    }
+
+    run_decision_loop();
+
+    stop_decision_pipeline();
+    stop_process_telemetry();
+    stop_memory_reclaimer();
+    stop_model_updater();
+    shutdown_resource_governor();
+    stop_system_monitor();
+    shutdown_learning_log();
+    shutdown_logging();
+    return EXIT_SUCCESS;
+}
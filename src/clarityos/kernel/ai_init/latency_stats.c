@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "latency_stats.h"
+#include "decision_cache.h"
+#include "init_log.h"
+
+// Values below 2 * LATENCY_SUB_BUCKETS land in a bucket of their own; each
+// higher power of two is split into LATENCY_SUB_BUCKETS equal buckets
+#define SUB_BUCKET_BITS 5
+#define NUM_BUCKETS ((LATENCY_MAX_EXPONENT - SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKETS)
+#define MAX_VALUE ((1ull << (LATENCY_MAX_EXPONENT + 1)) - 1)
+
+_Static_assert(LATENCY_SUB_BUCKETS == 1 << SUB_BUCKET_BITS, "SUB_BUCKET_BITS must match LATENCY_SUB_BUCKETS");
+
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum_ns;
+    _Atomic uint64_t max_ns;
+    _Atomic uint64_t buckets[NUM_BUCKETS];
+} __attribute__((aligned(64))) LatencyHistogram;
+
+static LatencyHistogram histograms[NUM_LATENCY_STAGES];
+
+// Metric label of each stage, by LatencyStage
+static const char *stage_names[NUM_LATENCY_STAGES] = {
+    "state_update", "collect_cpu", "collect_memory", "collect_io", "collect_network",
+    "collect_processes", "collect_users", "collect_power", "collect_hardware", "state_tensor",
+    "inference", "resource_policy", "process_adjust", "decision_pipeline"
+};
+
+static int bucket_index(uint64_t ns) {
+    if (ns > MAX_VALUE) ns = MAX_VALUE;
+    if (ns < 2 * LATENCY_SUB_BUCKETS) return (int)ns;
+
+    int shift = 63 - __builtin_clzll(ns) - SUB_BUCKET_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)(ns >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+// Highest value that maps to a bucket
+static uint64_t bucket_value(int index) {
+    if (index < 2 * LATENCY_SUB_BUCKETS) return (uint64_t)index;
+
+    int shift = index / LATENCY_SUB_BUCKETS - 1;
+    uint64_t sub = (uint64_t)(index % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+void latency_record_value(LatencyStage stage, uint64_t ns) {
+    LatencyHistogram *h = &histograms[stage];
+
+    atomic_fetch_add_explicit(&h->buckets[bucket_index(ns)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum_ns, ns, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&h->max_ns, memory_order_relaxed);
+    while (ns > max &&
+           !atomic_compare_exchange_weak_explicit(&h->max_ns, &max, ns,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void latency_record(LatencyStage stage, uint64_t start_ns) {
+    latency_record_value(stage, latency_now() - start_ns);
+}
+
+const char *latency_stage_name(LatencyStage stage) {
+    return stage_names[stage];
+}
+
+uint64_t latency_count(LatencyStage stage) {
+    return atomic_load_explicit(&histograms[stage].count, memory_order_relaxed);
+}
+
+uint64_t latency_max(LatencyStage stage) {
+    return atomic_load_explicit(&histograms[stage].max_ns, memory_order_relaxed);
+}
+
+// Value at the given percentile (0-100), or 0 before the first sample.
+// Concurrent recording may make the result lag by a few samples.
+uint64_t latency_percentile(LatencyStage stage, double percentile) {
+    LatencyHistogram *h = &histograms[stage];
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    if (count == 0) return 0;
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)count + 0.5);
+    if (target < 1) target = 1;
+    if (target > count) target = count;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= target) {
+            uint64_t value = bucket_value(i);
+            uint64_t max = latency_max(stage);
+            return value < max ? value : max;
+        }
+    }
+    return latency_max(stage);
+}
+
+// Write every stage's p50, p99, max, sum and count in the Prometheus text
+// format. The file is replaced atomically, so a collector never sees a
+// partial one.
+int write_latency_metrics(const char *path) {
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+    char *slash = strrchr(dir, '/');
+    if (slash && slash != dir) {
+        *slash = '\0';
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+            log_error("Latency metrics: cannot create %s: %s", dir, strerror(errno));
+            return -1;
+        }
+    }
+
+    char tmp_path[sizeof(dir) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE *file = fopen(tmp_path, "we");
+    if (!file) {
+        log_error("Latency metrics: cannot write %s: %s", tmp_path, strerror(errno));
+        return -1;
+    }
+
+    fprintf(file, "# HELP ai_init_stage_latency_seconds Latency of ai_init hot-path stages.\n");
+    fprintf(file, "# TYPE ai_init_stage_latency_seconds summary\n");
+    for (int s = 0; s < NUM_LATENCY_STAGES; s++) {
+        if (latency_count(s) == 0) continue;
+        fprintf(file, "ai_init_stage_latency_seconds{stage=\"%s\",quantile=\"0.5\"} %.9f\n",
+                stage_names[s], latency_percentile(s, 50.0) / 1e9);
+        fprintf(file, "ai_init_stage_latency_seconds{stage=\"%s\",quantile=\"0.99\"} %.9f\n",
+                stage_names[s], latency_percentile(s, 99.0) / 1e9);
+        fprintf(file, "ai_init_stage_latency_seconds_sum{stage=\"%s\"} %.9f\n",
+                stage_names[s], atomic_load(&histograms[s].sum_ns) / 1e9);
+        fprintf(file, "ai_init_stage_latency_seconds_count{stage=\"%s\"} %llu\n",
+                stage_names[s], (unsigned long long)latency_count(s));
+    }
+
+    fprintf(file, "# HELP ai_init_stage_latency_max_seconds Slowest run of each ai_init stage.\n");
+    fprintf(file, "# TYPE ai_init_stage_latency_max_seconds gauge\n");
+    for (int s = 0; s < NUM_LATENCY_STAGES; s++) {
+        if (latency_count(s) == 0) continue;
+        fprintf(file, "ai_init_stage_latency_max_seconds{stage=\"%s\"} %.9f\n",
+                stage_names[s], latency_max(s) / 1e9);
+    }
+
+    write_decision_cache_metrics(file);
+
+    if (fclose(file) != 0 || rename(tmp_path, path) < 0) {
+        log_error("Latency metrics: cannot publish %s: %s", path, strerror(errno));
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
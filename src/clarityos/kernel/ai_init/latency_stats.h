@@ -0,0 +1,62 @@
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Hot-path latency instrumentation
+//
+// Each stage records into its own log-linear (HDR) histogram: exact below
+// 2 * LATENCY_SUB_BUCKETS ns and within 1/LATENCY_SUB_BUCKETS (about 3%)
+// above, up to LATENCY_MAX_EXPONENT. Recording is a clock read and two
+// relaxed atomic adds, and may happen from any thread. The histograms are
+// cumulative since start and are exported as a Prometheus textfile.
+
+typedef enum {
+    LATENCY_STATE_UPDATE,           // update_system_state_metrics(), all collectors
+    LATENCY_COLLECT_CPU,
+    LATENCY_COLLECT_MEMORY,
+    LATENCY_COLLECT_IO,
+    LATENCY_COLLECT_NETWORK,
+    LATENCY_COLLECT_PROCESSES,
+    LATENCY_COLLECT_USERS,
+    LATENCY_COLLECT_POWER,
+    LATENCY_COLLECT_HARDWARE,       // Per-core, NUMA, PSI, cpufreq and thermal state
+    LATENCY_STATE_TENSOR,           // create_system_state_tensor()
+    LATENCY_INFERENCE,              // run_model_inference()
+    LATENCY_RESOURCE_POLICY,        // apply_resource_policy()
+    LATENCY_PROCESS_ADJUST,         // apply_process_adjustments()
+    LATENCY_DECISION_PIPELINE,      // Decision submitted to fully applied (decision_pipeline.h)
+    NUM_LATENCY_STAGES
+} LatencyStage;
+
+#define LATENCY_SUB_BUCKETS 32              // Per power of two, power of two
+#define LATENCY_MAX_EXPONENT 40             // Values are clamped at 2^40 ns (18 min)
+
+#ifndef LATENCY_METRICS_PATH
+#define LATENCY_METRICS_PATH "/run/ai_init/metrics.prom"
+#endif
+
+static inline uint64_t latency_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Time one statement as a stage
+#define LATENCY_TIMED(stage, statement) do { \
+        uint64_t latency_start_ = latency_now(); \
+        statement; \
+        latency_record((stage), latency_start_); \
+    } while (0)
+
+// Function prototypes
+void latency_record(LatencyStage stage, uint64_t start_ns);
+void latency_record_value(LatencyStage stage, uint64_t ns);
+uint64_t latency_percentile(LatencyStage stage, double percentile);
+uint64_t latency_max(LatencyStage stage);
+uint64_t latency_count(LatencyStage stage);
+const char *latency_stage_name(LatencyStage stage);
+int write_latency_metrics(const char *path);
+
+#endif /* LATENCY_STATS_H */
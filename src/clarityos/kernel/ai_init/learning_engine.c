@@ -1,126 +1,396 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include "learning_engine.h"
 #include "model_runtime.h"
+#include "decision_cache.h"
+#include "native_model.h"
+#include "learning_log.h"
+#include "model_updater.h"
+#include "init_log.h"
+#include "latency_stats.h"
+#include "boot_trace.h"
+#include "cpu_topology.h"
 
-// Model handles
-static ModelHandle *boot_model = NULL;
-static ModelHandle *resource_model = NULL;
-static ModelHandle *process_model = NULL;
+// Optional fused model producing every decision head from one pass
+#define FUSED_MODEL_PATH "decision_model.onnx"
+#define FUSED_MODEL_HEADS 3
+
+// Published model handles, one per ModelSlot
+//
+// Readers never block on an update. A reader counts itself into the current
+// epoch's reader count for the duration of its section; replace_slot_model()
+// swaps the pointer, advances the epoch, and frees the old model only once
+// the previous epoch's readers have all left.
+static ModelHandle *_Atomic model_slots[NUM_MODEL_SLOTS];
+static _Atomic unsigned int model_epoch;
+static _Atomic int model_readers[2];
+
+// Load a decision model by base name. The native format needs no runtime,
+// so it is preferred for the boot model, whose decision is made before the
+// filesystem holding ONNX Runtime may be mounted. Other heads use ONNX when
+// the runtime is available and fall back to the native format.
+static ModelHandle *load_head_model(const char *base_name, int prefer_native, int deferred) {
+    char onnx_path[256];
+    char native_path[256];
+    
+    snprintf(onnx_path, sizeof(onnx_path), "%s.onnx", base_name);
+    snprintf(native_path, sizeof(native_path), "%s%s", base_name, NATIVE_MODEL_SUFFIX);
+    
+    int have_native = access(native_path, R_OK) == 0;
+    int have_onnx = model_runtime_has_onnx() && access(onnx_path, R_OK) == 0;
+    
+    const char *path = have_native && (prefer_native || !have_onnx) ? native_path : onnx_path;
+    
+    return deferred ? load_model_deferred(path) : load_model(path);
+}
 
 void init_learning_engine() {
+    ModelHandle *fused_model = NULL;
+    ModelHandle *resource_model = NULL;
+    ModelHandle *process_model = NULL;
+    
+    register_decision_processes();
+    
     // Initialize the model runtime
+    int span = boot_trace_begin("init_model_runtime");
     init_model_runtime();
+    boot_trace_end(span);
+    
+    // Prefer the fused multi-output model when one is installed
+    if (access(FUSED_MODEL_PATH, R_OK) == 0) {
+        fused_model = load_model(FUSED_MODEL_PATH);
+        if (fused_model && fused_model->num_outputs < FUSED_MODEL_HEADS) {
+            log_warn("Fused model has %d outputs, expected %d; using separate models",
+                     fused_model->num_outputs, FUSED_MODEL_HEADS);
+            unload_model(fused_model);
+            fused_model = NULL;
+        }
+    }
     
-    // Load models
-    boot_model = load_model("boot_model.onnx");
-    resource_model = load_model("resource_model.onnx");
-    process_model = load_model("process_model.onnx");
+    // Load models. Only the boot model is needed before boot completes;
+    // the others are mapped and bound on first use or in load_deferred_models()
+    if (!fused_model) {
+        atomic_store(&model_slots[MODEL_SLOT_BOOT], load_head_model("boot_model", 1, 0));
+        resource_model = load_head_model("resource_model", 0, 1);
+        process_model = load_head_model("process_model", 0, 1);
+    }
+    
+    // Periodic decisions are memoized; the boot sequence runs once
+    if (fused_model) attach_decision_cache(fused_model);
+    if (resource_model) attach_decision_cache(resource_model);
+    if (process_model) attach_decision_cache(process_model);
+    atomic_store(&model_slots[MODEL_SLOT_FUSED], fused_model);
+    atomic_store(&model_slots[MODEL_SLOT_RESOURCE], resource_model);
+    atomic_store(&model_slots[MODEL_SLOT_PROCESS], process_model);
     
     // Initialize learning storage
     init_learning_storage();
 }
 
-ProcessGroup *generate_optimal_sequence(SystemState state) {
-    // Prepare input tensor
-    Tensor *input = create_system_state_tensor(state);
+// Raw features of one decision. When heads run on separate models, they
+// are built by the first head that misses its cache; every model that
+// misses then normalizes them into its own bound input, since models differ
+// in input size and normalization.
+typedef struct {
+    SystemState state;
+    const HardwareState *hardware;
+    int built;
+    float values[FEATURE_PADDED(FEATURE_VECTOR_SIZE)] __attribute__((aligned(64)));
+} DecisionFeatures;
+
+static Tensor *encode_features(ModelHandle *model, DecisionFeatures *features) {
+    uint64_t start = latency_now();
+    Tensor *tensor = &model->input;
     
-    // Run inference
-    Tensor *output = run_model_inference(boot_model, input);
+    if (!features->built) {
+        build_feature_vector(&features->state, features->hardware, features->values);
+        features->built = 1;
+    }
+    normalize_features(features->values, model->feature_scale, model->feature_offset, tensor->data,
+                       model->num_features);
     
-    // Convert output tensor to process groups
-    ProcessGroup *groups = tensor_to_process_groups(output);
+    latency_record(LATENCY_STATE_TENSOR, start);
+    return tensor;
+}
+
+// Run inference unless the decision cache already holds the outputs for
+// this state's bucket
+static Tensor *run_cached_inference(ModelHandle *model, DecisionFeatures *features) {
+    uint64_t key = decision_cache_key(features->state, features->hardware);
     
-    // Clean up
-    free_tensor(input);
-    free_tensor(output);
+    if (ensure_model_loaded(model) < 0) return NULL;
     
-    return groups;
+    if (decision_cache_lookup(model, key)) {
+        return &model->outputs[0];
+    }
+    
+    // Run inference; the output tensor is owned by the model
+    Tensor *output = run_model_inference(model, encode_features(model, features));
+    decision_cache_store(model, key);
+    
+    return output;
 }
 
-ResourcePolicy generate_resource_policy(SystemState state) {
-    // Prepare input tensor
-    Tensor *input = create_system_state_tensor(state);
+// Decisions are logged by whichever thread runs them (see
+// set_decision_log_producer())
+static _Thread_local LogProducer decision_log_producer = LOG_PRODUCER_MAIN;
+
+void set_decision_log_producer(LogProducer producer) {
+    decision_log_producer = producer;
+}
+
+// Record what was decided, one record per item, as training data
+static void log_decisions(const DecisionResult *result) {
+    if (result->groups) {
+        for (int g = 0; result->groups[g].num_processes > 0; g++) {
+            for (int p = 0; p < result->groups[g].num_processes; p++) {
+                float values[] = { (float)g, (float)result->groups[g].processes[p] };
+                learning_log_event(decision_log_producer, LOG_RECORD_DECISION, DECISION_BOOT_SEQUENCE, values, 2);
+            }
+        }
+    }
+    for (int i = 0; i < result->policy.num_processes; i++) {
+        const ProcessResourcePolicy *p = &result->policy.process_policies[i];
+        float values[] = { (float)p->process, (float)p->cpu_quota, (float)p->memory_limit,
+                           (float)p->io_priority, (float)p->network_priority, (float)p->numa_node,
+                           (float)p->llc_domain, (float)p->smt_exclusive };
+        learning_log_event(decision_log_producer, LOG_RECORD_DECISION, DECISION_RESOURCE_POLICY, values, 8);
+    }
+    for (int i = 0; i < result->adjustments.num_adjustments; i++) {
+        const ProcessAdjustment *a = &result->adjustments.adjustments[i];
+        float values[] = { (float)a->process, (float)a->action, (float)a->priority };
+        learning_log_event(decision_log_producer, LOG_RECORD_DECISION, DECISION_PROCESS_ADJUST, values, 3);
+    }
+}
+
+int models_read_lock() {
+    for (;;) {
+        unsigned int epoch = atomic_load(&model_epoch);
+        int token = epoch & 1;
+        atomic_fetch_add(&model_readers[token], 1);
+        // Counted under the wrong epoch if an update advanced it meanwhile
+        if (atomic_load(&model_epoch) == epoch) return token;
+        atomic_fetch_sub(&model_readers[token], 1);
+    }
+}
+
+void models_read_unlock(int token) {
+    atomic_fetch_sub(&model_readers[token], 1);
+}
+
+// Only valid inside a models_read_lock() section
+ModelHandle *get_slot_model(ModelSlot slot) {
+    return atomic_load(&model_slots[slot]);
+}
+
+// Publish a new model for a slot and free the one it replaces. Called by
+// one updater at a time; blocks until no reader can still be using the old
+// model.
+void replace_slot_model(ModelSlot slot, ModelHandle *model) {
+    ModelHandle *old = atomic_exchange(&model_slots[slot], model);
     
-    // Run inference
-    Tensor *output = run_model_inference(resource_model, input);
+    unsigned int epoch = atomic_fetch_add(&model_epoch, 1);
+    while (atomic_load(&model_readers[epoch & 1]) > 0) {
+        usleep(1000);
+    }
     
-    // Convert output tensor to resource policy
-    ResourcePolicy policy = tensor_to_resource_policy(output);
+    if (old) unload_model(old);
+}
+
+int run_decision_heads(SystemState state, const HardwareState *hardware, unsigned int heads,
+                       DecisionResult *result) {
+    result->groups = NULL;
+    result->policy.process_policies = result->policy_storage;
+    result->policy.num_processes = 0;
+    result->adjustments.adjustments = result->adjustment_storage;
+    result->adjustments.num_adjustments = 0;
     
-    // Clean up
-    free_tensor(input);
-    free_tensor(output);
+    DecisionFeatures features;
+    features.state = state;
+    features.hardware = hardware;
+    features.built = 0;
     
-    return policy;
+    int token = models_read_lock();
+    ModelHandle *fused_model = get_slot_model(MODEL_SLOT_FUSED);
+    
+    if (fused_model) {
+        // One inference produces every head
+        run_cached_inference(fused_model, &features);
+        
+        if (heads & DECISION_BOOT_SEQUENCE) {
+            result->groups = tensor_to_process_groups(&fused_model->outputs[FUSED_OUTPUT_BOOT_SEQUENCE]);
+        }
+        if (heads & DECISION_RESOURCE_POLICY) {
+            tensor_to_resource_policy(&fused_model->outputs[FUSED_OUTPUT_RESOURCE_POLICY], result);
+        }
+        if (heads & DECISION_PROCESS_ADJUST) {
+            tensor_to_process_adjustments(&fused_model->outputs[FUSED_OUTPUT_PROCESS_ADJUST], result);
+        }
+        
+        models_read_unlock(token);
+        log_decisions(result);
+        return 0;
+    }
+    
+    ModelHandle *boot_model = get_slot_model(MODEL_SLOT_BOOT);
+    ModelHandle *resource_model = get_slot_model(MODEL_SLOT_RESOURCE);
+    ModelHandle *process_model = get_slot_model(MODEL_SLOT_PROCESS);
+    
+    if (heads & DECISION_BOOT_SEQUENCE) {
+        result->groups = tensor_to_process_groups(run_cached_inference(boot_model, &features));
+    }
+    if (heads & DECISION_RESOURCE_POLICY) {
+        tensor_to_resource_policy(run_cached_inference(resource_model, &features), result);
+    }
+    if (heads & DECISION_PROCESS_ADJUST) {
+        tensor_to_process_adjustments(run_cached_inference(process_model, &features), result);
+    }
+    models_read_unlock(token);
+    
+    log_decisions(result);
+    return 0;
 }
 
-ProcessAdjustments *get_process_adjustments(SystemState state) {
-    // Prepare input tensor
-    Tensor *input = create_system_state_tensor(state);
-    
-    // Run inference
-    Tensor *output = run_model_inference(process_model, input);
+// One-shot decisions. Their results are copied out of the DecisionResult;
+// free them with free_process_groups(), free_resource_policy() and
+// free_process_adjustments().
+ProcessGroup *generate_optimal_sequence(SystemState state) {
+    HardwareState hardware = get_current_hardware_state();
+    DecisionResult result;
+    run_decision_heads(state, &hardware, DECISION_BOOT_SEQUENCE, &result);
     
-    // Convert output tensor to process adjustments
-    ProcessAdjustments *adjustments = tensor_to_process_adjustments(output);
+    return result.groups;
+}
+
+ResourcePolicy generate_resource_policy(SystemState state) {
+    HardwareState hardware = get_current_hardware_state();
+    DecisionResult result;
+    run_decision_heads(state, &hardware, DECISION_RESOURCE_POLICY, &result);
     
-    // Clean up
-    free_tensor(input);
-    free_tensor(output);
+    ResourcePolicy policy = result.policy;
+    size_t size = sizeof(ProcessResourcePolicy) * (size_t)policy.num_processes;
+    policy.process_policies = malloc(size + 1);
+    if (policy.process_policies) {
+        memcpy(policy.process_policies, result.policy_storage, size);
+    } else {
+        policy.num_processes = 0;
+    }
+    return policy;
+}
+
+ProcessAdjustments *get_process_adjustments(SystemState state) {
+    HardwareState hardware = get_current_hardware_state();
+    DecisionResult result;
+    run_decision_heads(state, &hardware, DECISION_PROCESS_ADJUST, &result);
     
+    ProcessAdjustments *adjustments = malloc(sizeof(ProcessAdjustments));
+    if (!adjustments) return NULL;
+    *adjustments = result.adjustments;
+    size_t size = sizeof(ProcessAdjustment) * (size_t)adjustments->num_adjustments;
+    adjustments->adjustments = malloc(size + 1);
+    if (adjustments->adjustments) {
+        memcpy(adjustments->adjustments, result.adjustment_storage, size);
+    } else {
+        adjustments->num_adjustments = 0;
+    }
     return adjustments;
 }
 
+// Models are refit in the background by the model updater; this only asks
+// it to look for new candidates now rather than at its next interval
 void update_models() {
-    // In a real implementation, this would update the models based on collected data
-    // For this prototype, just print the action
-    printf("Updating AI models based on collected data\n");
+    request_model_update();
+}
+
+// Load models that were deferred at startup. Intended for an idle slot
+// after boot so that the first periodic decision does not pay load latency.
+void load_deferred_models() {
+    int token = models_read_lock();
+    for (int slot = 0; slot < NUM_MODEL_SLOTS; slot++) {
+        ModelHandle *model = get_slot_model(slot);
+        if (model) ensure_model_loaded(model);
+    }
+    models_read_unlock(token);
 }
 
 void init_learning_storage() {
-    // In a real implementation, this would initialize the storage for collected data
-    // For this prototype, just print the action
-    printf("Initializing learning storage\n");
+    // Training data goes to the append-only learning log; without it the
+    // engine keeps running on the in-memory history alone
+    if (init_learning_log(LEARNING_LOG_PATH) < 0) {
+        log_warn("Learning log unavailable, training data will not be kept");
+    }
 }
 
 // Tensor creation and conversion functions
-Tensor *create_system_state_tensor(SystemState state) {
-    // In a real implementation, this would create a tensor from the system state
-    // For this prototype, create a dummy tensor
-    Tensor *tensor = malloc(sizeof(Tensor));
-    tensor->data = malloc(sizeof(float) * 10);
-    tensor->size = 10;
+// Encode the state and its hardware state into the model's bound input
+// using the normalization precomputed at load time
+Tensor *create_system_state_tensor(ModelHandle *model, SystemState state, const HardwareState *hardware) {
+    if (ensure_model_loaded(model) < 0) return NULL;
     
-    // Fill with dummy data
-    for (int i = 0; i < tensor->size; i++) {
-        tensor->data[i] = 0.1 * i;
-    }
+    DecisionFeatures features;
+    features.state = state;
+    features.hardware = hardware;
+    features.built = 0;
+    return encode_features(model, &features);
+}
+
+// Processes known to the placeholder decisions, referenced by id
+static ProcessId logger_process = PROCESS_ID_NONE;
+static ProcessId network_process = PROCESS_ID_NONE;
+static ProcessId shell_process = PROCESS_ID_NONE;
+static ProcessId background_process = PROCESS_ID_NONE;
+
+// Register the processes decisions refer to. Decision loop only, like the
+// rest of the process table: decisions may be converted on the inference
+// worker, which only reads the ids. After a re-exec the restored entries
+// are found again under the same ids.
+void register_decision_processes() {
+    if (logger_process != PROCESS_ID_NONE) return;
     
-    return tensor;
+    logger_process = intern_process("system-logger");
+    network_process = intern_process("network-manager");
+    shell_process = intern_process("ai-shell");
+    background_process = intern_process("background-service");
+    
+    ProcessEntry *entry = get_process_entry(logger_process);
+    entry->essential = 1;
+    entry->notify_ready = 1;
+    entry->num_sockets = 1;
+    strcpy(entry->sockets[0], "dgram:/dev/log");
+    
+    entry = get_process_entry(network_process);
+    entry->essential = 1;
+    entry->notify_ready = 1;
+    entry->num_sockets = 1;
+    strcpy(entry->sockets[0], "/run/network-manager.sock");
+    
+    entry = get_process_entry(shell_process);
+    entry->num_dependencies = 1;
+    entry->dependencies[0] = logger_process;
 }
 
 ProcessGroup *tensor_to_process_groups(Tensor *tensor) {
     // In a real implementation, this would convert a tensor to process groups
-    // For this prototype, create dummy process groups
+    // For this prototype, create dummy process groups,
+    // ignoring the model output
+    (void)tensor;
     
     // Allocate memory for process groups (including a terminator)
     ProcessGroup *groups = malloc(sizeof(ProcessGroup) * 3);
     
     // First group: essential services
     groups[0].num_processes = 2;
-    groups[0].processes = malloc(sizeof(ProcessEntry) * groups[0].num_processes);
-    strcpy(groups[0].processes[0].name, "system-logger");
-    groups[0].processes[0].essential = 1;
-    strcpy(groups[0].processes[1].name, "network-manager");
-    groups[0].processes[1].essential = 1;
-    groups[0].wait_for_completion = 1;
+    groups[0].processes = malloc(sizeof(ProcessId) * groups[0].num_processes);
+    groups[0].processes[0] = logger_process;
+    groups[0].processes[1] = network_process;
+    groups[0].wait_for_completion = 0;
     
     // Second group: user services
     groups[1].num_processes = 1;
-    groups[1].processes = malloc(sizeof(ProcessEntry) * groups[1].num_processes);
-    strcpy(groups[1].processes[0].name, "ai-shell");
-    groups[1].processes[0].essential = 0;
+    groups[1].processes = malloc(sizeof(ProcessId) * groups[1].num_processes);
+    groups[1].processes[0] = shell_process;
     groups[1].wait_for_completion = 0;
     
     // Terminator
@@ -129,59 +399,62 @@ ProcessGroup *tensor_to_process_groups(Tensor *tensor) {
     return groups;
 }
 
-ResourcePolicy tensor_to_resource_policy(Tensor *tensor) {
+// Decoded into result->policy_storage
+void tensor_to_resource_policy(Tensor *tensor, DecisionResult *result) {
     // In a real implementation, this would convert a tensor to resource policy
-    // For this prototype, create a dummy resource policy
+    // For this prototype, create a dummy resource policy,
+    // ignoring the model output
+    (void)tensor;
     
-    ResourcePolicy policy;
-    policy.num_processes = 3;
-    policy.process_policies = malloc(sizeof(ProcessResourcePolicy) * policy.num_processes);
+    ResourcePolicy *policy = &result->policy;
+    policy->process_policies = result->policy_storage;
+    policy->num_processes = 3;
     
-    // Set dummy policies
-    for (int i = 0; i < policy.num_processes; i++) {
-        policy.process_policies[i].process = malloc(sizeof(ProcessEntry));
-        sprintf(policy.process_policies[i].process->name, "process-%d", i);
-        policy.process_policies[i].cpu_quota = 20 + i * 10;
-        policy.process_policies[i].memory_limit = 100 + i * 50;
-        policy.process_policies[i].io_priority = 3;
-        policy.process_policies[i].network_priority = 3;
+    // Set dummy policies, giving each service an LLC domain of its own
+    // where there are enough, so co-located services do not share a cache
+    ProcessId processes[] = { logger_process, network_process, shell_process };
+    int domains = topology_num_llc_domains();
+    for (int i = 0; i < policy->num_processes; i++) {
+        policy->process_policies[i].process = processes[i];
+        policy->process_policies[i].cpu_quota = 20 + i * 10;
+        policy->process_policies[i].memory_limit = 100 + i * 50;
+        policy->process_policies[i].io_priority = 3;
+        policy->process_policies[i].network_priority = 3;
+        policy->process_policies[i].numa_node = -1;
+        policy->process_policies[i].llc_domain = domains > 1 ? i % domains : -1;
+        policy->process_policies[i].smt_exclusive = 0;
     }
-    
-    return policy;
 }
 
-ProcessAdjustments *tensor_to_process_adjustments(Tensor *tensor) {
+// Decoded into result->adjustment_storage
+void tensor_to_process_adjustments(Tensor *tensor, DecisionResult *result) {
     // In a real implementation, this would convert a tensor to process adjustments
-    // For this prototype, create dummy adjustments
+    // For this prototype, create dummy adjustments,
+    // ignoring the model output
+    (void)tensor;
     
-    ProcessAdjustments *adjustments = malloc(sizeof(ProcessAdjustments));
+    ProcessAdjustments *adjustments = &result->adjustments;
+    adjustments->adjustments = result->adjustment_storage;
     adjustments->num_adjustments = 2;
-    adjustments->adjustments = malloc(sizeof(ProcessAdjustment) * adjustments->num_adjustments);
     
     // First adjustment: start a process
-    adjustments->adjustments[0].process = malloc(sizeof(ProcessEntry));
-    strcpy(adjustments->adjustments[0].process->name, "background-service");
+    adjustments->adjustments[0].process = background_process;
     adjustments->adjustments[0].action = ACTION_START;
     
     // Second adjustment: adjust priority
-    adjustments->adjustments[1].process = malloc(sizeof(ProcessEntry));
-    strcpy(adjustments->adjustments[1].process->name, "ai-shell");
+    adjustments->adjustments[1].process = shell_process;
     adjustments->adjustments[1].action = ACTION_ADJUST_PRIORITY;
     adjustments->adjustments[1].priority = 10;
-    
-    return adjustments;
-}
-
-// Memory management functions
-void free_tensor(Tensor *tensor) {
-    free(tensor->data);
-    free(tensor);
 }
 
+// Memory management functions, for the one-shot decisions
 void free_process_adjustments(ProcessAdjustments *adjustments) {
-    for (int i = 0; i < adjustments->num_adjustments; i++) {
-        free(adjustments->adjustments[i].process);
-    }
     free(adjustments->adjustments);
     free(adjustments);
+}
+
+void free_resource_policy(ResourcePolicy *policy) {
+    free(policy->process_policies);
+    policy->process_policies = NULL;
+    policy->num_processes = 0;
 }
\ No newline at end of file
@@ -4,6 +4,16 @@
 #include "process_manager.h"
 #include "resource_governor.h"
 #include "system_state.h"
+#include "feature_vector.h"
+#include "learning_log.h"
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Number of features in the system state input tensor
+#define SYSTEM_STATE_TENSOR_SIZE FEATURE_VECTOR_SIZE
+
+// Maximum number of outputs (heads) a single model can produce
+#define MODEL_MAX_OUTPUTS 4
 
 // Tensor data structure for model input/output
 typedef struct {
@@ -11,33 +21,100 @@ typedef struct {
     int size;
 } Tensor;
 
+// Inference backends a model handle can be bound to
+#define MODEL_BACKEND_DUMMY   0
+#define MODEL_BACKEND_ONNX    1
+#define MODEL_BACKEND_NATIVE  2
+
+struct DecisionCache;
+
 // Model handle structure
+//
+// Input and output tensors are bound to a single preallocated arena at
+// load time and reused for every inference, so the steady-state decision
+// loop performs no tensor allocations. The arena also holds the model's
+// feature normalization (see feature_vector.h). A handle created with
+// load_model_deferred() is loaded on first use (see ensure_model_loaded()).
 typedef struct {
-    void *handle;
+    void *handle;                        // Backend model, or NULL for the dummy model
+    int backend;                         // MODEL_BACKEND_*
+    _Atomic int loaded;                  // Backend and tensors are ready
     char name[64];
+    char path[256];
+    Tensor input;                        // Bound input buffer
+    Tensor outputs[MODEL_MAX_OUTPUTS];   // Bound output buffers, one per head
+    int num_outputs;
+    float *feature_scale;                // Normalization of the leading num_features inputs
+    float *feature_offset;
+    int num_features;
+    float *arena;                        // Aligned storage backing all tensors
+    struct DecisionCache *cache;         // Memoized outputs, or NULL
 } ModelHandle;
 
+// Decision heads that can be requested in one batched call
+#define DECISION_BOOT_SEQUENCE    0x1
+#define DECISION_RESOURCE_POLICY  0x2
+#define DECISION_PROCESS_ADJUST   0x4
+
+// Output index of each head in the fused multi-output decision model
+#define FUSED_OUTPUT_BOOT_SEQUENCE    0
+#define FUSED_OUTPUT_RESOURCE_POLICY  1
+#define FUSED_OUTPUT_PROCESS_ADJUST   2
+
+// Model slots. The model updater may replace the model in any slot at
+// runtime; code using a slot's model must hold a models_read_lock() section.
+typedef enum {
+    MODEL_SLOT_BOOT,
+    MODEL_SLOT_RESOURCE,
+    MODEL_SLOT_PROCESS,
+    MODEL_SLOT_FUSED,
+    NUM_MODEL_SLOTS
+} ModelSlot;
+
+// Results of run_decision_heads(); only requested heads are filled in.
+// The periodic heads are decoded into the result's own storage, so a
+// result reused for every decision never allocates. The boot sequence,
+// decided once, is allocated; free it with free_process_groups().
+typedef struct {
+    ProcessGroup *groups;
+    ResourcePolicy policy;                  // Entries in policy_storage
+    ProcessAdjustments adjustments;         // Entries in adjustment_storage
+    ProcessResourcePolicy policy_storage[MAX_MANAGED_PROCESSES];
+    ProcessAdjustment adjustment_storage[MAX_MANAGED_PROCESSES];
+} DecisionResult;
+
 // Function prototypes
 void init_learning_engine();
+void register_decision_processes();
 ProcessGroup *generate_optimal_sequence(SystemState state);
 ResourcePolicy generate_resource_policy(SystemState state);
 ProcessAdjustments *get_process_adjustments(SystemState state);
+int run_decision_heads(SystemState state, const HardwareState *hardware, unsigned int heads,
+                       DecisionResult *result);
+void set_decision_log_producer(LogProducer producer);
 void update_models();
 void init_learning_storage();
+void load_deferred_models();
+int models_read_lock();
+void models_read_unlock(int token);
+ModelHandle *get_slot_model(ModelSlot slot);
+void replace_slot_model(ModelSlot slot, ModelHandle *model);
 
 // Model runtime functions (implemented in model_runtime.c)
 void init_model_runtime();
 ModelHandle *load_model(const char *model_path);
+ModelHandle *load_model_deferred(const char *model_path);
+int ensure_model_loaded(ModelHandle *model);
 Tensor *run_model_inference(ModelHandle *model, Tensor *input);
 
 // Tensor creation and conversion functions
-Tensor *create_system_state_tensor(SystemState state);
+Tensor *create_system_state_tensor(ModelHandle *model, SystemState state, const HardwareState *hardware);
 ProcessGroup *tensor_to_process_groups(Tensor *tensor);
-ResourcePolicy tensor_to_resource_policy(Tensor *tensor);
-ProcessAdjustments *tensor_to_process_adjustments(Tensor *tensor);
+void tensor_to_resource_policy(Tensor *tensor, DecisionResult *result);
+void tensor_to_process_adjustments(Tensor *tensor, DecisionResult *result);
 
 // Memory management functions
-void free_tensor(Tensor *tensor);
 void free_process_adjustments(ProcessAdjustments *adjustments);
+void free_resource_policy(ResourcePolicy *policy);
 
 #endif /* LEARNING_ENGINE_H */
\ No newline at end of file
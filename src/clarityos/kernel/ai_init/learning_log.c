@@ -0,0 +1,535 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "learning_log.h"
+#include "init_log.h"
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#elif defined(HAVE_LZ4)
+#include <lz4.h>
+#endif
+
+// Producers never block: each appends to its own lock-free single-producer
+// single-consumer ring and a full ring drops the record (counted in
+// learning_log_dropped()). The writer thread drains the rings into a chunk,
+// and compresses and writes the chunk once it is full or
+// LEARNING_FLUSH_INTERVAL_MS after its first record. Producers only make a
+// syscall to wake the writer early, when a ring reaches half capacity.
+
+#define LOG_QUEUE_MASK (LOG_QUEUE_CAPACITY - 1)
+
+typedef struct {
+    _Alignas(64) atomic_size_t head;    // Written by the producer
+    _Alignas(64) atomic_size_t tail;    // Written by the writer thread
+    LearningRecord records[LOG_QUEUE_CAPACITY];
+} LogQueue;
+
+static LogQueue log_queues[NUM_LOG_PRODUCERS];
+static atomic_uint_fast64_t dropped_records = 0;
+
+#define CHUNK_RAW_BYTES (LEARNING_CHUNK_RECORDS * sizeof(LearningRecord))
+// Worst-case expansion of either codec on a 16 KiB chunk stays well below this
+#define CHUNK_STORED_CAPACITY (CHUNK_RAW_BYTES + CHUNK_RAW_BYTES / 8 + 1024)
+
+// Payloads are padded to this so that records read in place stay aligned
+#define CHUNK_ALIGNMENT 8
+#define CHUNK_PADDING(size) ((CHUNK_ALIGNMENT - (size) % CHUNK_ALIGNMENT) % CHUNK_ALIGNMENT)
+
+static int log_fd = -1;
+static char log_path[512];
+static off_t log_size = 0;          // Owned by the writer thread once it runs
+static atomic_int wake_fd = -1;     // Read by producers
+static pthread_t writer_thread;
+static atomic_int writer_running = 0;
+
+// Owned by the writer thread
+static LearningRecord chunk_records[LEARNING_CHUNK_RECORDS];
+static int chunk_length = 0;
+static unsigned char chunk_stored[CHUNK_STORED_CAPACITY];
+
+// CRC32 (IEEE 802.3, reflected)
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void build_crc_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32_of(const void *data, size_t len) {
+    pthread_once(&crc_once, build_crc_table);
+    const unsigned char *p = data;
+    uint32_t crc = 0xFFFFFFFFu;
+    while (len--) crc = crc_table[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static uint64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+int learning_log_append(LogProducer producer, const LearningRecord *record) {
+    LogQueue *queue = &log_queues[producer];
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+
+    if (head - tail == LOG_QUEUE_CAPACITY) {
+        atomic_fetch_add_explicit(&dropped_records, 1, memory_order_relaxed);
+        return -1;
+    }
+
+    queue->records[head & LOG_QUEUE_MASK] = *record;
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+
+    int fd = atomic_load_explicit(&wake_fd, memory_order_relaxed);
+    if (head + 1 - tail == LOG_QUEUE_CAPACITY / 2 && fd >= 0) {
+        uint64_t one = 1;
+        if (write(fd, &one, sizeof(one)) < 0) {
+            // Already signalled; the writer wakes either way
+        }
+    }
+    return 0;
+}
+
+// One STATE record, then the HARDWARE records that carry the rest of the
+// model inputs
+void learning_log_state(LogProducer producer, const SystemState *state, const HardwareState *hardware) {
+    LearningRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp_ns = realtime_ns();
+    record.type = LOG_RECORD_STATE;
+    record.values[LOG_VALUE_CPU_USAGE] = state->cpu_usage;
+    record.values[LOG_VALUE_MEMORY_USAGE] = state->memory_usage;
+    record.values[LOG_VALUE_IO_USAGE] = state->io_usage;
+    record.values[LOG_VALUE_NETWORK_USAGE] = state->network_usage;
+    record.values[LOG_VALUE_NUM_PROCESSES] = (float)state->num_processes;
+    record.values[LOG_VALUE_NUM_USERS] = (float)state->num_users;
+    record.values[LOG_VALUE_BATTERY_LEVEL] = state->battery_level;
+    record.values[LOG_VALUE_ON_AC_POWER] = (float)state->on_ac_power;
+    record.values[LOG_VALUE_NUM_CPUS] = (float)hardware->num_cpus;
+    record.values[LOG_VALUE_NUM_NUMA_NODES] = (float)hardware->num_numa_nodes;
+    learning_log_append(producer, &record);
+
+    // Cores and nodes the machine does not have stay zero and are skipped
+    float values[LOG_HARDWARE_VALUES];
+    memcpy(values, hardware, sizeof(values));
+    record.type = LOG_RECORD_HARDWARE;
+    for (int first = 0; first < LOG_HARDWARE_VALUES; first += LEARNING_RECORD_VALUES) {
+        int n = LOG_HARDWARE_VALUES - first;
+        if (n > LEARNING_RECORD_VALUES) n = LEARNING_RECORD_VALUES;
+
+        int nonzero = 0;
+        for (int i = 0; i < n; i++) nonzero |= values[first + i] != 0.0f;
+        if (!nonzero) continue;
+
+        memset(record.values, 0, sizeof(record.values));
+        memcpy(record.values, values + first, sizeof(float) * (size_t)n);
+        record.flags = (uint32_t)first;
+        learning_log_append(producer, &record);
+    }
+}
+
+// Inverse of learning_log_state(), for replaying and validating on the
+// log. hardware gets the core and node counts; the HARDWARE records that
+// follow fill in the rest (learning_record_hardware()).
+SystemState learning_record_state(const LearningRecord *record, HardwareState *hardware) {
+    memset(hardware, 0, sizeof(*hardware));
+    hardware->num_cpus = (int)record->values[LOG_VALUE_NUM_CPUS];
+    hardware->num_numa_nodes = (int)record->values[LOG_VALUE_NUM_NUMA_NODES];
+    if (hardware->num_cpus < 0 || hardware->num_cpus > HW_MAX_CPUS) hardware->num_cpus = 0;
+    if (hardware->num_numa_nodes < 0 || hardware->num_numa_nodes > HW_MAX_NUMA_NODES) {
+        hardware->num_numa_nodes = 0;
+    }
+
+    SystemState state;
+    memset(&state, 0, sizeof(state));
+    state.last_update_time = (time_t)(record->timestamp_ns / 1000000000ull);
+    state.cpu_usage = record->values[LOG_VALUE_CPU_USAGE];
+    state.memory_usage = record->values[LOG_VALUE_MEMORY_USAGE];
+    state.io_usage = record->values[LOG_VALUE_IO_USAGE];
+    state.network_usage = record->values[LOG_VALUE_NETWORK_USAGE];
+    state.num_processes = (int)record->values[LOG_VALUE_NUM_PROCESSES];
+    state.num_users = (int)record->values[LOG_VALUE_NUM_USERS];
+    state.battery_level = record->values[LOG_VALUE_BATTERY_LEVEL];
+    state.on_ac_power = (int)record->values[LOG_VALUE_ON_AC_POWER];
+    return state;
+}
+
+// Apply one HARDWARE record to the hardware of the STATE record it
+// follows; the caller matches their timestamps
+void learning_record_hardware(const LearningRecord *record, HardwareState *hardware) {
+    if (record->flags >= (uint32_t)LOG_HARDWARE_VALUES) return;
+
+    int first = (int)record->flags;
+    int n = LOG_HARDWARE_VALUES - first;
+    if (n > LEARNING_RECORD_VALUES) n = LEARNING_RECORD_VALUES;
+
+    float values[LOG_HARDWARE_VALUES];
+    memcpy(values, hardware, sizeof(values));
+    memcpy(values + first, record->values, sizeof(float) * (size_t)n);
+    memcpy(hardware, values, sizeof(values));
+}
+
+void learning_log_event(LogProducer producer, uint32_t type, uint32_t flags, const float *values, int num_values) {
+    LearningRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp_ns = realtime_ns();
+    record.type = type;
+    record.flags = flags;
+    if (num_values > LEARNING_RECORD_VALUES) num_values = LEARNING_RECORD_VALUES;
+    for (int i = 0; i < num_values; i++) record.values[i] = values[i];
+    learning_log_append(producer, &record);
+}
+
+uint64_t learning_log_dropped() {
+    return atomic_load_explicit(&dropped_records, memory_order_relaxed);
+}
+
+// Records of a producer the writer has not drained yet
+int learning_log_pending(LogProducer producer) {
+    LogQueue *queue = &log_queues[producer];
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    return (int)(atomic_load_explicit(&queue->head, memory_order_acquire) - tail);
+}
+
+// Writer thread
+
+static size_t compress_chunk(size_t raw_size, uint16_t *codec) {
+#ifdef HAVE_ZSTD
+    size_t stored = ZSTD_compress(chunk_stored, sizeof(chunk_stored), chunk_records, raw_size, 3);
+    if (!ZSTD_isError(stored) && stored < raw_size) {
+        *codec = LOG_CODEC_ZSTD;
+        return stored;
+    }
+#elif defined(HAVE_LZ4)
+    int stored = LZ4_compress_default((const char *)chunk_records, (char *)chunk_stored,
+                                      (int)raw_size, (int)sizeof(chunk_stored));
+    if (stored > 0 && (size_t)stored < raw_size) {
+        *codec = LOG_CODEC_LZ4;
+        return (size_t)stored;
+    }
+#endif
+    // Incompressible, or no codec built in
+    memcpy(chunk_stored, chunk_records, raw_size);
+    *codec = LOG_CODEC_NONE;
+    return raw_size;
+}
+
+static int write_log_header(int fd) {
+    LearningLogHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LEARNING_LOG_MAGIC;
+    header.version = LEARNING_LOG_VERSION;
+    header.record_size = sizeof(LearningRecord);
+    if (write(fd, &header, sizeof(header)) != sizeof(header)) {
+        log_error("Learning log: header: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+// Move the full log aside and continue in a new one. On failure the log
+// keeps growing, and rotation is retried after another
+// LEARNING_LOG_MAX_BYTES.
+static void rotate_log() {
+    char rotated[sizeof(log_path) + sizeof(LEARNING_LOG_ROTATED_SUFFIX)];
+    snprintf(rotated, sizeof(rotated), "%s" LEARNING_LOG_ROTATED_SUFFIX, log_path);
+
+    log_size = 0;
+    if (rename(log_path, rotated) < 0) {
+        log_error("Learning log: cannot rotate %s: %s", log_path, strerror(errno));
+        return;
+    }
+    int fd = open(log_path, O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0640);
+    if (fd < 0 || write_log_header(fd) < 0) {
+        log_error("Learning log: cannot start %s: %s", log_path, strerror(errno));
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    close(log_fd);
+    log_fd = fd;
+    log_size = sizeof(LearningLogHeader);
+    log_info("Learning log rotated to %s", rotated);
+}
+
+static void write_chunk() {
+    if (chunk_length == 0) return;
+
+    size_t raw_size = (size_t)chunk_length * sizeof(LearningRecord);
+    LearningChunkHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = LEARNING_CHUNK_MAGIC;
+    header.num_records = (uint32_t)chunk_length;
+    header.stored_size = (uint32_t)compress_chunk(raw_size, &header.codec);
+    header.crc32 = crc32_of(chunk_stored, header.stored_size);
+
+    static const unsigned char padding[CHUNK_ALIGNMENT];
+    struct iovec iov[3] = {
+        { &header, sizeof(header) },
+        { chunk_stored, header.stored_size },
+        { (void *)padding, CHUNK_PADDING(header.stored_size) },
+    };
+    ssize_t written = writev(log_fd, iov, 3);
+    if (written < 0) {
+        log_error("Learning log: write: %s", strerror(errno));
+    } else {
+        log_size += written;
+    }
+    chunk_length = 0;
+
+    if (log_size >= LEARNING_LOG_MAX_BYTES) rotate_log();
+}
+
+static int drain_queues() {
+    int drained = 0;
+    for (int p = 0; p < NUM_LOG_PRODUCERS; p++) {
+        LogQueue *queue = &log_queues[p];
+        size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+
+        while (tail != head) {
+            chunk_records[chunk_length++] = queue->records[tail & LOG_QUEUE_MASK];
+            tail++;
+            drained++;
+            if (chunk_length == LEARNING_CHUNK_RECORDS) {
+                atomic_store_explicit(&queue->tail, tail, memory_order_release);
+                write_chunk();
+            }
+        }
+        atomic_store_explicit(&queue->tail, tail, memory_order_release);
+    }
+    return drained;
+}
+
+static void *learning_log_writer(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = wake_fd, .events = POLLIN };
+    struct timespec first_record = { 0, 0 };
+
+    while (atomic_load(&writer_running)) {
+        int had_records = chunk_length > 0;
+        drain_queues();
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (chunk_length > 0 && !had_records) first_record = now;
+        if (chunk_length > 0) {
+            long elapsed_ms = (now.tv_sec - first_record.tv_sec) * 1000 +
+                              (now.tv_nsec - first_record.tv_nsec) / 1000000;
+            if (elapsed_ms >= LEARNING_FLUSH_INTERVAL_MS) write_chunk();
+        }
+
+        if (poll(&pfd, 1, LEARNING_FLUSH_INTERVAL_MS / 4) > 0) {
+            uint64_t count;
+            if (read(wake_fd, &count, sizeof(count)) < 0) {
+                // Spurious wakeup
+            }
+        }
+    }
+
+    drain_queues();
+    write_chunk();
+    return NULL;
+}
+
+// Reader
+
+int open_learning_log_reader(const char *path, LearningLogReader *reader) {
+    memset(reader, 0, sizeof(*reader));
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(LearningLogHeader)) {
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+    madvise(data, (size_t)st.st_size, MADV_SEQUENTIAL);
+
+    const LearningLogHeader *header = data;
+    if (header->magic != LEARNING_LOG_MAGIC || header->version != LEARNING_LOG_VERSION ||
+        header->record_size != sizeof(LearningRecord)) {
+        munmap(data, (size_t)st.st_size);
+        return -1;
+    }
+
+    reader->data = data;
+    reader->size = (size_t)st.st_size;
+    reader->device = st.st_dev;
+    reader->inode = st.st_ino;
+    reader->offset = sizeof(LearningLogHeader);
+    return 0;
+}
+
+// Header of the chunk at the reader's offset, if its bounds and CRC check
+// out; the payload is not decoded. Returns 0 at the end of the log or at a
+// damaged chunk.
+static int intact_chunk(const LearningLogReader *reader, LearningChunkHeader *header) {
+    if (reader->offset + sizeof(LearningChunkHeader) > reader->size) return 0;
+
+    memcpy(header, reader->data + reader->offset, sizeof(*header));
+    const unsigned char *payload = reader->data + reader->offset + sizeof(*header);
+
+    // In size_t: a corrupt stored_size must not wrap past the check
+    size_t remaining = reader->size - reader->offset - sizeof(*header);
+    return header->magic == LEARNING_CHUNK_MAGIC && header->num_records > 0 &&
+           header->num_records <= LEARNING_CHUNK_RECORDS && header->stored_size <= remaining &&
+           CHUNK_PADDING(header->stored_size) <= remaining - header->stored_size &&
+           crc32_of(payload, header->stored_size) == header->crc32;
+}
+
+static void skip_chunk(LearningLogReader *reader, const LearningChunkHeader *header) {
+    reader->offset += sizeof(*header) + header->stored_size + CHUNK_PADDING(header->stored_size);
+}
+
+// Records of an intact chunk, or NULL if this build cannot decode it
+static const LearningRecord *decode_chunk(LearningLogReader *reader, const LearningChunkHeader *header) {
+    const unsigned char *payload = reader->data + reader->offset + sizeof(*header);
+    size_t raw_size = (size_t)header->num_records * sizeof(LearningRecord);
+
+    if (header->codec == LOG_CODEC_NONE) {
+        return header->stored_size == raw_size ? (const LearningRecord *)payload : NULL;
+    }
+
+    if (!reader->buffer) reader->buffer = malloc(CHUNK_RAW_BYTES);
+    if (!reader->buffer) return NULL;
+    size_t decoded = 0;
+#ifdef HAVE_ZSTD
+    if (header->codec == LOG_CODEC_ZSTD) {
+        size_t n = ZSTD_decompress(reader->buffer, CHUNK_RAW_BYTES, payload, header->stored_size);
+        if (!ZSTD_isError(n)) decoded = n;
+    }
+#elif defined(HAVE_LZ4)
+    if (header->codec == LOG_CODEC_LZ4) {
+        int n = LZ4_decompress_safe((const char *)payload, (char *)reader->buffer,
+                                    (int)header->stored_size, (int)CHUNK_RAW_BYTES);
+        if (n > 0) decoded = (size_t)n;
+    }
+#endif
+    return decoded == raw_size ? reader->buffer : NULL;
+}
+
+// Returns the records of the next intact chunk, or NULL at the end of the
+// log or at the first damaged chunk. Intact chunks this build cannot
+// decode (written with a codec it was built without) are skipped.
+// Uncompressed chunks are returned in place from the mapping; compressed
+// ones are decoded into a buffer owned by the reader, valid until the next
+// call.
+const LearningRecord *learning_log_next_chunk(LearningLogReader *reader, int *num_records) {
+    *num_records = 0;
+
+    LearningChunkHeader header;
+    while (intact_chunk(reader, &header)) {
+        const LearningRecord *records = decode_chunk(reader, &header);
+        skip_chunk(reader, &header);
+        if (records) {
+            *num_records = (int)header.num_records;
+            return records;
+        }
+        log_warn("Learning log: skipped chunk with codec %u, not in this build", header.codec);
+    }
+    return NULL;
+}
+
+void close_learning_log_reader(LearningLogReader *reader) {
+    if (reader->data) munmap((void *)reader->data, reader->size);
+    free(reader->buffer);
+    memset(reader, 0, sizeof(*reader));
+}
+
+// Length of the intact prefix of the log: everything after the first
+// damaged chunk is a torn write and is cut off before appending. Only
+// bounds and CRCs are checked, so chunks written with a codec this build
+// lacks are kept.
+static off_t valid_log_length(const char *path) {
+    LearningLogReader reader;
+    if (open_learning_log_reader(path, &reader) < 0) return -1;
+
+    LearningChunkHeader header;
+    while (intact_chunk(&reader, &header)) skip_chunk(&reader, &header);
+    off_t length = (off_t)reader.offset;
+    close_learning_log_reader(&reader);
+    return length;
+}
+
+int init_learning_log(const char *path) {
+    log_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    if (log_fd < 0) {
+        log_error("Learning log: cannot open %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(log_fd, &st) < 0) st.st_size = 0;
+
+    snprintf(log_path, sizeof(log_path), "%s", path);
+    log_size = st.st_size;
+    if (st.st_size == 0) {
+        if (write_log_header(log_fd) == 0) log_size = sizeof(LearningLogHeader);
+    } else {
+        off_t length = valid_log_length(path);
+        if (length < 0) {
+            log_error("Learning log: %s is not a learning log", path);
+            close(log_fd);
+            log_fd = -1;
+            return -1;
+        }
+        if (length < st.st_size && ftruncate(log_fd, length) == 0) {
+            log_warn("Learning log: dropped %lld bytes of torn chunk",
+                     (long long)(st.st_size - length));
+            log_size = length;
+        }
+    }
+
+    wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    atomic_store(&writer_running, 1);
+    if (wake_fd < 0 || pthread_create(&writer_thread, NULL, learning_log_writer, NULL) != 0) {
+        log_error("Learning log: cannot start writer thread");
+        atomic_store(&writer_running, 0);
+        close(log_fd);
+        log_fd = -1;
+        return -1;
+    }
+
+    log_info("Learning log opened: %s", path);
+    return 0;
+}
+
+void shutdown_learning_log() {
+    if (!atomic_load(&writer_running)) return;
+
+    atomic_store(&writer_running, 0);
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0) {
+        // The writer still exits at its next poll timeout
+    }
+    pthread_join(writer_thread, NULL);
+
+    int fd = wake_fd;
+    wake_fd = -1;
+    close(fd);
+    close(log_fd);
+    log_fd = -1;
+}
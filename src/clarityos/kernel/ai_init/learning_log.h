@@ -0,0 +1,147 @@
+#ifndef LEARNING_LOG_H
+#define LEARNING_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "system_state.h"
+
+// Append-only training log
+//
+// File layout: a LearningLogHeader, then chunks. Each chunk is a
+// LearningChunkHeader followed by its payload: num_records fixed-width
+// LearningRecords, compressed with the codec named in the header and padded
+// to a multiple of 8 bytes. The CRC32 covers the stored (possibly
+// compressed) payload, so a torn write at the end of the file is detected
+// and dropped on the next open.
+//
+// Once the log passes LEARNING_LOG_MAX_BYTES, it is renamed to
+// <path> LEARNING_LOG_ROTATED_SUFFIX, replacing the previous one, and a new
+// log is started, so the two never take more than twice the cap. Readers
+// that follow the log keep their offset and the file's identity, and
+// finish the rotated file before starting on the new one.
+
+#ifndef LEARNING_LOG_PATH
+#define LEARNING_LOG_PATH "/var/lib/clarityos/learning.log"
+#endif
+
+#define LEARNING_LOG_MAGIC   0x474C4C43u  // "CLLG"
+#define LEARNING_CHUNK_MAGIC 0x4B4E4843u  // "CHNK"
+#define LEARNING_LOG_VERSION 1
+
+#define LEARNING_CHUNK_RECORDS 256        // Records per chunk (16 KiB raw)
+#define LEARNING_FLUSH_INTERVAL_MS 1000   // Partial chunks are written after this
+#define LOG_QUEUE_CAPACITY 4096           // Queued records per producer, power of two
+
+#ifndef LEARNING_LOG_MAX_BYTES
+#define LEARNING_LOG_MAX_BYTES (256ll << 20)  // About six days of records, uncompressed
+#endif
+#define LEARNING_LOG_ROTATED_SUFFIX ".1"
+
+// Chunk payload codecs
+#define LOG_CODEC_NONE 0
+#define LOG_CODEC_LZ4  1
+#define LOG_CODEC_ZSTD 2
+
+// Record types
+#define LOG_RECORD_STATE    1   // values: LOG_VALUE_* metrics
+#define LOG_RECORD_ANOMALY  2   // flags: ANOMALY_* of the series; one record per AnomalyEvent:
+                                //   history series, anomaly kind, value, expected, score
+#define LOG_RECORD_DECISION 3   // flags: the DECISION_* head; one record per decided item:
+                                //   boot sequence:   group, process id
+                                //   resource policy: process id, cpu, memory, io, network,
+                                //                    numa node, llc domain, smt exclusive
+                                //   process adjust:  process id, action, priority
+#define LOG_RECORD_OUTCOME  4   // flags: LOG_OUTCOME_*; values: outcome-specific
+#define LOG_RECORD_HARDWARE 5   // Follows the STATE record with the same timestamp. flags:
+                                //   index of values[0] among the LOG_HARDWARE_VALUES float
+                                //   fields of HardwareState; values: the next of them.
+                                //   All-zero records are not written.
+
+// Indices into LearningRecord.values for LOG_RECORD_STATE
+#define LOG_VALUE_CPU_USAGE     0
+#define LOG_VALUE_MEMORY_USAGE  1
+#define LOG_VALUE_IO_USAGE      2
+#define LOG_VALUE_NETWORK_USAGE 3
+#define LOG_VALUE_NUM_PROCESSES 4
+#define LOG_VALUE_NUM_USERS     5
+#define LOG_VALUE_BATTERY_LEVEL 6
+#define LOG_VALUE_ON_AC_POWER   7
+#define LOG_VALUE_NUM_CPUS      8   // HardwareState.num_cpus
+#define LOG_VALUE_NUM_NUMA_NODES 9  // HardwareState.num_numa_nodes
+
+// HardwareState floats, psi_cpu_some to the last core_usage, in struct order
+#define LOG_HARDWARE_VALUES (int)(offsetof(HardwareState, num_numa_nodes) / sizeof(float))
+
+// Outcomes
+#define LOG_OUTCOME_BOOT 1      // values[0]: seconds, values[1]: 1 if an essential process failed
+#define LOG_OUTCOME_PROCESS_READY 2 // values: process id, seconds queued, seconds spawn to ready,
+                                    //   seconds from boot start to ready, 1 if on the critical path
+#define LOG_OUTCOME_CRITICAL_PATH 3 // values: seconds to the last ready process, processes on the
+                                    //   path, id of the last process
+#define LOG_OUTCOME_RECLAIM 4       // values: process id, MiB requested, MiB reclaimed,
+                                    //   predicted memory usage, memory stall percentage
+
+#define LEARNING_RECORD_VALUES 12
+
+// 64 bytes, one cache line
+typedef struct {
+    uint64_t timestamp_ns;      // CLOCK_REALTIME
+    uint32_t type;              // LOG_RECORD_*
+    uint32_t flags;
+    float values[LEARNING_RECORD_VALUES];
+} LearningRecord;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t record_size;
+    uint32_t reserved[2];
+} LearningLogHeader;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t codec;
+    uint16_t reserved;
+    uint32_t num_records;
+    uint32_t stored_size;       // Payload bytes following this header
+    uint32_t crc32;             // Of the stored payload
+    uint32_t reserved2;
+} LearningChunkHeader;
+
+// Record producers. Each has its own single-producer queue, so a producer
+// must only ever append from one thread.
+typedef enum {
+    LOG_PRODUCER_MONITOR,       // System monitor thread
+    LOG_PRODUCER_MAIN,          // Decision loop
+    LOG_PRODUCER_RECLAIMER,     // Memory reclaimer thread
+    LOG_PRODUCER_INFERENCE,     // Decision pipeline inference worker
+    NUM_LOG_PRODUCERS
+} LogProducer;
+
+// Memory-mapped, read-only view of a log for offline training
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    size_t offset;              // Next chunk
+    dev_t device;               // Identity of the file, to notice rotation
+    ino_t inode;
+    LearningRecord *buffer;     // Decompression buffer (compressed chunks only)
+} LearningLogReader;
+
+// Function prototypes
+int init_learning_log(const char *path);
+void shutdown_learning_log();
+int learning_log_append(LogProducer producer, const LearningRecord *record);
+void learning_log_state(LogProducer producer, const SystemState *state, const HardwareState *hardware);
+void learning_log_event(LogProducer producer, uint32_t type, uint32_t flags, const float *values, int num_values);
+SystemState learning_record_state(const LearningRecord *record, HardwareState *hardware);
+void learning_record_hardware(const LearningRecord *record, HardwareState *hardware);
+uint64_t learning_log_dropped();
+int learning_log_pending(LogProducer producer);
+
+int open_learning_log_reader(const char *path, LearningLogReader *reader);
+const LearningRecord *learning_log_next_chunk(LearningLogReader *reader, int *num_records);
+void close_learning_log_reader(LearningLogReader *reader);
+
+#endif /* LEARNING_LOG_H */
@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sysinfo.h>
+#include "memory_reclaimer.h"
+#include "resource_governor.h"
+#include "state_history.h"
+#include "cpu_topology.h"
+#include "learning_log.h"
+#include "init_log.h"
+
+#define PRESSURE_BUF_SIZE 256
+#define MEMORY_STAT_BUF_SIZE 8192
+#define MB (1LL << 20)
+
+// cgroup files of one governed group, opened when the group first exists
+typedef struct {
+    int dir_fd;
+    int stat_fd;
+    int current_fd;
+    int reclaim_fd;             // Absent before Linux 5.19
+    int high_fd;
+    long long lowered_high;     // memory.high written by the fallback, 0 if none
+    char saved_high[32];        // ... and the value to restore
+} ReclaimGroup;
+
+typedef struct {
+    ProcessId process;
+    long long reclaimable;      // Bytes on the inactive LRU lists
+} ReclaimCandidate;
+
+static ReclaimGroup groups[MAX_MANAGED_PROCESSES];
+
+// Processes as last published by the decision loop, and the reclaimer's
+// copy for the current pass
+static pthread_mutex_t published_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProcessTableView published_processes;
+static ProcessTableView processes;
+
+static pthread_t reclaimer_thread;
+static atomic_int reclaimer_running = 0;
+static int stop_fd = -1;
+static int pressure_fd = -1;    // For reading avg10
+static int trigger_fd = -1;     // PSI trigger, or -1 to poll only
+
+static long long total_memory = 0;
+
+static ssize_t read_file(int fd, char *buf, size_t size) {
+    if (fd < 0) return -1;
+    ssize_t len = pread(fd, buf, size - 1, 0);
+    if (len < 0) return -1;
+    buf[len] = '\0';
+    return len;
+}
+
+static long long read_value(int fd) {
+    char buf[32];
+    return read_file(fd, buf, sizeof(buf)) > 0 ? atoll(buf) : -1;
+}
+
+// Value following "key " at the start of a memory.stat line, or 0
+static long long stat_field(const char *buf, const char *key) {
+    size_t key_len = strlen(key);
+    for (const char *line = buf; *line; ) {
+        if (strncmp(line, key, key_len) == 0 && line[key_len] == ' ') return atoll(line + key_len + 1);
+        const char *next = strchr(line, '\n');
+        if (!next) break;
+        line = next + 1;
+    }
+    return 0;
+}
+
+static ReclaimGroup *get_group(ProcessId id) {
+    ReclaimGroup *group = &groups[id];
+    if (group->dir_fd >= 0) return group;
+
+    // Essential services are never reclaimed from
+    const char *name = processes.names[id];
+    if (processes.essential[id] || strchr(name, '/')) return NULL;
+
+    char path[sizeof(RESOURCE_CGROUP_ROOT) + MAX_PROCESS_NAME + 1];
+    snprintf(path, sizeof(path), "%s/%s", RESOURCE_CGROUP_ROOT, name);
+    int dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return NULL;    // Not governed (yet)
+
+    group->dir_fd = dir_fd;
+    group->stat_fd = openat(dir_fd, "memory.stat", O_RDONLY | O_CLOEXEC);
+    group->current_fd = openat(dir_fd, "memory.current", O_RDONLY | O_CLOEXEC);
+    group->reclaim_fd = openat(dir_fd, "memory.reclaim", O_WRONLY | O_CLOEXEC);
+    group->high_fd = openat(dir_fd, "memory.high", O_RDWR | O_CLOEXEC);
+    return group;
+}
+
+// The fallback lowers memory.high for one pass only. The governor may have
+// set a new limit since; it is kept if so.
+static void restore_lowered_limits() {
+    for (ProcessId p = 0; p < processes.num_processes; p++) {
+        ReclaimGroup *group = &groups[p];
+        if (group->dir_fd < 0 || !group->lowered_high) continue;
+
+        if (read_value(group->high_fd) == group->lowered_high &&
+            write(group->high_fd, group->saved_high, strlen(group->saved_high)) < 0) {
+            log_error("Memory reclaimer: cannot restore %s memory.high: %s", processes.names[p],
+                      strerror(errno));
+        }
+        group->lowered_high = 0;
+    }
+}
+
+static double read_memory_pressure() {
+    char buf[PRESSURE_BUF_SIZE];
+    if (read_file(pressure_fd, buf, sizeof(buf)) < 0) return 0.0;
+
+    const char *avg10 = strstr(buf, "avg10=");     // The "some" line comes first
+    return avg10 ? atof(avg10 + 6) : 0.0;
+}
+
+// System memory usage expected RECLAIM_HORIZON_S from now: the trend over
+// the recent window, extrapolated from its midpoint, plus two standard
+// deviations of noise
+static double predict_memory_usage() {
+    int n = state_history_size() < RECLAIM_WINDOW ? state_history_size() : RECLAIM_WINDOW;
+    if (n == 0) return 0.0;
+
+    double mean = state_history_mean(HISTORY_MEMORY_USAGE, n);
+    if (n < 2) return mean;
+
+    // The history is appended at a fixed rate, whatever the sampling
+    double samples_per_s = 1000.0 / STATE_HISTORY_INTERVAL_MS;
+    double ahead = (n - 1) / 2.0 + RECLAIM_HORIZON_S * samples_per_s;
+
+    return mean + state_history_slope(HISTORY_MEMORY_USAGE, n) * ahead +
+           2.0 * state_history_stddev(HISTORY_MEMORY_USAGE, n);
+}
+
+static int compare_candidates(const void *a, const void *b) {
+    long long x = ((const ReclaimCandidate *)a)->reclaimable;
+    long long y = ((const ReclaimCandidate *)b)->reclaimable;
+    return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static int collect_candidates(ReclaimCandidate *candidates) {
+    static char buf[MEMORY_STAT_BUF_SIZE];
+
+    // Anonymous memory can only go somewhere if there is swap
+    struct sysinfo info;
+    int have_swap = sysinfo(&info) == 0 && info.freeswap > 0;
+
+    int n = 0;
+    for (ProcessId p = 0; p < processes.num_processes; p++) {
+        ReclaimGroup *group = get_group(p);
+        if (!group || read_file(group->stat_fd, buf, sizeof(buf)) < 0) continue;
+
+        long long reclaimable = stat_field(buf, "inactive_file");
+        if (have_swap) reclaimable += stat_field(buf, "inactive_anon");
+        if (reclaimable >= RECLAIM_MIN_STEP_MB * MB) {
+            candidates[n].process = p;
+            candidates[n].reclaimable = reclaimable;
+            n++;
+        }
+    }
+    return n;
+}
+
+// Ask the kernel to reclaim amount bytes from a group. Returns the bytes
+// actually freed.
+static long long reclaim_group(ProcessId process, long long amount) {
+    ReclaimGroup *group = &groups[process];
+    long long before = read_value(group->current_fd);
+    char buf[32];
+
+    if (group->reclaim_fd >= 0) {
+        // EAGAIN: less than the full amount could be reclaimed
+        int len = snprintf(buf, sizeof(buf), "%lld", amount);
+        if (write(group->reclaim_fd, buf, (size_t)len) < 0 && errno != EAGAIN) {
+            log_error("Memory reclaimer: %s memory.reclaim: %s", processes.names[process], strerror(errno));
+        }
+    } else if (group->high_fd >= 0 && before > amount &&
+               read_file(group->high_fd, group->saved_high, sizeof(group->saved_high)) > 0) {
+        // Lowering memory.high reclaims down to it before the write returns
+        group->lowered_high = before - amount;
+        int len = snprintf(buf, sizeof(buf), "%lld", group->lowered_high);
+        if (write(group->high_fd, buf, (size_t)len) < 0) {
+            log_error("Memory reclaimer: %s memory.high: %s", processes.names[process], strerror(errno));
+            group->lowered_high = 0;
+        }
+    }
+
+    long long after = read_value(group->current_fd);
+    return before >= 0 && after >= 0 && before > after ? before - after : 0;
+}
+
+static void reclaim_pass() {
+    pthread_mutex_lock(&published_lock);
+    memcpy(&processes, &published_processes, sizeof(processes));
+    pthread_mutex_unlock(&published_lock);
+
+    restore_lowered_limits();
+
+    double pressure = read_memory_pressure();
+    double predicted = predict_memory_usage();
+    long long need = (long long)((predicted - RECLAIM_TARGET_USAGE) * (double)total_memory);
+    if (pressure >= RECLAIM_PSI_SOME_PCT && need < RECLAIM_PSI_STEP_MB * MB) need = RECLAIM_PSI_STEP_MB * MB;
+    if (need < RECLAIM_MIN_STEP_MB * MB) return;
+
+    static ReclaimCandidate candidates[MAX_MANAGED_PROCESSES];
+    int n = collect_candidates(candidates);
+    qsort(candidates, (size_t)n, sizeof(candidates[0]), compare_candidates);
+
+    // Most reclaimable first, taking at most half of a group's inactive
+    // memory so its working set stays resident
+    for (int i = 0; i < n && need >= RECLAIM_MIN_STEP_MB * MB; i++) {
+        long long amount = candidates[i].reclaimable / 2;
+        if (amount > need) amount = need;
+        if (amount > RECLAIM_MAX_STEP_MB * MB) amount = RECLAIM_MAX_STEP_MB * MB;
+        if (amount < RECLAIM_MIN_STEP_MB * MB) break;
+
+        ProcessId process = candidates[i].process;
+        long long reclaimed = reclaim_group(process, amount);
+        need -= amount;
+
+        log_info("Memory reclaimer: %lld of %lld MiB from %s (predicted usage %.0f%%, stalls %.2f%%)",
+                 reclaimed / MB, amount / MB, processes.names[process], predicted * 100.0, pressure);
+        float values[] = { (float)process, (float)(amount / MB), (float)(reclaimed / MB),
+                           (float)predicted, (float)pressure };
+        learning_log_event(LOG_PRODUCER_RECLAIMER, LOG_RECORD_OUTCOME, LOG_OUTCOME_RECLAIM, values, 5);
+    }
+}
+
+static void *reclaimer_thread_func(void *arg) {
+    (void)arg;
+    pin_housekeeping_thread(pthread_self(), HOUSEKEEPING_WORKER);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = stop_fd };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event);
+    if (trigger_fd >= 0) {
+        event.events = EPOLLPRI;
+        event.data.fd = trigger_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, trigger_fd, &event);
+    }
+
+    while (atomic_load(&reclaimer_running)) {
+        // A stall trigger only cuts the wait short; either way one pass runs
+        struct epoll_event events[2];
+        if (epoll_wait(epoll_fd, events, 2, RECLAIM_INTERVAL_MS) < 0 && errno != EINTR) {
+            log_error("Memory reclaimer: epoll_wait: %s", strerror(errno));
+            break;
+        }
+        if (!atomic_load(&reclaimer_running)) break;
+
+        reclaim_pass();
+    }
+
+    restore_lowered_limits();
+    close(epoll_fd);
+    return NULL;
+}
+
+// Decision loop: publish the processes the reclaimer may reclaim from,
+// which it takes at its next pass
+void update_reclaimer_processes() {
+    pthread_mutex_lock(&published_lock);
+    update_process_view(&published_processes);
+    pthread_mutex_unlock(&published_lock);
+}
+
+int start_memory_reclaimer() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    total_memory = pages > 0 && page_size > 0 ? (long long)pages * page_size : 0;
+
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) groups[i].dir_fd = -1;
+    update_reclaimer_processes();
+
+    pressure_fd = open("/proc/pressure/memory", O_RDONLY | O_CLOEXEC);
+    trigger_fd = open("/proc/pressure/memory", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (trigger_fd >= 0 && write(trigger_fd, RECLAIM_PSI_TRIGGER, strlen(RECLAIM_PSI_TRIGGER) + 1) < 0) {
+        close(trigger_fd);
+        trigger_fd = -1;
+    }
+    if (trigger_fd < 0) {
+        log_warn("Memory reclaimer: no PSI trigger, polling every %d ms", RECLAIM_INTERVAL_MS);
+    }
+
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    atomic_store(&reclaimer_running, 1);
+    if (stop_fd < 0 || pthread_create(&reclaimer_thread, NULL, reclaimer_thread_func, NULL) != 0) {
+        log_error("Failed to create memory reclaimer thread");
+        atomic_store(&reclaimer_running, 0);
+        return -1;
+    }
+
+    log_info("Memory reclaimer started (target %.0f%% of %lld MiB)", RECLAIM_TARGET_USAGE * 100.0,
+             total_memory / MB);
+    return 0;
+}
+
+void stop_memory_reclaimer() {
+    if (!atomic_load(&reclaimer_running)) return;
+
+    atomic_store(&reclaimer_running, 0);
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        log_error("Memory reclaimer: cannot signal stop: %s", strerror(errno));
+    }
+    pthread_join(reclaimer_thread, NULL);
+
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        ReclaimGroup *group = &groups[i];
+        if (group->dir_fd < 0) continue;
+        int fds[] = { group->stat_fd, group->current_fd, group->reclaim_fd, group->high_fd, group->dir_fd };
+        for (int f = 0; f < (int)(sizeof(fds) / sizeof(fds[0])); f++) {
+            if (fds[f] >= 0) close(fds[f]);
+        }
+        group->dir_fd = -1;
+    }
+    close(stop_fd);
+    if (pressure_fd >= 0) close(pressure_fd);
+    if (trigger_fd >= 0) close(trigger_fd);
+    stop_fd = pressure_fd = trigger_fd = -1;
+}
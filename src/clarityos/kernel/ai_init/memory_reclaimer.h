@@ -0,0 +1,34 @@
+#ifndef MEMORY_RECLAIMER_H
+#define MEMORY_RECLAIMER_H
+
+// Proactive memory reclaim (first component of ai_mem)
+//
+// A thread that reclaims memory from non-essential services before memory
+// pressure turns into stalls, OOM kills or direct-reclaim latency. Once per
+// RECLAIM_INTERVAL_MS, and immediately when a PSI trigger more sensitive
+// than the monitor's fires, it predicts system memory usage
+// RECLAIM_HORIZON_S ahead from the state history. Reclaim starts when that
+// prediction exceeds RECLAIM_TARGET_USAGE or memory stalls already exceed
+// RECLAIM_PSI_SOME_PCT. It then writes memory.reclaim on the governed
+// cgroups with the most reclaimable memory (per memory.stat), at most
+// RECLAIM_MAX_STEP_MB per group and pass. Kernels without memory.reclaim
+// get memory.high lowered for one pass instead. Essential services are
+// never touched. The reclaimer never reads the process table: the decision
+// loop publishes the processes with update_reclaimer_processes().
+
+#define RECLAIM_INTERVAL_MS 1000
+#define RECLAIM_PSI_TRIGGER "some 50000 1000000"    // 50 ms of stalls within 1 s
+#define RECLAIM_TARGET_USAGE 0.80                   // System memory usage to stay below
+#define RECLAIM_HORIZON_S 30                        // How far ahead usage is predicted
+#define RECLAIM_WINDOW 60                           // History samples behind the prediction
+#define RECLAIM_PSI_SOME_PCT 1.0                    // avg10 stall percentage that forces reclaim
+#define RECLAIM_PSI_STEP_MB 64                      // Reclaimed under stalls with no predicted excess
+#define RECLAIM_MAX_STEP_MB 64                      // Per group and pass
+#define RECLAIM_MIN_STEP_MB 4                       // Smaller amounts are not worth a write
+
+// Function prototypes
+int start_memory_reclaimer();
+void stop_memory_reclaimer();
+void update_reclaimer_processes();
+
+#endif /* MEMORY_RECLAIMER_H */
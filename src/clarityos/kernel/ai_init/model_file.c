@@ -0,0 +1,33 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "model_file.h"
+
+int map_model_file(const char *model_path, MappedModelFile *file) {
+    struct stat st;
+    int fd = open(model_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return -1;
+    }
+
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return -1;
+
+    // Models are read front to back during parsing and session creation
+    madvise(data, st.st_size, MADV_WILLNEED);
+
+    file->data = data;
+    file->size = st.st_size;
+    return 0;
+}
+
+void unmap_model_file(MappedModelFile *file) {
+    if (file->data) munmap(file->data, file->size);
+    file->data = NULL;
+    file->size = 0;
+}
@@ -0,0 +1,18 @@
+#ifndef MODEL_FILE_H
+#define MODEL_FILE_H
+
+#include <stddef.h>
+
+// Read-only memory mapping of a model file. Mapped pages come straight from
+// the page cache, so every process mapping the same model shares them and
+// weights are only paged in when first touched.
+typedef struct {
+    void *data;
+    size_t size;
+} MappedModelFile;
+
+// Function prototypes
+int map_model_file(const char *model_path, MappedModelFile *file);
+void unmap_model_file(MappedModelFile *file);
+
+#endif /* MODEL_FILE_H */
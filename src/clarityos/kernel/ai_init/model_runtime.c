@@ -1,58 +1,253 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "model_runtime.h"
+#include "decision_cache.h"
+#include "native_model.h"
+#include "init_log.h"
+#include "latency_stats.h"
+#include "boot_trace.h"
+#ifdef HAVE_ONNXRUNTIME
+#include "onnx_backend.h"
+#endif
 
-// For this prototype, we'll create a simple dummy implementation
-// In a real implementation, this would use ONNX Runtime or similar
+// Models in the built-in native format (see native_model.h) are evaluated
+// in-process and need no runtime. Other models run on ONNX Runtime when
+// ai_init is built with it (HAVE_ONNXRUNTIME). Otherwise, or when a model
+// cannot be loaded, a dummy implementation fills the output so the rest of
+// the system keeps working.
 
-void init_model_runtime() {
-    // In a real implementation, this would initialize the ONNX Runtime
-    // For this prototype, just print the action
-    printf("Initializing model runtime\n");
+#ifdef HAVE_ONNXRUNTIME
+static int onnx_available = 0;
+#endif
+
+// Serializes first-use loading of deferred models
+static pthread_mutex_t model_load_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Alignment of the per-model tensor arena (one cache line, suitable for SIMD)
+#define TENSOR_ARENA_ALIGNMENT 64
+#define ARENA_FLOATS_PER_LINE (TENSOR_ARENA_ALIGNMENT / (int)sizeof(float))
+
+static int round_to_line(int floats) {
+    return (floats + ARENA_FLOATS_PER_LINE - 1) / ARENA_FLOATS_PER_LINE * ARENA_FLOATS_PER_LINE;
 }
 
-ModelHandle *load_model(const char *model_path) {
-    // In a real implementation, this would load an ONNX model
-    // For this prototype, create a dummy model handle
+// Allocate the model's input and output tensors, and the normalization of
+// its input features, from one aligned block, each starting on its own cache
+// line. This is the only allocation on the inference path and happens once,
+// at load time.
+static int bind_tensor_arena(ModelHandle *model, int input_size, const int *output_sizes, int num_outputs) {
+    int num_features = input_size < FEATURE_VECTOR_SIZE ? input_size : FEATURE_VECTOR_SIZE;
+    int total = round_to_line(input_size) + 2 * round_to_line(num_features);
+    for (int i = 0; i < num_outputs; i++) total += round_to_line(output_sizes[i]);
+
+    model->arena = aligned_alloc(TENSOR_ARENA_ALIGNMENT, sizeof(float) * (size_t)total);
+    if (!model->arena) return -1;
+    memset(model->arena, 0, sizeof(float) * (size_t)total);
+
+    float *next = model->arena;
+    model->input.data = next;
+    model->input.size = input_size;
+    next += round_to_line(input_size);
+
+    for (int i = 0; i < num_outputs; i++) {
+        model->outputs[i].data = next;
+        model->outputs[i].size = output_sizes[i];
+        next += round_to_line(output_sizes[i]);
+    }
+    model->num_outputs = num_outputs;
+
+    model->feature_scale = next;
+    next += round_to_line(num_features);
+    model->feature_offset = next;
+    model->num_features = num_features;
+    load_feature_normalization(model->path, model->feature_scale, model->feature_offset, num_features);
+
+    return 0;
+}
+
+void init_model_runtime() {
+    log_info("Initializing model runtime");
     
-    ModelHandle *handle = malloc(sizeof(ModelHandle));
-    handle->handle = NULL;  // No actual model loaded
+#ifdef HAVE_ONNXRUNTIME
+    onnx_available = init_onnx_backend() == 0;
+    if (!onnx_available) {
+        log_warn("ONNX Runtime unavailable, using built-in dummy models");
+    }
+#endif
+}
+
+int model_runtime_has_onnx() {
+#ifdef HAVE_ONNXRUNTIME
+    return onnx_available;
+#else
+    return 0;
+#endif
+}
+
+ModelHandle *load_model_deferred(const char *model_path) {
+    ModelHandle *handle = calloc(1, sizeof(ModelHandle));
+    if (!handle) return NULL;
+    handle->handle = NULL;  // Dummy model unless a backend accepts it
+    handle->backend = MODEL_BACKEND_DUMMY;
+    handle->cache = NULL;
+    atomic_init(&handle->loaded, 0);
     strncpy(handle->name, model_path, sizeof(handle->name) - 1);
     handle->name[sizeof(handle->name) - 1] = '\0';  // Ensure null termination
+    strncpy(handle->path, model_path, sizeof(handle->path) - 1);
+    handle->path[sizeof(handle->path) - 1] = '\0';
     
-    printf("Loading model: %s\n", model_path);
+    return handle;
+}
+
+ModelHandle *load_model(const char *model_path) {
+    ModelHandle *handle = load_model_deferred(model_path);
+    if (!handle) return NULL;
+    
+    if (ensure_model_loaded(handle) < 0) {
+        free(handle);
+        return NULL;
+    }
     
     return handle;
 }
 
-Tensor *run_model_inference(ModelHandle *model, Tensor *input) {
-    // In a real implementation, this would run inference using ONNX Runtime
-    // For this prototype, create a dummy output tensor
+// Create the backend model and bind its tensors. Called once per handle,
+// under model_load_lock.
+static int load_model_backend(ModelHandle *handle) {
+    const char *model_path = handle->path;
+    
+    log_info("Loading model: %s", model_path);
     
-    printf("Running inference on model: %s\n", model->name);
+    // Output size is arbitrary for the dummy model
+    int input_size = SYSTEM_STATE_TENSOR_SIZE;
+    int output_sizes[MODEL_MAX_OUTPUTS] = { SYSTEM_STATE_TENSOR_SIZE * 2 };
+    int num_outputs = 1;
     
-    // Create output tensor
-    Tensor *output = malloc(sizeof(Tensor));
-    output->size = input->size * 2;  // Arbitrary size
-    output->data = malloc(sizeof(float) * output->size);
+    NativeModel *native_model = NULL;
+    if (is_native_model_file(model_path)) {
+        native_model = native_load_model(model_path, &input_size, &output_sizes[0]);
+    }
+    
+#ifdef HAVE_ONNXRUNTIME
+    // Create the session now so the first inference pays no setup cost
+    OnnxModel *onnx_model = NULL;
+    if (!native_model && onnx_available) {
+        onnx_model = onnx_load_model(model_path, &input_size, output_sizes, &num_outputs);
+    }
+#endif
     
-    // Fill with dummy data
-    for (int i = 0; i < output->size; i++) {
-        if (i < input->size) {
-            output->data[i] = input->data[i] * 2.0;  // Arbitrary transformation
+    // Bind fixed input/output buffers
+    if (bind_tensor_arena(handle, input_size, output_sizes, num_outputs) < 0) {
+        log_error("Failed to allocate tensor arena for model: %s", model_path);
+        if (native_model) native_unload_model(native_model);
+#ifdef HAVE_ONNXRUNTIME
+        if (onnx_model) onnx_unload_model(onnx_model);
+#endif
+        return -1;
+    }
+    
+    if (native_model) {
+        handle->handle = native_model;
+        handle->backend = MODEL_BACKEND_NATIVE;
+    }
+    
+#ifdef HAVE_ONNXRUNTIME
+    if (onnx_model) {
+        if (onnx_bind_model_io(onnx_model, &handle->input, handle->outputs) == 0) {
+            handle->handle = onnx_model;
+            handle->backend = MODEL_BACKEND_ONNX;
         } else {
-            output->data[i] = 0.5;  // Arbitrary default value
+            log_warn("Failed to bind model IO, using dummy model: %s", model_path);
+            onnx_unload_model(onnx_model);
         }
     }
+#endif
+    
+    return 0;
+}
+
+int ensure_model_loaded(ModelHandle *model) {
+    // Fast path: one acquire load once the model is ready
+    if (atomic_load_explicit(&model->loaded, memory_order_acquire)) return 0;
+    
+    pthread_mutex_lock(&model_load_lock);
+    int rc = 0;
+    if (!atomic_load_explicit(&model->loaded, memory_order_relaxed)) {
+        char span_name[sizeof(model->name) + 16];
+        snprintf(span_name, sizeof(span_name), "load_model %s", model->name);
+        int span = boot_trace_begin(span_name);
+        rc = load_model_backend(model);
+        boot_trace_end(span);
+        if (rc == 0) atomic_store_explicit(&model->loaded, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&model_load_lock);
+    
+    return rc;
+}
+
+static Tensor *run_backend_inference(ModelHandle *model, Tensor *input) {
+    // Inputs built elsewhere are copied into the bound buffer
+    if (input != &model->input) {
+        int size = input->size < model->input.size ? input->size : model->input.size;
+        memcpy(model->input.data, input->data, sizeof(float) * size);
+        input = &model->input;
+    }
+    
+    // Output tensors are owned by the model and reused across calls; all
+    // outputs are filled, and the first one is returned
+    Tensor *output = &model->outputs[0];
+    
+    if (model->backend == MODEL_BACKEND_NATIVE &&
+        native_run_model(model->handle, input->data, output->data) == 0) {
+        return output;
+    }
+    
+#ifdef HAVE_ONNXRUNTIME
+    // IO binding reads the input and writes the outputs in place
+    if (model->backend == MODEL_BACKEND_ONNX && onnx_run_model(model->handle) == 0) {
+        return output;
+    }
+#endif
+    
+    // Dummy model: fill with dummy data
+    for (int o = 0; o < model->num_outputs; o++) {
+        Tensor *head = &model->outputs[o];
+        for (int i = 0; i < head->size; i++) {
+            if (i < input->size) {
+                head->data[i] = input->data[i] * 2.0;  // Arbitrary transformation
+            } else {
+                head->data[i] = 0.5;  // Arbitrary default value
+            }
+        }
+    }
+    
+    return output;
+}
+
+Tensor *run_model_inference(ModelHandle *model, Tensor *input) {
+    log_debug("Running inference on model: %s", model->name);
+    
+    // Deferred models are loaded on first use; load time is not inference
+    if (ensure_model_loaded(model) < 0) return NULL;
+    
+    uint64_t start = latency_now();
+    Tensor *output = run_backend_inference(model, input);
+    latency_record(LATENCY_INFERENCE, start);
     
     return output;
 }
 
 void unload_model(ModelHandle *model) {
-    // In a real implementation, this would unload the ONNX model
-    // For this prototype, just free the handle
+    log_info("Unloading model: %s", model->name);
+    
+    if (model->backend == MODEL_BACKEND_NATIVE) native_unload_model(model->handle);
+#ifdef HAVE_ONNXRUNTIME
+    if (model->backend == MODEL_BACKEND_ONNX) onnx_unload_model(model->handle);
+#endif
     
-    printf("Unloading model: %s\n", model->name);
+    detach_decision_cache(model);
+    free(model->arena);
     free(model);
 }
\ No newline at end of file
@@ -6,7 +6,10 @@
 // Function prototypes
 void init_model_runtime();
 ModelHandle *load_model(const char *model_path);
+ModelHandle *load_model_deferred(const char *model_path);
+int ensure_model_loaded(ModelHandle *model);
 Tensor *run_model_inference(ModelHandle *model, Tensor *input);
 void unload_model(ModelHandle *model);
+int model_runtime_has_onnx();
 
 #endif /* MODEL_RUNTIME_H */
\ No newline at end of file
@@ -0,0 +1,324 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "model_updater.h"
+#include "learning_engine.h"
+#include "model_runtime.h"
+#include "decision_cache.h"
+#include "learning_log.h"
+#include "state_history.h"
+#include "cpu_topology.h"
+#include "init_log.h"
+
+static pthread_t updater_thread;
+static atomic_int updater_running = 0;
+
+// Wakes the thread early for request_model_update() and shutdown
+static pthread_mutex_t updater_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t updater_wake = PTHREAD_COND_INITIALIZER;
+static int update_requested = 0;
+
+// Modification time of the last candidate examined per slot, so a rejected
+// candidate is not validated again until it is replaced
+static struct timespec examined_mtime[NUM_MODEL_SLOTS];
+
+// Ring of the most recent states in the learning log. It carries over
+// from pass to pass, and each pass only reads the chunks appended since
+// the previous one: the log is followed by file identity and offset.
+static SystemState validation_states[MODEL_VALIDATION_SAMPLES];
+static HardwareState validation_hardware[MODEL_VALIDATION_SAMPLES];
+static long validation_total = 0;
+static uint64_t validation_state_ns = 0;    // Timestamp of the latest STATE record
+static dev_t log_device;
+static ino_t log_inode;
+static size_t log_offset = 0;               // 0 before the first scan
+
+// CPU budget
+//
+// SCHED_IDLE keeps the updater off a busy CPU, but on an idle one it would
+// still run flat out. After every MODEL_UPDATE_SLICE_MS of thread CPU time
+// it sleeps long enough to bring its average down to the budget.
+static uint64_t slice_start_ns;
+
+static uint64_t thread_cpu_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void throttle() {
+    uint64_t used = thread_cpu_ns() - slice_start_ns;
+    if (used < MODEL_UPDATE_SLICE_MS * 1000000ull) return;
+
+    uint64_t sleep_ns = used * (100 - MODEL_UPDATE_CPU_BUDGET_PCT) / MODEL_UPDATE_CPU_BUDGET_PCT;
+    struct timespec ts = { (time_t)(sleep_ns / 1000000000ull), (long)(sleep_ns % 1000000000ull) };
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR) {
+    }
+
+    slice_start_ns = thread_cpu_ns();
+}
+
+// Add the states of the chunks after log_offset to the ring. An offset
+// past the end means the log was cut back to its intact prefix; it is
+// then read again from the start.
+static void read_new_states(LearningLogReader *reader) {
+    if (log_offset > reader->offset && log_offset <= reader->size) reader->offset = log_offset;
+
+    const LearningRecord *records;
+    int num_records;
+    while ((records = learning_log_next_chunk(reader, &num_records))) {
+        for (int i = 0; i < num_records; i++) {
+            if (records[i].type == LOG_RECORD_STATE) {
+                int s = (int)(validation_total % MODEL_VALIDATION_SAMPLES);
+                validation_states[s] = learning_record_state(&records[i], &validation_hardware[s]);
+                validation_state_ns = records[i].timestamp_ns;
+                validation_total++;
+            } else if (records[i].type == LOG_RECORD_HARDWARE && validation_total > 0 &&
+                       records[i].timestamp_ns == validation_state_ns) {
+                learning_record_hardware(&records[i],
+                                         &validation_hardware[(validation_total - 1) % MODEL_VALIDATION_SAMPLES]);
+            }
+        }
+        throttle();
+    }
+    log_offset = reader->offset;
+}
+
+// Bring validation_states and validation_hardware up to date with the
+// learning log. Without a log, the in-memory history is used instead; it
+// holds no hardware state, so those states are paired with the current
+// one. Returns the number of states.
+static int load_validation_states() {
+    LearningLogReader reader;
+    if (open_learning_log_reader(LEARNING_LOG_PATH, &reader) == 0) {
+        if (reader.device != log_device || reader.inode != log_inode) {
+            // Rotated since the last pass: finish the file read then
+            LearningLogReader rotated;
+            if (log_offset > 0 &&
+                open_learning_log_reader(LEARNING_LOG_PATH LEARNING_LOG_ROTATED_SUFFIX, &rotated) == 0) {
+                if (rotated.device == log_device && rotated.inode == log_inode) read_new_states(&rotated);
+                close_learning_log_reader(&rotated);
+            }
+            log_device = reader.device;
+            log_inode = reader.inode;
+            log_offset = 0;
+        }
+        read_new_states(&reader);
+        close_learning_log_reader(&reader);
+    }
+    if (validation_total > 0) {
+        return validation_total < MODEL_VALIDATION_SAMPLES ? (int)validation_total : MODEL_VALIDATION_SAMPLES;
+    }
+
+    static double series[HISTORY_NUM_METRICS][MODEL_VALIDATION_SAMPLES];
+    int n = MODEL_VALIDATION_SAMPLES;
+    for (int m = 0; m < HISTORY_NUM_METRICS; m++) {
+        int copied = state_history_copy(m, MODEL_VALIDATION_SAMPLES, series[m]);
+        if (copied < n) n = copied;
+    }
+    HardwareState hardware = get_current_hardware_state();
+    for (int i = 0; i < n; i++) {
+        validation_hardware[i] = hardware;
+        SystemState *state = &validation_states[i];
+        memset(state, 0, sizeof(*state));
+        state->cpu_usage = series[HISTORY_CPU_USAGE][i];
+        state->memory_usage = series[HISTORY_MEMORY_USAGE][i];
+        state->io_usage = series[HISTORY_IO_USAGE][i];
+        state->network_usage = series[HISTORY_NETWORK_USAGE][i];
+        state->num_processes = (int)series[HISTORY_NUM_PROCESSES][i];
+        state->num_users = (int)series[HISTORY_NUM_USERS][i];
+        state->battery_level = series[HISTORY_BATTERY_LEVEL][i];
+        state->on_ac_power = (int)series[HISTORY_ON_AC_POWER][i];
+    }
+    return n;
+}
+
+// Compare a candidate against the current model on held-out states.
+// Returns 0 if the candidate may replace it.
+static int validate_candidate(ModelHandle *candidate, ModelHandle *current, int num_states) {
+    if (candidate->num_outputs != current->num_outputs) {
+        log_warn("Model updater: %s has %d outputs, expected %d",
+                 candidate->path, candidate->num_outputs, current->num_outputs);
+        return -1;
+    }
+    for (int o = 0; o < candidate->num_outputs; o++) {
+        if (candidate->outputs[o].size != current->outputs[o].size) {
+            log_warn("Model updater: %s output %d has size %d, expected %d",
+                     candidate->path, o, candidate->outputs[o].size, current->outputs[o].size);
+            return -1;
+        }
+    }
+    if (num_states == 0) {
+        log_warn("Model updater: no held-out states to validate %s", candidate->path);
+        return -1;
+    }
+
+    double drift = 0.0;
+    long count = 0;
+    for (int s = 0; s < num_states; s++) {
+        Tensor *input = create_system_state_tensor(candidate, validation_states[s], &validation_hardware[s]);
+        if (!input || !run_model_inference(candidate, input)) return -1;
+        input = create_system_state_tensor(current, validation_states[s], &validation_hardware[s]);
+        if (!input || !run_model_inference(current, input)) return -1;
+
+        for (int o = 0; o < candidate->num_outputs; o++) {
+            const float *c = candidate->outputs[o].data;
+            const float *b = current->outputs[o].data;
+            for (int i = 0; i < candidate->outputs[o].size; i++) {
+                if (!isfinite(c[i])) {
+                    log_warn("Model updater: %s produces non-finite outputs", candidate->path);
+                    return -1;
+                }
+                drift += fabs((double)c[i] - (double)b[i]);
+                count++;
+            }
+        }
+        throttle();
+    }
+
+    drift = count > 0 ? drift / count : 0.0;
+    if (drift > MODEL_MAX_DRIFT) {
+        log_warn("Model updater: %s drifts %.3f from the current model (limit %.3f)",
+                 candidate->path, drift, MODEL_MAX_DRIFT);
+        return -1;
+    }
+    return 0;
+}
+
+// The candidate was normalized by its own metadata (see feature_vector.h),
+// or by the defaults if it had none; the installed model keeps the same
+static void install_feature_metadata(const char *candidate_path, const char *path) {
+    char from[sizeof(((ModelHandle *)0)->path) + sizeof(MODEL_CANDIDATE_SUFFIX FEATURE_METADATA_SUFFIX)];
+    char to[sizeof(((ModelHandle *)0)->path) + sizeof(FEATURE_METADATA_SUFFIX)];
+    snprintf(from, sizeof(from), "%s" FEATURE_METADATA_SUFFIX, candidate_path);
+    snprintf(to, sizeof(to), "%s" FEATURE_METADATA_SUFFIX, path);
+
+    if (rename(from, to) == 0) return;
+    if (errno != ENOENT || (unlink(to) < 0 && errno != ENOENT)) {
+        log_warn("Model updater: cannot install feature metadata %s: %s", to, strerror(errno));
+    }
+}
+
+// Validate and publish the candidate for one slot, if there is a new one
+static void update_slot(ModelSlot slot, int *num_states) {
+    char path[sizeof(((ModelHandle *)0)->path)];
+    int token = models_read_lock();
+    ModelHandle *published = get_slot_model(slot);
+    if (published) snprintf(path, sizeof(path), "%s", published->path);
+    models_read_unlock(token);
+    if (!published) return;
+
+    char candidate_path[sizeof(path) + sizeof(MODEL_CANDIDATE_SUFFIX)];
+    snprintf(candidate_path, sizeof(candidate_path), "%s" MODEL_CANDIDATE_SUFFIX, path);
+
+    struct stat st;
+    if (stat(candidate_path, &st) < 0) return;
+    if (st.st_mtim.tv_sec == examined_mtime[slot].tv_sec &&
+        st.st_mtim.tv_nsec == examined_mtime[slot].tv_nsec) {
+        return;
+    }
+    examined_mtime[slot] = st.st_mtim;
+
+    // Held-out states are brought up to date once per pass, when first needed
+    if (*num_states < 0) *num_states = load_validation_states();
+
+    // Compare against a private copy of the current model; the published
+    // handle's tensors belong to the decision loop
+    ModelHandle *candidate = load_model(candidate_path);
+    ModelHandle *current = load_model(path);
+    int valid = candidate && current && validate_candidate(candidate, current, *num_states) == 0;
+    if (current) unload_model(current);
+
+    if (!valid) {
+        if (candidate) unload_model(candidate);
+        log_warn("Model updater: rejected %s", candidate_path);
+        return;
+    }
+
+    if (rename(candidate_path, path) < 0) {
+        log_error("Model updater: cannot install %s: %s", candidate_path, strerror(errno));
+        unload_model(candidate);
+        return;
+    }
+    install_feature_metadata(candidate_path, path);
+    snprintf(candidate->path, sizeof(candidate->path), "%s", path);
+    snprintf(candidate->name, sizeof(candidate->name), "%.*s", (int)sizeof(candidate->name) - 1, path);
+
+    // Periodic decisions are memoized; the boot sequence runs once
+    if (slot != MODEL_SLOT_BOOT) attach_decision_cache(candidate);
+
+    replace_slot_model(slot, candidate);
+    log_info("Model updated: %s", path);
+}
+
+static void *model_updater_func(void *arg) {
+    (void)arg;
+    pin_housekeeping_thread(pthread_self(), HOUSEKEEPING_WORKER);
+
+    // Only ever run on otherwise idle CPU time
+    struct sched_param param = { 0 };
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        log_warn("Model updater: cannot switch to SCHED_IDLE");
+    }
+    slice_start_ns = thread_cpu_ns();
+
+    while (atomic_load(&updater_running)) {
+        int num_states = -1;
+        for (int slot = 0; slot < NUM_MODEL_SLOTS; slot++) {
+            update_slot(slot, &num_states);
+        }
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += MODEL_UPDATE_INTERVAL_S;
+
+        pthread_mutex_lock(&updater_lock);
+        while (!update_requested && atomic_load(&updater_running)) {
+            if (pthread_cond_timedwait(&updater_wake, &updater_lock, &deadline) == ETIMEDOUT) break;
+        }
+        update_requested = 0;
+        pthread_mutex_unlock(&updater_lock);
+    }
+
+    return NULL;
+}
+
+int start_model_updater() {
+    atomic_store(&updater_running, 1);
+    if (pthread_create(&updater_thread, NULL, model_updater_func, NULL) != 0) {
+        log_error("Failed to create model updater thread");
+        atomic_store(&updater_running, 0);
+        return -1;
+    }
+
+    log_info("Model updater started");
+    return 0;
+}
+
+void stop_model_updater() {
+    if (!atomic_load(&updater_running)) return;
+
+    pthread_mutex_lock(&updater_lock);
+    atomic_store(&updater_running, 0);
+    pthread_cond_signal(&updater_wake);
+    pthread_mutex_unlock(&updater_lock);
+
+    pthread_join(updater_thread, NULL);
+}
+
+void request_model_update() {
+    pthread_mutex_lock(&updater_lock);
+    update_requested = 1;
+    pthread_cond_signal(&updater_wake);
+    pthread_mutex_unlock(&updater_lock);
+}
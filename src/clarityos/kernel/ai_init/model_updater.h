@@ -0,0 +1,27 @@
+#ifndef MODEL_UPDATER_H
+#define MODEL_UPDATER_H
+
+// Background model updates
+//
+// Refit models are produced offline from the learning log and installed
+// next to the model they replace as <path>.candidate. The updater thread
+// runs under SCHED_IDLE within a CPU budget; it validates each new
+// candidate against the most recent states in the log, and only a candidate
+// that produces finite outputs of the same shape, within MODEL_MAX_DRIFT of
+// the current model, is renamed into place and published. Inference keeps
+// using the current model throughout (see replace_slot_model()).
+
+#define MODEL_CANDIDATE_SUFFIX ".candidate"
+
+#define MODEL_UPDATE_INTERVAL_S 300         // Candidate scan period
+#define MODEL_UPDATE_CPU_BUDGET_PCT 5       // Of one CPU, averaged over slices
+#define MODEL_UPDATE_SLICE_MS 10            // CPU time between budget sleeps
+#define MODEL_VALIDATION_SAMPLES 256        // Held-out states per validation
+#define MODEL_MAX_DRIFT 0.25                // Mean absolute output difference
+
+// Function prototypes
+int start_model_updater();
+void stop_model_updater();
+void request_model_update();
+
+#endif /* MODEL_UPDATER_H */
@@ -0,0 +1,72 @@
+#ifndef NATIVE_MODEL_H
+#define NATIVE_MODEL_H
+
+#include <stdint.h>
+
+// Built-in model format ("CLNM") evaluated without any external runtime.
+// Used in early boot and initramfs, where ONNX Runtime is not available.
+//
+// File layout (little-endian):
+//   NativeModelHeader
+//   MLP:  num_layers x { NativeLayerHeader, weights[rows * cols], bias[rows] }
+//   GBDT: NativeForestHeader, base_score[num_outputs],
+//         trees[num_trees] (NativeTree), nodes[num_nodes] (NativeTreeNode)
+
+#define NATIVE_MODEL_MAGIC   0x4D4E4C43  // "CLNM"
+#define NATIVE_MODEL_VERSION 1
+#define NATIVE_MODEL_SUFFIX  ".cnm"
+
+#define NATIVE_MODEL_MLP   1
+#define NATIVE_MODEL_GBDT  2
+
+#define NATIVE_ACTIVATION_NONE     0
+#define NATIVE_ACTIVATION_RELU     1
+#define NATIVE_ACTIVATION_SIGMOID  2
+#define NATIVE_ACTIVATION_TANH     3
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t num_inputs;
+    uint32_t num_outputs;
+    uint32_t num_layers;        // MLP only
+    uint32_t reserved;
+} NativeModelHeader;
+
+typedef struct {
+    uint32_t rows;              // Output width
+    uint32_t cols;              // Input width
+    uint32_t activation;
+    uint32_t reserved;
+} NativeLayerHeader;
+
+typedef struct {
+    uint32_t num_trees;
+    uint32_t num_nodes;
+} NativeForestHeader;
+
+typedef struct {
+    uint32_t root;              // Index of the tree's root node
+    uint32_t output;            // Output the tree's leaf value is added to
+} NativeTree;
+
+// Children of a split are stored adjacently: the walk continues at
+// left + (x[feature] > threshold), which compiles to a compare-and-add
+// instead of an unpredictable branch.
+typedef struct {
+    int32_t feature;            // Split feature, or -1 for a leaf
+    float value;                // Split threshold, or the leaf value
+    uint32_t left;              // Index of the left child (right is left + 1)
+    uint32_t reserved;
+} NativeTreeNode;
+
+typedef struct NativeModel NativeModel;
+
+// Function prototypes
+int is_native_model_file(const char *model_path);
+NativeModel *native_load_model(const char *model_path, int *input_size, int *output_size);
+int native_run_model(NativeModel *model, const float *input, float *output);
+void native_unload_model(NativeModel *model);
+
+#endif /* NATIVE_MODEL_H */
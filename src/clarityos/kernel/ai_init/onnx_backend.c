@@ -0,0 +1,319 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <onnxruntime_c_api.h>
+#include "onnx_backend.h"
+#include "model_file.h"
+#include "init_log.h"
+
+// ONNX Runtime backend
+//
+// One environment with global intra-op/inter-op thread pools is shared by
+// every session, so adding models does not multiply threads in PID 1. Each
+// model gets one session, created at load time and reused for its lifetime.
+// Inputs and outputs are bound once with IO binding onto the model's tensor
+// arena, so an inference call is a single RunWithBinding() with no copies
+// or allocations.
+//
+// The optimized graph is cached next to the model as "<model>.opt.ort". When
+// the cache is newer than the model, later boots load it with graph
+// optimization disabled and skip the optimization passes entirely. The cache
+// is memory-mapped and ORT is told to use the mapped bytes directly, including
+// for initializers, so weights stay in shared read-only page cache instead of
+// being copied into each session.
+
+// Thread pool sizes; the models are tiny, so parallelism rarely pays off
+#ifndef ONNX_INTRA_OP_THREADS
+#define ONNX_INTRA_OP_THREADS 1
+#endif
+#ifndef ONNX_INTER_OP_THREADS
+#define ONNX_INTER_OP_THREADS 1
+#endif
+
+#define ONNX_CACHE_SUFFIX ".opt.ort"
+#define ONNX_MAX_DIMS 8
+
+// Shape and binding of one model input or output
+typedef struct {
+    char *name;
+    OrtValue *value;
+    int64_t shape[ONNX_MAX_DIMS];
+    size_t rank;
+} OnnxTensorBinding;
+
+struct OnnxModel {
+    MappedModelFile file;       // Mapped ORT-format cache, if used
+    OrtSession *session;
+    OrtIoBinding *binding;
+    OnnxTensorBinding input;
+    OnnxTensorBinding outputs[MODEL_MAX_OUTPUTS];
+    int num_outputs;
+};
+
+static const OrtApi *ort = NULL;
+static OrtEnv *ort_env = NULL;
+static OrtMemoryInfo *cpu_memory_info = NULL;
+static OrtAllocator *default_allocator = NULL;
+
+// Report and release a failed status. Returns 0 on success, -1 on failure.
+static int check_status(OrtStatus *status, const char *what) {
+    if (!status) return 0;
+
+    log_error("ONNX Runtime: %s failed: %s", what, ort->GetErrorMessage(status));
+    ort->ReleaseStatus(status);
+    return -1;
+}
+
+int init_onnx_backend() {
+    OrtThreadingOptions *threading = NULL;
+
+    ort = OrtGetApiBase()->GetApi(ORT_API_VERSION);
+    if (!ort) {
+        log_error("ONNX Runtime: API version %d not supported", ORT_API_VERSION);
+        return -1;
+    }
+
+    if (check_status(ort->CreateThreadingOptions(&threading), "CreateThreadingOptions") < 0) return -1;
+
+    int rc = check_status(ort->SetGlobalIntraOpNumThreads(threading, ONNX_INTRA_OP_THREADS),
+                          "SetGlobalIntraOpNumThreads");
+    if (rc == 0) {
+        rc = check_status(ort->SetGlobalInterOpNumThreads(threading, ONNX_INTER_OP_THREADS),
+                          "SetGlobalInterOpNumThreads");
+    }
+    if (rc == 0) {
+        rc = check_status(ort->CreateEnvWithGlobalThreadPools(ORT_LOGGING_LEVEL_WARNING, "ai_init",
+                                                              threading, &ort_env),
+                          "CreateEnvWithGlobalThreadPools");
+    }
+    ort->ReleaseThreadingOptions(threading);
+    if (rc < 0) return -1;
+
+    if (check_status(ort->CreateCpuMemoryInfo(OrtDeviceAllocator, OrtMemTypeDefault, &cpu_memory_info),
+                     "CreateCpuMemoryInfo") < 0 ||
+        check_status(ort->GetAllocatorWithDefaultOptions(&default_allocator),
+                     "GetAllocatorWithDefaultOptions") < 0) {
+        shutdown_onnx_backend();
+        return -1;
+    }
+
+    log_info("ONNX Runtime initialized (intra-op %d, inter-op %d threads)",
+             ONNX_INTRA_OP_THREADS, ONNX_INTER_OP_THREADS);
+    return 0;
+}
+
+void shutdown_onnx_backend() {
+    if (cpu_memory_info) ort->ReleaseMemoryInfo(cpu_memory_info);
+    if (ort_env) ort->ReleaseEnv(ort_env);
+    cpu_memory_info = NULL;
+    ort_env = NULL;
+}
+
+// Returns 1 if the cached optimized graph exists and is at least as new as
+// the source model
+static int cache_is_fresh(const char *model_path, const char *cache_path) {
+    struct stat model_stat;
+    struct stat cache_stat;
+
+    if (stat(cache_path, &cache_stat) < 0) return 0;
+    if (stat(model_path, &model_stat) < 0) return 1;  // Only the cache shipped
+
+    return cache_stat.st_mtime >= model_stat.st_mtime;
+}
+
+static OrtSession *create_session(const char *model_path, MappedModelFile *file) {
+    OrtSessionOptions *options = NULL;
+    OrtSession *session = NULL;
+    char cache_path[512];
+
+    snprintf(cache_path, sizeof(cache_path), "%s%s", model_path, ONNX_CACHE_SUFFIX);
+    int use_cache = cache_is_fresh(model_path, cache_path);
+
+    if (check_status(ort->CreateSessionOptions(&options), "CreateSessionOptions") < 0) return NULL;
+
+    // Use the environment's global thread pools instead of per-session ones
+    int rc = check_status(ort->DisablePerSessionThreads(options), "DisablePerSessionThreads");
+
+    if (rc == 0 && use_cache && map_model_file(cache_path, file) < 0) {
+        use_cache = 0;
+    }
+
+    if (rc == 0 && use_cache) {
+        // Already optimized for this host: skip graph optimization, and run
+        // straight from the mapped bytes (they must outlive the session)
+        rc = check_status(ort->SetSessionGraphOptimizationLevel(options, ORT_DISABLE_ALL),
+                          "SetSessionGraphOptimizationLevel");
+        if (rc == 0) {
+            rc = check_status(ort->AddSessionConfigEntry(options, "session.use_ort_model_bytes_directly", "1"),
+                              "AddSessionConfigEntry");
+        }
+        if (rc == 0) {
+            rc = check_status(ort->AddSessionConfigEntry(options, "session.use_ort_model_bytes_for_initializers", "1"),
+                              "AddSessionConfigEntry");
+        }
+    } else if (rc == 0) {
+        rc = check_status(ort->SetSessionGraphOptimizationLevel(options, ORT_ENABLE_ALL),
+                          "SetSessionGraphOptimizationLevel");
+        if (rc == 0) {
+            rc = check_status(ort->AddSessionConfigEntry(options, "session.save_model_format", "ORT"),
+                              "AddSessionConfigEntry");
+        }
+        if (rc == 0) {
+            rc = check_status(ort->SetOptimizedModelFilePath(options, cache_path),
+                              "SetOptimizedModelFilePath");
+        }
+    }
+
+    if (rc == 0) {
+        OrtStatus *status = use_cache
+            ? ort->CreateSessionFromArray(ort_env, file->data, file->size, options, &session)
+            : ort->CreateSession(ort_env, model_path, options, &session);
+        if (check_status(status, "CreateSession") == 0) {
+            log_info("ONNX Runtime session created for %s%s", model_path,
+                     use_cache ? " (cached optimized graph)" : "");
+        }
+    }
+
+    if (!session) unmap_model_file(file);
+
+    ort->ReleaseSessionOptions(options);
+    return session;
+}
+
+// Read a tensor's shape; dynamic dimensions (batch) are fixed to 1.
+// Returns the element count, or -1 on failure.
+static int64_t read_tensor_shape(OrtTypeInfo *type_info, int64_t *shape, size_t *rank) {
+    const OrtTensorTypeAndShapeInfo *tensor_info = NULL;
+    size_t dims = 0;
+
+    if (check_status(ort->CastTypeInfoToTensorInfo(type_info, &tensor_info), "CastTypeInfoToTensorInfo") < 0 ||
+        check_status(ort->GetDimensionsCount(tensor_info, &dims), "GetDimensionsCount") < 0) {
+        return -1;
+    }
+    if (dims > ONNX_MAX_DIMS) return -1;
+    if (check_status(ort->GetDimensions(tensor_info, shape, dims), "GetDimensions") < 0) return -1;
+
+    int64_t count = 1;
+    for (size_t i = 0; i < dims; i++) {
+        if (shape[i] <= 0) shape[i] = 1;
+        count *= shape[i];
+    }
+
+    *rank = dims;
+    return count;
+}
+
+// Fetch the name and shape of input or output `index`. Returns the element
+// count, or -1 on failure.
+static int64_t query_io(OnnxModel *model, int is_input, size_t index, OnnxTensorBinding *tensor) {
+    OrtTypeInfo *type_info = NULL;
+    OrtStatus *status;
+
+    if (is_input) {
+        status = ort->SessionGetInputName(model->session, index, default_allocator, &tensor->name);
+    } else {
+        status = ort->SessionGetOutputName(model->session, index, default_allocator, &tensor->name);
+    }
+    if (check_status(status, "SessionGetName") < 0) return -1;
+
+    if (is_input) {
+        status = ort->SessionGetInputTypeInfo(model->session, index, &type_info);
+    } else {
+        status = ort->SessionGetOutputTypeInfo(model->session, index, &type_info);
+    }
+    if (check_status(status, "SessionGetTypeInfo") < 0) return -1;
+
+    int64_t count = read_tensor_shape(type_info, tensor->shape, &tensor->rank);
+    ort->ReleaseTypeInfo(type_info);
+
+    return count;
+}
+
+OnnxModel *onnx_load_model(const char *model_path, int *input_size, int *output_sizes, int *num_outputs) {
+    if (!ort_env) return NULL;
+
+    OnnxModel *model = calloc(1, sizeof(OnnxModel));
+    if (!model) return NULL;
+
+    model->session = create_session(model_path, &model->file);
+    if (!model->session) {
+        free(model);
+        return NULL;
+    }
+
+    // Single input (the system state vector); one output per decision head
+    size_t output_count = 0;
+    int64_t inputs = query_io(model, 1, 0, &model->input);
+    if (check_status(ort->SessionGetOutputCount(model->session, &output_count), "SessionGetOutputCount") < 0 ||
+        output_count == 0 || output_count > MODEL_MAX_OUTPUTS || inputs <= 0) {
+        log_error("ONNX Runtime: unsupported model signature in %s", model_path);
+        onnx_unload_model(model);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < output_count; i++) {
+        int64_t outputs = query_io(model, 0, i, &model->outputs[i]);
+        model->num_outputs = (int)i + 1;
+        if (outputs <= 0) {
+            log_error("ONNX Runtime: unsupported output %zu in %s", i, model_path);
+            onnx_unload_model(model);
+            return NULL;
+        }
+        output_sizes[i] = (int)outputs;
+    }
+
+    *input_size = (int)inputs;
+    *num_outputs = model->num_outputs;
+    return model;
+}
+
+// Wrap an arena buffer in an OrtValue without copying
+static int create_bound_value(OnnxTensorBinding *tensor, Tensor *buffer) {
+    return check_status(ort->CreateTensorWithDataAsOrtValue(cpu_memory_info, buffer->data,
+                                                            sizeof(float) * buffer->size,
+                                                            tensor->shape, tensor->rank,
+                                                            ONNX_TENSOR_ELEMENT_DATA_TYPE_FLOAT,
+                                                            &tensor->value),
+                        "CreateTensorWithDataAsOrtValue");
+}
+
+int onnx_bind_model_io(OnnxModel *model, Tensor *input, Tensor *outputs) {
+    // ORT reads and writes the bound arena buffers in place on every run
+    if (check_status(ort->CreateIoBinding(model->session, &model->binding), "CreateIoBinding") < 0 ||
+        create_bound_value(&model->input, input) < 0 ||
+        check_status(ort->BindInput(model->binding, model->input.name, model->input.value), "BindInput") < 0) {
+        return -1;
+    }
+
+    for (int i = 0; i < model->num_outputs; i++) {
+        if (create_bound_value(&model->outputs[i], &outputs[i]) < 0 ||
+            check_status(ort->BindOutput(model->binding, model->outputs[i].name, model->outputs[i].value),
+                         "BindOutput") < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int onnx_run_model(OnnxModel *model) {
+    return check_status(ort->RunWithBinding(model->session, NULL, model->binding), "RunWithBinding");
+}
+
+static void release_tensor_binding(OnnxTensorBinding *tensor) {
+    if (tensor->value) ort->ReleaseValue(tensor->value);
+    if (tensor->name) ort->AllocatorFree(default_allocator, tensor->name);
+}
+
+void onnx_unload_model(OnnxModel *model) {
+    if (model->binding) ort->ReleaseIoBinding(model->binding);
+    release_tensor_binding(&model->input);
+    for (int i = 0; i < model->num_outputs; i++) {
+        release_tensor_binding(&model->outputs[i]);
+    }
+    if (model->session) ort->ReleaseSession(model->session);
+    unmap_model_file(&model->file);
+    free(model);
+}
@@ -0,0 +1,17 @@
+#ifndef ONNX_BACKEND_H
+#define ONNX_BACKEND_H
+
+#include "learning_engine.h"
+
+// ONNX Runtime backend (built when HAVE_ONNXRUNTIME is defined)
+typedef struct OnnxModel OnnxModel;
+
+// Function prototypes
+int init_onnx_backend();
+void shutdown_onnx_backend();
+OnnxModel *onnx_load_model(const char *model_path, int *input_size, int *output_sizes, int *num_outputs);
+int onnx_bind_model_io(OnnxModel *model, Tensor *input, Tensor *outputs);
+int onnx_run_model(OnnxModel *model);
+void onnx_unload_model(OnnxModel *model);
+
+#endif /* ONNX_BACKEND_H */
@@ -0,0 +1,1037 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <sys/wait.h>
+#include "process_manager.h"
+#include "init_log.h"
+#include "latency_stats.h"
+#include "boot_trace.h"
+#include "sched_policy.h"
+
+extern char **environ;
+
+// Boot execution
+//
+// start_process_groups() flattens the groups into a dependency graph instead
+// of running them one after another. A process depends on its explicit
+// dependencies and, implicitly, on every process of the most recent earlier
+// group with wait_for_completion set. Processes whose dependencies are all
+// satisfied are spawned right away (posix_spawn, which glibc implements with
+// clone(CLONE_VM | CLONE_VFORK), so no page tables are copied), picking the
+// one with the longest chain of dependents first. At most one notify-type
+// process per online core is waiting for readiness at a time, so a wide
+// graph does not start everything at once. A process is satisfied when it
+// sends READY=1 on the notify socket, when a non-notify process has been
+// spawned, or when it exits with status 0 (one-shot tasks). If it fails,
+// everything depending on it is skipped. Boot time is therefore bounded by
+// the critical path of the graph, not by the sum of the groups.
+//
+// Processes that declare sockets are socket-activated: ai_init binds their
+// listeners before anything starts and keeps them for the lifetime of the
+// system. Dependents connect (or log) right away, and the kernel queues the
+// requests until the provider accepts them. A dependency on such a process,
+// explicit or through a barrier group, therefore adds no ordering edge.
+
+typedef struct BootNode BootNode;
+
+// Process table, indexed by ProcessId. Names are interned once through a
+// hash index; slots are never reused, so ids and pointers stay valid.
+// Used from the main thread only.
+typedef struct {
+    ProcessEntry entry;
+    pid_t pid;
+    ProcessStatus status;
+    BootNode *boot_node;        // Set while the process is part of a running boot
+    int listen_fds[MAX_PROCESS_SOCKETS];
+    int num_listen_fds;         // Held across restarts of the process
+    int priority;               // Nice value last applied (0 after each start)
+    uint64_t transition_ns;     // Last start or stop, for dwell times
+    int start_failures;         // Consecutive failed starts, for the backoff
+    uint64_t priority_changed_ns;
+} ManagedProcess;
+
+static ManagedProcess managed[MAX_MANAGED_PROCESSES];
+static int num_managed = 0;
+
+// Open addressing; a slot holds id + 1, 0 when empty
+#define PROCESS_NAME_BUCKETS 512
+static unsigned short name_index[PROCESS_NAME_BUCKETS];
+
+struct BootNode {
+    ProcessEntry *entry;
+    ManagedProcess *proc;
+    int pending_deps;           // Unsatisfied dependencies
+    int first_dependent;        // Offset into boot_edges
+    int num_dependents;
+    int critical_path;          // Processes on the longest chain starting here
+    int settled;
+    uint64_t deadline_ns;       // Readiness deadline, set while counted as starting
+};
+
+#define MAX_BOOT_EDGES 4096
+
+static BootNode boot_nodes[MAX_MANAGED_PROCESSES];
+static int boot_edges[MAX_BOOT_EDGES];      // Dependents, grouped per node
+static int boot_ready[MAX_MANAGED_PROCESSES];
+static int num_boot_nodes = 0;
+static int num_boot_ready = 0;
+static int boot_remaining = 0;
+static int boot_starting = 0;
+
+static int event_fd = -1;       // epoll over the two fds below
+static int signal_fd = -1;      // SIGCHLD
+static int notify_fd = -1;      // Readiness datagrams
+
+#define MAX_SPAWN_ENV 256
+static char *spawn_env[MAX_SPAWN_ENV];
+static char notify_env[] = "NOTIFY_SOCKET=@" NOTIFY_SOCKET_NAME;
+
+static int max_parallel_starts = 1;
+
+static ProcessId managed_id(const ManagedProcess *proc) {
+    return (ProcessId)(proc - managed);
+}
+
+// Listener fds are kept at or above this number so that moving them to
+// LISTEN_FDS_START.. in the child never overwrites another listener
+#define LISTEN_FD_FLOOR (LISTEN_FDS_START + MAX_PROCESS_SOCKETS)
+
+static const char *status_names[] = {
+    "pending", "starting", "ready", "exited", "failed", "skipped"
+};
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned int hash_name(const char *name) {
+    unsigned int hash = 2166136261u;    // FNV-1a
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash = (hash ^ *c) * 16777619u;
+    }
+    return hash;
+}
+
+// Bucket holding name, or the empty bucket where it would go
+static unsigned int name_bucket(const char *name) {
+    unsigned int bucket = hash_name(name) & (PROCESS_NAME_BUCKETS - 1);
+    while (name_index[bucket] && strcmp(managed[name_index[bucket] - 1].entry.name, name) != 0) {
+        bucket = (bucket + 1) & (PROCESS_NAME_BUCKETS - 1);
+    }
+    return bucket;
+}
+
+ProcessId find_process(const char *name) {
+    return (ProcessId)name_index[name_bucket(name)] - 1;
+}
+
+ProcessId intern_process(const char *name) {
+    unsigned int bucket = name_bucket(name);
+    if (name_index[bucket]) return (ProcessId)name_index[bucket] - 1;
+    if (num_managed == MAX_MANAGED_PROCESSES || name[0] == '\0' || strlen(name) >= MAX_PROCESS_NAME) {
+        log_error("Cannot register process %s", name);
+        return PROCESS_ID_NONE;
+    }
+
+    ManagedProcess *proc = &managed[num_managed];
+    memset(proc, 0, sizeof(*proc));
+    strcpy(proc->entry.name, name);
+    proc->status = PROCESS_PENDING;
+    name_index[bucket] = (unsigned short)(num_managed + 1);
+    return num_managed++;
+}
+
+static ManagedProcess *get_managed(ProcessId id) {
+    return id >= 0 && id < num_managed ? &managed[id] : NULL;
+}
+
+ProcessEntry *get_process_entry(ProcessId id) {
+    ManagedProcess *proc = get_managed(id);
+    return proc ? &proc->entry : NULL;
+}
+
+const char *process_name(ProcessId id) {
+    ManagedProcess *proc = get_managed(id);
+    return proc ? proc->entry.name : "(unknown)";
+}
+
+int process_table_size() {
+    return num_managed;
+}
+
+static ManagedProcess *find_managed_pid(pid_t pid) {
+    for (int i = 0; i < num_managed; i++) {
+        if (managed[i].pid == pid) return &managed[i];
+    }
+    return NULL;
+}
+
+static int process_running(const ManagedProcess *proc) {
+    return proc->pid > 0 && (proc->status == PROCESS_STARTING || proc->status == PROCESS_READY);
+}
+
+static int open_notify_socket() {
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+
+    // Abstract address: no filesystem needed this early in boot
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path + 1, NOTIFY_SOCKET_NAME, strlen(NOTIFY_SOCKET_NAME));
+    socklen_t len = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(NOTIFY_SOCKET_NAME);
+
+    int one = 1;
+    if (bind(fd, (struct sockaddr *)&addr, len) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_PASSCRED, &one, sizeof(one)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void build_spawn_env() {
+    int n = 0;
+    for (char **env = environ; env && *env && n < MAX_SPAWN_ENV - 2; env++) {
+        if (strncmp(*env, "NOTIFY_SOCKET=", 14) == 0) continue;
+        spawn_env[n++] = *env;
+    }
+    spawn_env[n++] = notify_env;
+    spawn_env[n] = NULL;
+}
+
+// Must run before any other thread is created: SIGCHLD is blocked here and
+// delivered through a signalfd, and threads inherit the blocked mask.
+int init_process_manager() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) != 0) return -1;
+
+    signal_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    if (signal_fd < 0) {
+        log_error("Process manager: signalfd: %s", strerror(errno));
+        return -1;
+    }
+
+    notify_fd = open_notify_socket();
+    if (notify_fd < 0) {
+        log_error("Process manager: notify socket: %s", strerror(errno));
+    }
+
+    event_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (event_fd < 0) {
+        log_error("Process manager: epoll: %s", strerror(errno));
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN };
+    ev.data.fd = signal_fd;
+    epoll_ctl(event_fd, EPOLL_CTL_ADD, signal_fd, &ev);
+    if (notify_fd >= 0) {
+        ev.data.fd = notify_fd;
+        epoll_ctl(event_fd, EPOLL_CTL_ADD, notify_fd, &ev);
+    }
+
+    build_spawn_env();
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    max_parallel_starts = cores > 0 ? (int)cores : 1;
+
+    log_info("Process manager initialized (%d parallel starts)", max_parallel_starts);
+    return 0;
+}
+
+int process_manager_event_fd() {
+    return event_fd;
+}
+
+static int open_listen_socket(const char *spec) {
+    int type = SOCK_STREAM;
+    if (strncmp(spec, "dgram:", 6) == 0) {
+        type = SOCK_DGRAM;
+        spec += 6;
+    }
+
+    int fd;
+    if (strncmp(spec, "tcp:", 4) == 0) {
+        int port = atoi(spec + 4);
+        if (type != SOCK_STREAM || port <= 0 || port > 65535) return -1;
+
+        fd = socket(AF_INET6, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+        int one = 1, zero = 0;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+
+        struct sockaddr_in6 addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr = in6addr_any;
+        addr.sin6_port = htons((uint16_t)port);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            close(fd);
+            return -1;
+        }
+    } else {
+        size_t path_len = strlen(spec);
+        struct sockaddr_un addr;
+        if (path_len == 0 || path_len >= sizeof(addr.sun_path)) return -1;
+
+        fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+        if (fd < 0) return -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, spec, path_len);
+        if (spec[0] == '@') {
+            addr.sun_path[0] = '\0';
+        } else {
+            unlink(spec);   // Stale socket from a previous boot
+        }
+        socklen_t len = offsetof(struct sockaddr_un, sun_path) + path_len;
+        if (bind(fd, (struct sockaddr *)&addr, len) < 0) {
+            close(fd);
+            return -1;
+        }
+    }
+
+    if (type == SOCK_STREAM && listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    if (fd < LISTEN_FD_FLOOR) {
+        int high = fcntl(fd, F_DUPFD_CLOEXEC, LISTEN_FD_FLOOR);
+        close(fd);
+        fd = high;
+    }
+    return fd;
+}
+
+// Bind the process's listeners once; later starts reuse them
+static int ensure_listen_sockets(ManagedProcess *proc) {
+    const ProcessEntry *entry = &proc->entry;
+    if (proc->num_listen_fds > 0 || entry->num_sockets <= 0) return 0;
+
+    int count = entry->num_sockets < MAX_PROCESS_SOCKETS ? entry->num_sockets : MAX_PROCESS_SOCKETS;
+    for (int i = 0; i < count; i++) {
+        int fd = open_listen_socket(entry->sockets[i]);
+        if (fd < 0) {
+            log_error("Cannot create socket %s for %s: %s",
+                      entry->sockets[i], entry->name, strerror(errno));
+            while (--i >= 0) close(proc->listen_fds[i]);
+            return -1;
+        }
+        proc->listen_fds[i] = fd;
+    }
+    proc->num_listen_fds = count;
+    return 0;
+}
+
+static char *format_uint(char *out, unsigned long value) {
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    while (n) *out++ = digits[--n];
+    *out = '\0';
+    return out;
+}
+
+// LISTEN_PID must name the service itself, which is only known in the child,
+// so socket-activated processes are started with vfork() rather than
+// posix_spawn(). The child shares the parent's memory until execve and
+// only makes async-signal-safe calls.
+static pid_t spawn_with_listeners(ManagedProcess *proc, const char *path, char **argv, int *err) {
+    char listen_fds[32] = "LISTEN_FDS=";
+    char listen_pid[32] = "LISTEN_PID=";
+    char listen_names[16 + MAX_PROCESS_SOCKETS * MAX_PROCESS_NAME] = "LISTEN_FDNAMES=";
+    char *envp[MAX_SPAWN_ENV + 3];
+
+    format_uint(listen_fds + strlen(listen_fds), (unsigned long)proc->num_listen_fds);
+    size_t used = strlen(listen_names);
+    for (int i = 0; i < proc->num_listen_fds; i++) {
+        used += (size_t)snprintf(listen_names + used, sizeof(listen_names) - used, "%s%s",
+                                 i ? ":" : "", proc->entry.name);
+    }
+
+    int n = 0;
+    for (char **env = spawn_env; *env; env++) {
+        if (strncmp(*env, "LISTEN_", 7) != 0) envp[n++] = *env;
+    }
+    envp[n++] = listen_fds;
+    envp[n++] = listen_pid;
+    envp[n++] = listen_names;
+    envp[n] = NULL;
+
+    sigset_t empty;
+    sigemptyset(&empty);
+    volatile int exec_errno = 0;
+
+    pid_t pid = vfork();
+    if (pid == 0) {
+        format_uint(listen_pid + 11, (unsigned long)getpid());
+        for (int i = 0; i < proc->num_listen_fds; i++) {
+            if (dup2(proc->listen_fds[i], LISTEN_FDS_START + i) < 0) {
+                exec_errno = errno;
+                _exit(127);
+            }
+        }
+        setsid();
+        sigprocmask(SIG_SETMASK, &empty, NULL);
+        execve(path, argv, envp);
+        exec_errno = errno;
+        _exit(127);
+    }
+
+    if (pid < 0) {
+        *err = errno;
+        return -1;
+    }
+    if (exec_errno) {
+        // The child has exited; it is reaped with the other children
+        *err = exec_errno;
+        return -1;
+    }
+    return pid;
+}
+
+static int spawn_plain(const char *path, char **argv, pid_t *pid) {
+    // The child starts with no blocked signals and default dispositions
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t empty, defaults;
+    sigemptyset(&empty);
+    sigfillset(&defaults);
+    posix_spawnattr_setsigmask(&attr, &empty);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+    posix_spawnattr_setflags(&attr, flags);
+
+    int err = posix_spawn(pid, path, NULL, &attr, argv, spawn_env);
+    posix_spawnattr_destroy(&attr);
+    return err;
+}
+
+static int spawn_process(ManagedProcess *proc) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", SERVICE_EXEC_DIR, proc->entry.name);
+    char *argv[] = { path, NULL };
+
+    pid_t pid = -1;
+    int err = 0;
+    if (proc->num_listen_fds > 0) {
+        pid = spawn_with_listeners(proc, path, argv, &err);
+    } else {
+        err = spawn_plain(path, argv, &pid);
+    }
+
+    if (err != 0) {
+        log_error("Failed to start %s: %s", proc->entry.name, strerror(err));
+        proc->pid = 0;
+        proc->status = PROCESS_FAILED;
+        proc->transition_ns = monotonic_ns();
+        proc->start_failures++;
+        return -1;
+    }
+
+    proc->pid = pid;
+    proc->status = PROCESS_STARTING;
+    proc->priority = 0;
+    proc->transition_ns = monotonic_ns();
+    proc->priority_changed_ns = 0;
+    boot_trace_process(managed_id(proc), BOOT_EVENT_SPAWN);
+    log_info("Started process %s (pid %d)", proc->entry.name, (int)pid);
+    return 0;
+}
+
+// Boot graph
+
+static void push_ready(int node) {
+    boot_trace_process(managed_id(boot_nodes[node].proc), BOOT_EVENT_QUEUED);
+    boot_ready[num_boot_ready++] = node;
+}
+
+// Longest remaining chain first. The queue holds at most a few hundred
+// entries, so a linear scan is cheaper than maintaining a heap.
+static int pop_ready() {
+    int best = 0;
+    for (int i = 1; i < num_boot_ready; i++) {
+        if (boot_nodes[boot_ready[i]].critical_path > boot_nodes[boot_ready[best]].critical_path) best = i;
+    }
+    int node = boot_ready[best];
+    boot_ready[best] = boot_ready[--num_boot_ready];
+    return node;
+}
+
+static void settle_node(BootNode *node, ProcessStatus status) {
+    if (node->settled) return;
+    node->settled = 1;
+    boot_remaining--;
+    if (node->deadline_ns) {
+        node->deadline_ns = 0;
+        boot_starting--;
+    }
+    node->proc->status = status;
+
+    int satisfied = status == PROCESS_READY || status == PROCESS_EXITED;
+    if (!satisfied) {
+        log_error("Boot: %s %s", node->entry->name, status_names[status]);
+    }
+    boot_trace_process(managed_id(node->proc), satisfied ? BOOT_EVENT_READY : BOOT_EVENT_FAILED);
+
+    for (int i = 0; i < node->num_dependents; i++) {
+        BootNode *dependent = &boot_nodes[boot_edges[node->first_dependent + i]];
+        if (dependent->settled) continue;
+        if (!satisfied) {
+            settle_node(dependent, PROCESS_SKIPPED);
+        } else if (--dependent->pending_deps == 0) {
+            // The last dependency to settle is the one the dependent waited on
+            boot_trace_released_by(managed_id(dependent->proc), managed_id(node->proc));
+            push_ready((int)(dependent - boot_nodes));
+        }
+    }
+}
+
+static int add_edge(int *from, int *to, int *num_edges, int dep, int node) {
+    if (*num_edges == MAX_BOOT_EDGES) return -1;
+    from[*num_edges] = dep;
+    to[*num_edges] = node;
+    (*num_edges)++;
+    return 0;
+}
+
+static int build_boot_graph(ProcessGroup *groups) {
+    static int node_group[MAX_MANAGED_PROCESSES];
+    static int edge_from[MAX_BOOT_EDGES], edge_to[MAX_BOOT_EDGES];
+    int num_edges = 0;
+
+    num_boot_nodes = 0;
+    num_boot_ready = 0;
+    boot_starting = 0;
+
+    for (int g = 0; groups[g].num_processes > 0; g++) {
+        for (int p = 0; p < groups[g].num_processes; p++) {
+            ManagedProcess *proc = get_managed(groups[g].processes[p]);
+            if (!proc || proc->boot_node) continue;
+
+            BootNode *node = &boot_nodes[num_boot_nodes];
+            memset(node, 0, sizeof(*node));
+            node->entry = &proc->entry;
+            node->proc = proc;
+            proc->boot_node = node;
+            ensure_listen_sockets(proc);
+            node_group[num_boot_nodes++] = g;
+        }
+    }
+
+    // Implicit edges from the latest completion barrier
+    int barrier_start = -1, barrier_end = -1;
+    for (int i = 0; i < num_boot_nodes; ) {
+        int g = node_group[i];
+        int end = i;
+        while (end < num_boot_nodes && node_group[end] == g) end++;
+
+        for (int n = i; n < end && barrier_start >= 0; n++) {
+            for (int b = barrier_start; b < barrier_end; b++) {
+                if (boot_nodes[b].proc->num_listen_fds > 0) continue;
+                if (add_edge(edge_from, edge_to, &num_edges, b, n) < 0) return -1;
+            }
+        }
+        if (groups[g].wait_for_completion) {
+            barrier_start = i;
+            barrier_end = end;
+        }
+        i = end;
+    }
+
+    // Explicit dependencies. One that is not part of this boot is satisfied
+    // if the process is already running.
+    for (int n = 0; n < num_boot_nodes; n++) {
+        ProcessEntry *entry = boot_nodes[n].entry;
+        for (int d = 0; d < entry->num_dependencies; d++) {
+            ManagedProcess *provider = get_managed(entry->dependencies[d]);
+            if (!provider || !provider->boot_node) {
+                if (!provider || !process_running(provider)) {
+                    log_error("Boot: %s depends on %s, which is neither booting nor running",
+                              entry->name, process_name(entry->dependencies[d]));
+                }
+                continue;
+            }
+            int dep = (int)(provider->boot_node - boot_nodes);
+            if (dep == n || boot_nodes[dep].proc->num_listen_fds > 0) continue;
+            if (add_edge(edge_from, edge_to, &num_edges, dep, n) < 0) return -1;
+        }
+    }
+
+    // Dependents grouped per node (CSR)
+    for (int e = 0; e < num_edges; e++) {
+        boot_nodes[edge_from[e]].num_dependents++;
+        boot_nodes[edge_to[e]].pending_deps++;
+    }
+    int offset = 0;
+    for (int n = 0; n < num_boot_nodes; n++) {
+        boot_nodes[n].first_dependent = offset;
+        offset += boot_nodes[n].num_dependents;
+        boot_nodes[n].num_dependents = 0;
+    }
+    for (int e = 0; e < num_edges; e++) {
+        BootNode *node = &boot_nodes[edge_from[e]];
+        boot_edges[node->first_dependent + node->num_dependents++] = edge_to[e];
+    }
+
+    return 0;
+}
+
+// Topological order (Kahn) to compute critical path lengths. Processes left
+// out of the order sit on a dependency cycle, or behind one, and fail.
+static void order_boot_graph() {
+    static int order[MAX_MANAGED_PROCESSES];
+    static int indegree[MAX_MANAGED_PROCESSES];
+    int head = 0, tail = 0;
+
+    for (int n = 0; n < num_boot_nodes; n++) {
+        indegree[n] = boot_nodes[n].pending_deps;
+        if (indegree[n] == 0) order[tail++] = n;
+    }
+    while (head < tail) {
+        BootNode *node = &boot_nodes[order[head++]];
+        for (int i = 0; i < node->num_dependents; i++) {
+            int dependent = boot_edges[node->first_dependent + i];
+            if (--indegree[dependent] == 0) order[tail++] = dependent;
+        }
+    }
+
+    for (int i = tail - 1; i >= 0; i--) {
+        BootNode *node = &boot_nodes[order[i]];
+        int longest = 0;
+        for (int d = 0; d < node->num_dependents; d++) {
+            int path = boot_nodes[boot_edges[node->first_dependent + d]].critical_path;
+            if (path > longest) longest = path;
+        }
+        node->critical_path = longest + 1;
+    }
+
+    boot_remaining = num_boot_nodes;
+    for (int n = 0; n < num_boot_nodes; n++) {
+        if (indegree[n] > 0 && !boot_nodes[n].settled) {
+            log_error("Boot: dependency cycle involving %s", boot_nodes[n].entry->name);
+            settle_node(&boot_nodes[n], PROCESS_FAILED);
+        }
+    }
+    for (int n = 0; n < num_boot_nodes; n++) {
+        if (!boot_nodes[n].settled && boot_nodes[n].pending_deps == 0) push_ready(n);
+    }
+}
+
+static void launch_ready_nodes() {
+    while (num_boot_ready > 0 && boot_starting < max_parallel_starts) {
+        BootNode *node = &boot_nodes[pop_ready()];
+
+        // Already running from an earlier sequence: only wait for readiness
+        if (node->proc->status == PROCESS_READY && node->proc->pid > 0) {
+            settle_node(node, PROCESS_READY);
+            continue;
+        }
+        if (node->proc->status != PROCESS_STARTING || node->proc->pid <= 0) {
+            if (spawn_process(node->proc) < 0) {
+                settle_node(node, PROCESS_FAILED);
+                continue;
+            }
+            if (!node->entry->notify_ready || notify_fd < 0) {
+                settle_node(node, PROCESS_READY);
+                continue;
+            }
+        }
+        node->deadline_ns = monotonic_ns() + (uint64_t)PROCESS_READY_TIMEOUT_MS * 1000000ull;
+        boot_starting++;
+    }
+}
+
+static void expire_starting_nodes() {
+    uint64_t now = monotonic_ns();
+    for (int n = 0; n < num_boot_nodes; n++) {
+        BootNode *node = &boot_nodes[n];
+        if (node->settled || node->proc->status != PROCESS_STARTING || !node->deadline_ns) continue;
+        if (now < node->deadline_ns) continue;
+
+        log_error("Boot: %s did not report readiness in %d ms",
+                  node->entry->name, PROCESS_READY_TIMEOUT_MS);
+        kill(node->proc->pid, SIGTERM);
+        settle_node(node, PROCESS_FAILED);
+    }
+}
+
+static int next_boot_timeout_ms() {
+    uint64_t now = monotonic_ns();
+    uint64_t nearest = UINT64_MAX;
+    for (int n = 0; n < num_boot_nodes; n++) {
+        BootNode *node = &boot_nodes[n];
+        if (node->settled || !node->deadline_ns) continue;
+        if (node->deadline_ns < nearest) nearest = node->deadline_ns;
+    }
+    if (nearest == UINT64_MAX) return -1;
+    if (nearest <= now) return 0;
+    return (int)((nearest - now + 999999) / 1000000);
+}
+
+// Events
+
+static void process_ready(ManagedProcess *proc) {
+    if (proc->status != PROCESS_STARTING) return;
+    if (proc->boot_node && !proc->boot_node->settled) {
+        settle_node(proc->boot_node, PROCESS_READY);
+    } else {
+        proc->status = PROCESS_READY;
+    }
+}
+
+static void process_exited(ManagedProcess *proc, int wstatus) {
+    int success = WIFEXITED(wstatus) && WEXITSTATUS(wstatus) == 0;
+    ProcessStatus status = success ? PROCESS_EXITED : PROCESS_FAILED;
+
+    if (proc->boot_node && !proc->boot_node->settled) {
+        settle_node(proc->boot_node, status);
+    } else {
+        proc->status = status;
+    }
+    proc->pid = 0;
+    sched_policy_forget(managed_id(proc));
+
+    // Failing within the dwell of its start is a failed start, which backs
+    // off the next one; a process that ran longer starts with a clean slate
+    uint64_t now = monotonic_ns();
+    if (!success && now < proc->transition_ns + (uint64_t)ADJUST_MIN_DWELL_MS * 1000000ull) {
+        proc->start_failures++;
+        proc->transition_ns = now;
+    } else {
+        proc->start_failures = 0;
+    }
+
+    if (!success && proc->entry.essential) {
+        log_error("Essential process %s exited (status 0x%x)", proc->entry.name, wstatus);
+    }
+}
+
+// A datagram per notification, newline-separated assignments; the sender is
+// identified by its kernel-supplied credentials.
+static void drain_notify_socket() {
+    char buf[512];
+    union {
+        struct cmsghdr align;
+        char data[CMSG_SPACE(sizeof(struct ucred))];
+    } control;
+
+    for (;;) {
+        struct iovec iov = { buf, sizeof(buf) - 1 };
+        struct msghdr msg = {
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.data,
+            .msg_controllen = sizeof(control.data),
+        };
+        ssize_t len = recvmsg(notify_fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+        if (len < 0) break;
+        buf[len] = '\0';
+
+        struct ucred *cred = NULL;
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_CREDENTIALS) {
+                cred = (struct ucred *)CMSG_DATA(c);
+            }
+        }
+        if (!cred) continue;
+
+        ManagedProcess *proc = find_managed_pid(cred->pid);
+        if (!proc) continue;
+
+        for (char *line = buf; line && *line; ) {
+            char *next = strchr(line, '\n');
+            if (next) *next++ = '\0';
+            if (strcmp(line, "READY=1") == 0) process_ready(proc);
+            if (strcmp(line, "WATCHDOG=1") == 0) boot_trace_process(managed_id(proc), BOOT_EVENT_HEARTBEAT);
+            line = next;
+        }
+    }
+}
+
+// As PID 1 this also reaps orphans that are not managed processes
+static void reap_children() {
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        // SIGCHLD coalesces; the waitpid loop below finds every child
+    }
+
+    int wstatus;
+    pid_t pid;
+    while ((pid = waitpid(-1, &wstatus, WNOHANG)) > 0) {
+        ManagedProcess *proc = find_managed_pid(pid);
+        if (proc) process_exited(proc, wstatus);
+    }
+}
+
+void handle_process_events() {
+    if (notify_fd >= 0) drain_notify_socket();
+    reap_children();
+}
+
+int start_process_groups(ProcessGroup *groups) {
+    if (event_fd < 0) return -1;
+
+    if (build_boot_graph(groups) < 0) {
+        log_error("Boot: dependency graph too large");
+        for (int n = 0; n < num_boot_nodes; n++) boot_nodes[n].proc->boot_node = NULL;
+        num_boot_nodes = 0;
+        return -1;
+    }
+    order_boot_graph();
+    log_info("Boot: %d processes", num_boot_nodes);
+
+    struct epoll_event events[2];
+    while (boot_remaining > 0) {
+        launch_ready_nodes();
+        if (boot_remaining == 0) break;
+        if (boot_starting == 0 && num_boot_ready == 0) break;
+
+        int n = epoll_wait(event_fd, events, 2, next_boot_timeout_ms());
+        if (n < 0 && errno != EINTR) {
+            log_error("Boot: epoll_wait: %s", strerror(errno));
+            break;
+        }
+        handle_process_events();
+        expire_starting_nodes();
+    }
+
+    int result = 0;
+    for (int n = 0; n < num_boot_nodes; n++) {
+        BootNode *node = &boot_nodes[n];
+        if (!node->settled) settle_node(node, PROCESS_SKIPPED);
+        if (node->entry->essential && node->proc->status != PROCESS_READY &&
+            node->proc->status != PROCESS_EXITED) {
+            result = -1;
+        }
+        node->proc->boot_node = NULL;
+    }
+    num_boot_nodes = 0;
+
+    return result;
+}
+
+void free_process_groups(ProcessGroup *groups) {
+    if (!groups) return;
+    for (int g = 0; groups[g].num_processes > 0; g++) {
+        free(groups[g].processes);
+    }
+    free(groups);
+}
+
+// Each adjustment is compared with what is already in effect, and dropped
+// if it is a no-op or would undo a recent change. A noisy model then costs
+// a comparison, not a restart or a renice. Returns 1 if it was carried out.
+static int reconcile_adjustment(ManagedProcess *proc, const ProcessAdjustment *adj, uint64_t now) {
+    int running = process_running(proc);
+    uint64_t dwell_ms = ADJUST_MIN_DWELL_MS;
+    for (int i = 0; i < proc->start_failures && dwell_ms < ADJUST_MAX_BACKOFF_MS; i++) dwell_ms *= 2;
+    if (dwell_ms > ADJUST_MAX_BACKOFF_MS) dwell_ms = ADJUST_MAX_BACKOFF_MS;
+    int dwelling = proc->transition_ns && now < proc->transition_ns + dwell_ms * 1000000ull;
+
+    switch (adj->action) {
+        case ACTION_START:
+            if (running || dwelling) return 0;
+            ensure_listen_sockets(proc);
+            if (spawn_process(proc) < 0) return 0;
+            if (!proc->entry.notify_ready) proc->status = PROCESS_READY;
+            return 1;
+
+        case ACTION_STOP:
+            if (!running || dwelling) return 0;
+            kill(proc->pid, SIGTERM);
+            proc->transition_ns = now;
+            return 1;
+
+        case ACTION_ADJUST_PRIORITY: {
+            if (!running) return 0;
+            // A map write costs nothing like a renice, so the sched_ext
+            // parameters follow every adjustment
+            sched_policy_set(managed_id(proc), proc->pid, adj->priority);
+            int delta = adj->priority - proc->priority;
+            if (delta < 0) delta = -delta;
+            if (delta < PRIORITY_HYSTERESIS) return 0;
+            if (proc->priority_changed_ns &&
+                now < proc->priority_changed_ns + (uint64_t)PRIORITY_MIN_DWELL_MS * 1000000ull) {
+                return 0;
+            }
+            if (setpriority(PRIO_PROCESS, proc->pid, adj->priority) < 0) {
+                log_error("Failed to set priority of %s: %s", proc->entry.name, strerror(errno));
+                return 0;
+            }
+            proc->priority = adj->priority;
+            proc->priority_changed_ns = now;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int apply_process_adjustments(ProcessAdjustments *adjustments) {
+    if (!adjustments) return 0;
+
+    uint64_t now = monotonic_ns();
+    int applied = 0;
+    for (int i = 0; i < adjustments->num_adjustments; i++) {
+        ProcessAdjustment *adj = &adjustments->adjustments[i];
+        ManagedProcess *proc = get_managed(adj->process);
+        if (!proc) continue;
+        applied += reconcile_adjustment(proc, adj, now);
+    }
+    sched_policy_flush();
+
+    if (applied > 0) {
+        log_debug("Process adjustments: %d applied, %d suppressed", applied,
+                  adjustments->num_adjustments - applied);
+    }
+    latency_record(LATENCY_PROCESS_ADJUST, now);
+    return applied;
+}
+
+pid_t get_process_pid(ProcessId id) {
+    ManagedProcess *proc = get_managed(id);
+    return proc && process_running(proc) ? proc->pid : 0;
+}
+
+void update_process_view(ProcessTableView *view) {
+    if (view->num_processes > num_managed) view->num_processes = 0;
+    for (int i = view->num_processes; i < num_managed; i++) {
+        memcpy(view->names[i], managed[i].entry.name, MAX_PROCESS_NAME);
+    }
+    view->num_processes = num_managed;
+
+    for (int i = 0; i < num_managed; i++) {
+        view->pids[i] = process_running(&managed[i]) ? managed[i].pid : 0;
+        view->essential[i] = (unsigned char)(managed[i].entry.essential != 0);
+    }
+}
+
+ProcessStatus get_process_status(ProcessId id) {
+    ManagedProcess *proc = get_managed(id);
+    return proc ? proc->status : PROCESS_PENDING;
+}
+
+// Process table snapshot (see restart_snapshot.h). Only what outlives the
+// image is kept: boot nodes exist only while start_process_groups() runs.
+typedef struct {
+    ProcessEntry entry;
+    int32_t pid;
+    int32_t status;
+    int32_t priority;
+    int32_t num_listen_fds;
+    int32_t listen_fds[MAX_PROCESS_SOCKETS];
+    uint64_t transition_ns;
+    uint64_t priority_changed_ns;
+} ProcessSnapshot;
+
+typedef struct {
+    uint32_t num_processes;
+    uint32_t record_size;
+} ProcessTableSnapshot;
+
+size_t process_table_snapshot_size() {
+    return sizeof(ProcessTableSnapshot) + (size_t)num_managed * sizeof(ProcessSnapshot);
+}
+
+void snapshot_process_table(void *buf) {
+    ProcessTableSnapshot *table = buf;
+    ProcessSnapshot *records = (ProcessSnapshot *)(table + 1);
+    table->num_processes = (uint32_t)num_managed;
+    table->record_size = sizeof(ProcessSnapshot);
+
+    for (int i = 0; i < num_managed; i++) {
+        const ManagedProcess *proc = &managed[i];
+        ProcessSnapshot *record = &records[i];
+        memset(record, 0, sizeof(*record));
+        record->entry = proc->entry;
+        record->pid = proc->pid;
+        record->status = proc->status;
+        record->priority = proc->priority;
+        record->num_listen_fds = proc->num_listen_fds;
+        for (int s = 0; s < proc->num_listen_fds; s++) record->listen_fds[s] = proc->listen_fds[s];
+        record->transition_ns = proc->transition_ns;
+        record->priority_changed_ns = proc->priority_changed_ns;
+    }
+}
+
+// Keep the listeners open across execve (inherited != 0), or close them
+// on exec again
+void set_listen_fds_inherited(int inherited) {
+    for (int i = 0; i < num_managed; i++) {
+        for (int s = 0; s < managed[i].num_listen_fds; s++) {
+            fcntl(managed[i].listen_fds[s], F_SETFD, inherited ? 0 : FD_CLOEXEC);
+        }
+    }
+}
+
+// Must run before any process is interned. The services keep running
+// across the exec and stay children of ai_init; those that exited in
+// between are reaped by the next handle_process_events().
+int restore_process_table(const void *buf, size_t size) {
+    const ProcessTableSnapshot *table = buf;
+    if (num_managed > 0 || size < sizeof(*table) || table->record_size != sizeof(ProcessSnapshot) ||
+        table->num_processes > MAX_MANAGED_PROCESSES ||
+        size != sizeof(*table) + (size_t)table->num_processes * sizeof(ProcessSnapshot)) {
+        return -1;
+    }
+
+    const ProcessSnapshot *records = (const ProcessSnapshot *)(table + 1);
+    for (uint32_t i = 0; i < table->num_processes; i++) {
+        const ProcessSnapshot *record = &records[i];
+        if (memchr(record->entry.name, '\0', MAX_PROCESS_NAME) == NULL ||
+            record->num_listen_fds < 0 || record->num_listen_fds > MAX_PROCESS_SOCKETS ||
+            intern_process(record->entry.name) != (ProcessId)i) {
+            log_error("Process table snapshot: bad entry %u", i);
+            memset(name_index, 0, sizeof(name_index));
+            num_managed = 0;
+            return -1;
+        }
+
+        ManagedProcess *proc = &managed[i];
+        proc->entry = record->entry;
+        proc->pid = record->pid;
+        proc->status = (ProcessStatus)record->status;
+        proc->priority = record->priority;
+        proc->num_listen_fds = record->num_listen_fds;
+        for (int s = 0; s < record->num_listen_fds; s++) {
+            proc->listen_fds[s] = record->listen_fds[s];
+            fcntl(proc->listen_fds[s], F_SETFD, FD_CLOEXEC);
+        }
+        proc->transition_ns = record->transition_ns;
+        proc->priority_changed_ns = record->priority_changed_ns;
+    }
+
+    log_info("Process table restored (%d processes)", num_managed);
+    return 0;
+}
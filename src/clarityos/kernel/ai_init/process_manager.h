@@ -0,0 +1,129 @@
+#ifndef PROCESS_MANAGER_H
+#define PROCESS_MANAGER_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// Limits of the process manager
+#define MAX_PROCESS_NAME 64
+#define MAX_PROCESS_DEPENDENCIES 16
+#define MAX_PROCESS_SOCKETS 4
+#define MAX_SOCKET_SPEC 108
+#define MAX_MANAGED_PROCESSES 256
+
+// Directory holding service executables (<dir>/<process name>)
+#ifndef SERVICE_EXEC_DIR
+#define SERVICE_EXEC_DIR "/usr/libexec/clarityos"
+#endif
+
+// Abstract AF_UNIX datagram socket services report readiness on
+// (sd_notify protocol: NOTIFY_SOCKET=@ai_init/notify, message "READY=1")
+#define NOTIFY_SOCKET_NAME "ai_init/notify"
+
+// Socket activation: listeners ai_init binds on behalf of a service and passes
+// on exec as fds 3.. (LISTEN_FDS/LISTEN_PID/LISTEN_FDNAMES protocol). Spec:
+//   "/path" or "@name"     AF_UNIX stream (@ = abstract namespace)
+//   "dgram:/path"          AF_UNIX datagram, e.g. "dgram:/dev/log"
+//   "tcp:port"             TCP on all IPv4 and IPv6 addresses
+#define LISTEN_FDS_START 3
+
+// Time a notify-type service may take to report readiness during boot
+#define PROCESS_READY_TIMEOUT_MS 30000
+
+// Reconciliation of process adjustments against the applied state:
+// a process is not started or stopped again within ADJUST_MIN_DWELL_MS of
+// its last start or stop, and its nice value changes only by at least
+// PRIORITY_HYSTERESIS and at most once per PRIORITY_MIN_DWELL_MS. A spawn
+// that fails, or a process that fails within the dwell of its start, counts
+// as a failed start; each consecutive one doubles the dwell, up to
+// ADJUST_MAX_BACKOFF_MS, so a missing binary is not retried every tick.
+#define ADJUST_MIN_DWELL_MS 30000
+#define ADJUST_MAX_BACKOFF_MS 600000
+#define PRIORITY_HYSTERESIS 2
+#define PRIORITY_MIN_DWELL_MS 30000
+
+// Index of a process in the process table (see intern_process())
+typedef int ProcessId;
+#define PROCESS_ID_NONE (-1)
+
+// Process description, stored in the process table
+typedef struct {
+    char name[MAX_PROCESS_NAME];
+    int essential;              // Boot fails if this process cannot start
+    int notify_ready;           // Dependents wait for READY=1, not just the spawn
+    int num_dependencies;
+    ProcessId dependencies[MAX_PROCESS_DEPENDENCIES];
+    int num_sockets;
+    char sockets[MAX_PROCESS_SOCKETS][MAX_SOCKET_SPEC];
+} ProcessEntry;
+
+// Group of processes in a boot sequence. Every process in a group with
+// wait_for_completion set must be ready before any process in a later group
+// starts; other ordering comes only from explicit dependencies.
+typedef struct {
+    ProcessId *processes;
+    int num_processes;
+    int wait_for_completion;
+} ProcessGroup;
+
+typedef enum {
+    ACTION_START,
+    ACTION_STOP,
+    ACTION_ADJUST_PRIORITY
+} ProcessAction;
+
+typedef struct {
+    ProcessId process;
+    ProcessAction action;
+    int priority;               // Nice value for ACTION_ADJUST_PRIORITY
+} ProcessAdjustment;
+
+typedef struct {
+    ProcessAdjustment *adjustments;
+    int num_adjustments;
+} ProcessAdjustments;
+
+// Copy of the process table for other threads, which must not read the
+// table itself: the decision loop refreshes a view with
+// update_process_view() and hands it over. Names never change once
+// interned, so a view refreshed again only copies those added since.
+typedef struct {
+    int num_processes;
+    pid_t pids[MAX_MANAGED_PROCESSES];          // 0 unless running
+    unsigned char essential[MAX_MANAGED_PROCESSES];
+    char names[MAX_MANAGED_PROCESSES][MAX_PROCESS_NAME];
+} ProcessTableView;
+
+// Lifecycle of a managed process
+typedef enum {
+    PROCESS_PENDING,            // Waiting for dependencies
+    PROCESS_STARTING,           // Spawned, readiness not yet reported
+    PROCESS_READY,
+    PROCESS_EXITED,
+    PROCESS_FAILED,
+    PROCESS_SKIPPED             // A dependency failed
+} ProcessStatus;
+
+// Function prototypes
+int init_process_manager();
+ProcessId intern_process(const char *name);
+ProcessId find_process(const char *name);
+ProcessEntry *get_process_entry(ProcessId id);
+const char *process_name(ProcessId id);
+int process_table_size();
+int start_process_groups(ProcessGroup *groups);
+void free_process_groups(ProcessGroup *groups);
+int apply_process_adjustments(ProcessAdjustments *adjustments);
+void handle_process_events();
+int process_manager_event_fd();
+pid_t get_process_pid(ProcessId id);
+ProcessStatus get_process_status(ProcessId id);
+void update_process_view(ProcessTableView *view);
+
+// Re-exec (see restart_snapshot.h)
+size_t process_table_snapshot_size();
+void snapshot_process_table(void *buf);
+void set_listen_fds_inherited(int inherited);
+int restore_process_table(const void *buf, size_t size);
+
+#endif /* PROCESS_MANAGER_H */
@@ -0,0 +1,773 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/netlink.h>
+#include <linux/genetlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <linux/taskstats.h>
+#include "process_telemetry.h"
+#include "resource_governor.h"
+#include "cpu_topology.h"
+#include "init_log.h"
+
+#define TABLE_SLOTS (TELEMETRY_MAX_PROCESSES * 2)     // Power of two, at most half full
+#define CONNECTOR_BUF_SIZE 16384
+#define CONNECTOR_RCVBUF (4 << 20)                  // Fork storms between two drains
+#define GENL_BUF_SIZE 4096
+#define GENL_TIMEOUT_MS 100
+#define CGROUP_STAT_BUF_SIZE 4096
+
+// One tracked process. Collector thread only, except through the seqlock.
+typedef struct {
+    pid_t pid;                  // 0 if the slot is empty
+    int pidfd;                  // -1 if pidfd_open failed (fd limit, kernel before 5.3)
+    uint64_t coremem;           // Main thread's taskstats coremem and CPU time at the last
+    uint64_t main_cpu_us;       //   sample, to average RSS over the interval
+    ProcessTelemetry telemetry;
+} TelemetrySlot;
+
+// Open addressing with linear probing; removal shifts later entries back,
+// so there are no tombstones. Readers on other threads copy entries out
+// under a sequence counter (odd while the table is being changed), the
+// same seqlock scheme as the published SystemState.
+static TelemetrySlot table[TABLE_SLOTS];
+static _Atomic unsigned int table_seq;
+static atomic_int num_tracked;
+static unsigned int refresh_cursor = 0;
+
+// Collector thread only
+typedef struct {
+    int dir_fd;
+    int cpu_stat_fd;
+    int io_stat_fd;
+    ServiceTelemetry telemetry;
+} ServiceCounters;
+
+static ServiceCounters services[MAX_MANAGED_PROCESSES];
+
+// Services as last published by the decision loop, and the collector's
+// copy for the current pass
+static pthread_mutex_t published_lock = PTHREAD_MUTEX_INITIALIZER;
+static ProcessTableView published_services;
+static ProcessTableView service_view;
+
+// Sum of the last pass, under its own sequence counter
+static _Atomic unsigned int load_seq;
+static ServiceLoad service_load;
+static long long total_memory_kb = 0;
+
+static pthread_t telemetry_thread;
+static atomic_int telemetry_running = 0;
+static int stop_fd = -1;
+static int connector_fd = -1;
+static int genl_fd = -1;
+static uint16_t taskstats_family = 0;
+static uint32_t genl_seq = 0;
+static int all_processes = 0;       // Host-wide tracking (TELEMETRY_ALL_PROCESSES_ENV)
+static int warned_full = 0;
+static int warned_pidfd = 0;
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static unsigned int slot_for_pid(pid_t pid) {
+    unsigned int hash = (unsigned int)pid * 2654435761u;
+    return (hash ^ (hash >> 16)) & (TABLE_SLOTS - 1);
+}
+
+static void table_write_begin() {
+    unsigned int seq = atomic_load_explicit(&table_seq, memory_order_relaxed);
+    atomic_store_explicit(&table_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+}
+
+static void table_write_end() {
+    unsigned int seq = atomic_load_explicit(&table_seq, memory_order_relaxed);
+    atomic_store_explicit(&table_seq, seq + 1, memory_order_release);
+}
+
+static TelemetrySlot *find_slot(pid_t pid) {
+    for (unsigned int i = slot_for_pid(pid), probes = 0; probes < TABLE_SLOTS;
+         i = (i + 1) & (TABLE_SLOTS - 1), probes++) {
+        if (table[i].pid == pid) return &table[i];
+        if (table[i].pid == 0) return NULL;
+    }
+    return NULL;
+}
+
+static int open_pidfd(pid_t pid) {
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd < 0 && errno != ESRCH && !warned_pidfd) {
+        int saved_errno = errno;
+        log_warn("Process telemetry: pidfd_open: %s; pid reuse is detected from counters only",
+                 strerror(saved_errno));
+        warned_pidfd = 1;
+        errno = saved_errno;
+    }
+    return fd;
+}
+
+static void untrack_process(pid_t pid);
+
+// Start tracking pid. A pid already in the table exited without an event
+// reaching us and was reused: its entry starts over.
+static void track_process(pid_t pid) {
+    int pidfd = open_pidfd(pid);
+    if (pidfd < 0 && errno == ESRCH) {
+        untrack_process(pid);
+        return;
+    }
+
+    TelemetrySlot *slot = find_slot(pid);
+    if (slot) {
+        if (slot->pidfd >= 0) close(slot->pidfd);
+    } else {
+        if (atomic_load_explicit(&num_tracked, memory_order_relaxed) >= TELEMETRY_MAX_PROCESSES) {
+            if (!warned_full) {
+                log_warn("Process telemetry: more than %d processes, new ones are not tracked",
+                         TELEMETRY_MAX_PROCESSES);
+                warned_full = 1;
+            }
+            if (pidfd >= 0) close(pidfd);
+            return;
+        }
+        unsigned int i = slot_for_pid(pid);
+        while (table[i].pid != 0) i = (i + 1) & (TABLE_SLOTS - 1);
+        slot = &table[i];
+        atomic_fetch_add_explicit(&num_tracked, 1, memory_order_relaxed);
+    }
+
+    table_write_begin();
+    memset(slot, 0, sizeof(*slot));
+    slot->pid = pid;
+    slot->pidfd = pidfd;
+    slot->telemetry.pid = pid;
+    table_write_end();
+}
+
+static void untrack_process(pid_t pid) {
+    TelemetrySlot *slot = find_slot(pid);
+    if (!slot) return;
+    if (slot->pidfd >= 0) close(slot->pidfd);
+
+    table_write_begin();
+    unsigned int hole = (unsigned int)(slot - table);
+    unsigned int i = hole;
+    for (;;) {
+        i = (i + 1) & (TABLE_SLOTS - 1);
+        if (table[i].pid == 0) break;
+
+        // Move the entry into the hole unless its home slot lies
+        // cyclically in (hole, i]
+        unsigned int home = slot_for_pid(table[i].pid);
+        if (((i - home) & (TABLE_SLOTS - 1)) >= ((i - hole) & (TABLE_SLOTS - 1))) {
+            table[hole] = table[i];
+            hole = i;
+        }
+    }
+    memset(&table[hole], 0, sizeof(table[hole]));
+    table_write_end();
+    atomic_fetch_sub_explicit(&num_tracked, 1, memory_order_relaxed);
+}
+
+static int process_exited(const TelemetrySlot *slot) {
+    if (slot->pidfd < 0) return kill(slot->pid, 0) < 0 && errno == ESRCH;
+
+    // A pidfd becomes readable when its process exits
+    struct pollfd pfd = { .fd = slot->pidfd, .events = POLLIN };
+    return poll(&pfd, 1, 0) > 0;
+}
+
+// List /proc for processes not tracked yet; only the directory names are
+// read
+static void scan_proc() {
+    DIR *dir = opendir("/proc");
+    if (!dir) {
+        log_error("Process telemetry: /proc: %s", strerror(errno));
+        return;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9') continue;
+        pid_t pid = (pid_t)atoi(entry->d_name);
+        if (!find_slot(pid)) track_process(pid);
+    }
+    closedir(dir);
+}
+
+// Drop exited processes and add missed ones. Returns the number dropped.
+static int reconcile_table() {
+    int dropped = 0;
+    for (unsigned int i = 0; i < TABLE_SLOTS; ) {
+        if (table[i].pid != 0 && process_exited(&table[i])) {
+            // Removal may shift another entry into slot i
+            untrack_process(table[i].pid);
+            dropped++;
+            continue;
+        }
+        i++;
+    }
+    scan_proc();
+    return dropped;
+}
+
+// Track exactly the running main processes of the governed services
+static void sync_service_processes() {
+    for (unsigned int i = 0; i < TABLE_SLOTS; ) {
+        pid_t pid = table[i].pid;
+        int governed = 0;
+        for (int id = 0; pid != 0 && id < service_view.num_processes && !governed; id++) {
+            governed = service_view.pids[id] == pid;
+        }
+        if (pid != 0 && (!governed || process_exited(&table[i]))) {
+            // Removal may shift another entry into slot i
+            untrack_process(pid);
+            continue;
+        }
+        i++;
+    }
+
+    for (int id = 0; id < service_view.num_processes; id++) {
+        pid_t pid = service_view.pids[id];
+        if (pid > 0 && !find_slot(pid)) track_process(pid);
+    }
+}
+
+// Proc connector
+
+static int open_proc_connector() {
+    int fd = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (fd < 0) return -1;
+
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK, .nl_groups = CN_IDX_PROC };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    int rcvbuf = CONNECTOR_RCVBUF;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &rcvbuf, sizeof(rcvbuf)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    }
+
+    union {
+        struct nlmsghdr header;
+        char data[NLMSG_SPACE(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op))];
+    } msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct cn_msg) + sizeof(enum proc_cn_mcast_op));
+    msg.header.nlmsg_type = NLMSG_DONE;
+
+    struct cn_msg *cn = NLMSG_DATA(&msg.header);
+    cn->id.idx = CN_IDX_PROC;
+    cn->id.val = CN_VAL_PROC;
+    cn->len = sizeof(enum proc_cn_mcast_op);
+    enum proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    memcpy(cn->data, &op, sizeof(op));
+
+    if (send(fd, &msg, msg.header.nlmsg_len, 0) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Apply queued fork and exit events. Returns -1 if events were lost.
+static int drain_proc_connector() {
+    union {
+        struct nlmsghdr align;
+        char data[CONNECTOR_BUF_SIZE];
+    } buf;
+    int lost = 0;
+
+    for (;;) {
+        ssize_t len = recv(connector_fd, &buf, sizeof(buf), 0);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                lost = 1;
+                continue;
+            }
+            if (errno != EAGAIN && errno != EINTR) log_error("Process telemetry: connector: %s", strerror(errno));
+            break;
+        }
+
+        for (struct nlmsghdr *header = &buf.align; NLMSG_OK(header, (size_t)len); header = NLMSG_NEXT(header, len)) {
+            if (header->nlmsg_type == NLMSG_ERROR || header->nlmsg_type == NLMSG_NOOP) continue;
+
+            struct cn_msg *cn = NLMSG_DATA(header);
+            if (cn->id.idx != CN_IDX_PROC || cn->id.val != CN_VAL_PROC) continue;
+            struct proc_event *event = (struct proc_event *)cn->data;
+
+            // Only whole processes; thread creation and exit are ignored
+            if (event->what == PROC_EVENT_FORK &&
+                event->event_data.fork.child_pid == event->event_data.fork.child_tgid) {
+                track_process(event->event_data.fork.child_tgid);
+            } else if (event->what == PROC_EVENT_EXIT &&
+                       event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                untrack_process(event->event_data.exit.process_tgid);
+            }
+        }
+    }
+    return lost ? -1 : 0;
+}
+
+// Generic netlink (taskstats)
+
+static void put_attr(struct nlmsghdr *header, int type, const void *data, int len) {
+    struct nlattr *attr = (struct nlattr *)((char *)header + NLMSG_ALIGN(header->nlmsg_len));
+    attr->nla_type = (unsigned short)type;
+    attr->nla_len = (unsigned short)(NLA_HDRLEN + len);
+    memcpy((char *)attr + NLA_HDRLEN, data, (size_t)len);
+    header->nlmsg_len = NLMSG_ALIGN(header->nlmsg_len) + NLA_ALIGN(attr->nla_len);
+}
+
+// First attribute of the given type among len bytes of attributes
+static struct nlattr *find_attr(void *attrs, int len, int type) {
+    struct nlattr *attr = attrs;
+    while (len >= NLA_HDRLEN && attr->nla_len >= NLA_HDRLEN && attr->nla_len <= len) {
+        if ((attr->nla_type & NLA_TYPE_MASK) == type) return attr;
+        len -= NLA_ALIGN(attr->nla_len);
+        attr = (struct nlattr *)((char *)attr + NLA_ALIGN(attr->nla_len));
+    }
+    return NULL;
+}
+
+#define ATTR_DATA(attr) ((void *)((char *)(attr) + NLA_HDRLEN))
+#define ATTR_LEN(attr) ((int)(attr)->nla_len - NLA_HDRLEN)
+
+// Send one request and wait for its reply. On success returns the length
+// of the reply's attributes, which *attrs points to (inside reply); on
+// failure a negative errno.
+static int genl_request(uint16_t family, uint8_t cmd, uint8_t version, int attr_type, const void *data,
+                        int len, char *reply, size_t reply_size, void **attrs) {
+    union {
+        struct nlmsghdr header;
+        char data[NLMSG_SPACE(GENL_HDRLEN + NLA_HDRLEN + 32)];
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.header.nlmsg_len = NLMSG_LENGTH(GENL_HDRLEN);
+    req.header.nlmsg_type = family;
+    req.header.nlmsg_flags = NLM_F_REQUEST;
+    req.header.nlmsg_seq = ++genl_seq;
+    struct genlmsghdr *genl = NLMSG_DATA(&req.header);
+    genl->cmd = cmd;
+    genl->version = version;
+    put_attr(&req.header, attr_type, data, len);
+
+    if (send(genl_fd, &req, req.header.nlmsg_len, 0) < 0) return -errno;
+
+    for (;;) {
+        ssize_t n = recv(genl_fd, reply, reply_size, 0);
+        if (n < 0) return errno == EINTR ? -EAGAIN : -errno;
+
+        struct nlmsghdr *header = (struct nlmsghdr *)reply;
+        if (!NLMSG_OK(header, (size_t)n)) return -EPROTO;
+        if (header->nlmsg_seq != genl_seq) continue;    // Reply to a request that timed out
+        if (header->nlmsg_type == NLMSG_ERROR) {
+            struct nlmsgerr *err = NLMSG_DATA(header);
+            return err->error ? err->error : -EPROTO;
+        }
+
+        *attrs = (char *)NLMSG_DATA(header) + GENL_HDRLEN;
+        return (int)header->nlmsg_len - NLMSG_LENGTH(GENL_HDRLEN);
+    }
+}
+
+static int open_taskstats() {
+    genl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_GENERIC);
+    if (genl_fd < 0) return -1;
+
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+    struct timeval timeout = { 0, GENL_TIMEOUT_MS * 1000 };
+    if (bind(genl_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        setsockopt(genl_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        close(genl_fd);
+        genl_fd = -1;
+        return -1;
+    }
+
+    char reply[GENL_BUF_SIZE];
+    void *attrs;
+    int len = genl_request(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 1, CTRL_ATTR_FAMILY_NAME, TASKSTATS_GENL_NAME,
+                           sizeof(TASKSTATS_GENL_NAME), reply, sizeof(reply), &attrs);
+    struct nlattr *id = len > 0 ? find_attr(attrs, len, CTRL_ATTR_FAMILY_ID) : NULL;
+    if (!id) {
+        close(genl_fd);
+        genl_fd = -1;
+        return -1;
+    }
+    taskstats_family = *(uint16_t *)ATTR_DATA(id);
+    return 0;
+}
+
+// taskstats of a thread group (TASKSTATS_CMD_ATTR_TGID) or of one task
+// (TASKSTATS_CMD_ATTR_PID). Returns 0 or a negative errno: -ESRCH if the
+// process is gone.
+static int query_taskstats(int attr_type, pid_t pid, struct taskstats *stats) {
+    char reply[GENL_BUF_SIZE];
+    void *attrs;
+    uint32_t id = (uint32_t)pid;
+    int len = genl_request(taskstats_family, TASKSTATS_CMD_GET, TASKSTATS_GENL_VERSION, attr_type, &id,
+                           sizeof(id), reply, sizeof(reply), &attrs);
+    if (len < 0) return len;
+
+    int aggr_type = attr_type == TASKSTATS_CMD_ATTR_TGID ? TASKSTATS_TYPE_AGGR_TGID : TASKSTATS_TYPE_AGGR_PID;
+    struct nlattr *aggr = find_attr(attrs, len, aggr_type);
+    struct nlattr *data = aggr ? find_attr(ATTR_DATA(aggr), ATTR_LEN(aggr), TASKSTATS_TYPE_STATS) : NULL;
+    if (!data) return -EPROTO;
+
+    // Older kernels send a shorter struct
+    memset(stats, 0, sizeof(*stats));
+    size_t size = (size_t)ATTR_LEN(data) < sizeof(*stats) ? (size_t)ATTR_LEN(data) : sizeof(*stats);
+    memcpy(stats, ATTR_DATA(data), size);
+    return 0;
+}
+
+// Refresh one process. CPU time and context switches come from the
+// thread-group query, which sums all threads. The kernel does not sum
+// memory and I/O accounting per group, so those come from the main thread:
+// RSS and its peak are per address space anyway; I/O is the main thread's
+// only (the service cgroup's io.stat has the whole service).
+static void sample_process(TelemetrySlot *slot, uint64_t now) {
+    struct taskstats group, main_thread;
+    int ret = query_taskstats(TASKSTATS_CMD_ATTR_TGID, slot->pid, &group);
+    if (ret == 0) ret = query_taskstats(TASKSTATS_CMD_ATTR_PID, slot->pid, &main_thread);
+    if (ret == -ESRCH) {
+        // Exited; its exit event may still be queued
+        untrack_process(slot->pid);
+        return;
+    }
+    if (ret < 0) return;
+
+    ProcessTelemetry telemetry = slot->telemetry;
+    uint64_t cpu_ns = (group.ac_utime + group.ac_stime) * 1000ull;
+    uint64_t main_cpu_us = main_thread.ac_utime + main_thread.ac_stime;
+
+    // Counters only grow: going backwards means pid reuse the pidfd did
+    // not catch (no pidfd), so start over
+    if (cpu_ns < telemetry.cpu_ns || main_cpu_us < slot->main_cpu_us) {
+        memset(&telemetry, 0, sizeof(telemetry));
+        telemetry.pid = slot->pid;
+        slot->coremem = slot->main_cpu_us = 0;
+    }
+
+    // coremem accumulates RSS x CPU time in units of 1000 KiB x usec
+    uint64_t cpu_delta = main_cpu_us - slot->main_cpu_us;
+    if (cpu_delta > 0) telemetry.rss_kb = (main_thread.coremem - slot->coremem) * 1000ull / cpu_delta;
+
+    telemetry.cpu_ns = cpu_ns;
+    telemetry.rss_peak_kb = main_thread.hiwater_rss;
+    telemetry.read_bytes = main_thread.read_bytes;
+    telemetry.write_bytes = main_thread.write_bytes;
+    telemetry.wakeups = group.nvcsw;
+    telemetry.preemptions = group.nivcsw;
+    telemetry.updated_ns = now;
+
+    table_write_begin();
+    slot->telemetry = telemetry;
+    table_write_end();
+    slot->coremem = main_thread.coremem;
+    slot->main_cpu_us = main_cpu_us;
+}
+
+// Refresh up to TELEMETRY_QUERIES_PER_PASS processes, continuing where the
+// previous pass stopped
+static void sample_processes(uint64_t now) {
+    int budget = TELEMETRY_QUERIES_PER_PASS;
+    for (unsigned int scanned = 0; scanned < TABLE_SLOTS && budget > 0; scanned++) {
+        unsigned int i = refresh_cursor;
+        refresh_cursor = (refresh_cursor + 1) & (TABLE_SLOTS - 1);
+        if (table[i].pid == 0) continue;
+
+        sample_process(&table[i], now);
+        budget--;
+    }
+}
+
+// Cgroup counters
+
+// Value following "key" and a separator, or 0
+static uint64_t stat_field(const char *line, const char *key) {
+    const char *field = strstr(line, key);
+    return field ? strtoull(field + strlen(key), NULL, 10) : 0;
+}
+
+static ssize_t read_stat(int fd, char *buf, size_t size) {
+    ssize_t len = pread(fd, buf, size - 1, 0);
+    if (len < 0) return -1;
+    buf[len] = '\0';
+    return len;
+}
+
+static int open_service(ProcessId id, ServiceCounters *service) {
+    if (service->dir_fd >= 0) return 0;
+
+    char path[sizeof(RESOURCE_CGROUP_ROOT) + MAX_PROCESS_NAME + 1];
+    snprintf(path, sizeof(path), "%s/%s", RESOURCE_CGROUP_ROOT, service_view.names[id]);
+    service->dir_fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (service->dir_fd < 0) return -1;     // Not governed (yet)
+
+    service->cpu_stat_fd = openat(service->dir_fd, "cpu.stat", O_RDONLY | O_CLOEXEC);
+    service->io_stat_fd = openat(service->dir_fd, "io.stat", O_RDONLY | O_CLOEXEC);
+    return 0;
+}
+
+static void sample_services(uint64_t now) {
+    char buf[CGROUP_STAT_BUF_SIZE];
+    ServiceLoad load;
+    memset(&load, 0, sizeof(load));
+
+    for (ProcessId id = 0; id < service_view.num_processes; id++) {
+        ServiceCounters *service = &services[id];
+        if (open_service(id, service) < 0) continue;
+
+        ServiceTelemetry telemetry;
+        memset(&telemetry, 0, sizeof(telemetry));
+        if (service->cpu_stat_fd >= 0 && read_stat(service->cpu_stat_fd, buf, sizeof(buf)) > 0) {
+            telemetry.cpu_usage_us = stat_field(buf, "usage_usec ");
+            telemetry.cpu_throttled_us = stat_field(buf, "throttled_usec ");
+        }
+
+        // One line per device: "MAJ:MIN rbytes=N wbytes=N rios=N ..."
+        if (service->io_stat_fd >= 0 && read_stat(service->io_stat_fd, buf, sizeof(buf)) > 0) {
+            for (char *line = buf; line && *line; ) {
+                char *next = strchr(line, '\n');
+                if (next) *next++ = '\0';
+                telemetry.io_read_bytes += stat_field(line, "rbytes=");
+                telemetry.io_write_bytes += stat_field(line, "wbytes=");
+                line = next;
+            }
+        }
+        telemetry.updated_ns = now;
+
+        // Rates against the previous pass; counters that went backwards
+        // belong to a recreated group
+        const ServiceTelemetry *last = &service->telemetry;
+        double interval_us = (double)(now - last->updated_ns) / 1000.0;
+        if (last->updated_ns && interval_us > 0.0 && telemetry.cpu_usage_us >= last->cpu_usage_us &&
+            telemetry.cpu_throttled_us >= last->cpu_throttled_us &&
+            telemetry.io_read_bytes + telemetry.io_write_bytes >= last->io_read_bytes + last->io_write_bytes) {
+            float cpu = (float)((telemetry.cpu_usage_us - last->cpu_usage_us) / interval_us);
+            if (cpu > load.cpu_max) load.cpu_max = cpu;
+            load.cpu_throttled += (float)((telemetry.cpu_throttled_us - last->cpu_throttled_us) / interval_us);
+            uint64_t io = telemetry.io_read_bytes + telemetry.io_write_bytes -
+                          last->io_read_bytes - last->io_write_bytes;
+            load.io_mib_per_s += (float)(io / (double)(1 << 20) / (interval_us / 1e6));
+        }
+
+        TelemetrySlot *slot = service_view.pids[id] > 0 ? find_slot(service_view.pids[id]) : NULL;
+        if (slot && total_memory_kb > 0) {
+            float rss = (float)((double)slot->telemetry.rss_kb / (double)total_memory_kb);
+            if (rss > load.rss_max) load.rss_max = rss;
+        }
+
+        service->telemetry = telemetry;
+    }
+
+    unsigned int seq = atomic_load_explicit(&load_seq, memory_order_relaxed);
+    atomic_store_explicit(&load_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    service_load = load;
+    atomic_store_explicit(&load_seq, seq + 2, memory_order_release);
+}
+
+static void *telemetry_thread_func(void *arg) {
+    (void)arg;
+    pin_housekeeping_thread(pthread_self(), HOUSEKEEPING_WORKER);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = { .events = EPOLLIN, .data.fd = stop_fd };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stop_fd, &event);
+    if (connector_fd >= 0) {
+        event.data.fd = connector_fd;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connector_fd, &event);
+    }
+
+    uint64_t next_pass = monotonic_ns();
+    while (atomic_load(&telemetry_running)) {
+        uint64_t now = monotonic_ns();
+        int timeout = next_pass > now ? (int)((next_pass - now) / 1000000) : 0;
+
+        struct epoll_event events[2];
+        int n = epoll_wait(epoll_fd, events, 2, timeout);
+        if (n < 0 && errno != EINTR) {
+            log_error("Process telemetry: epoll_wait: %s", strerror(errno));
+            break;
+        }
+        if (!atomic_load(&telemetry_running)) break;
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == connector_fd && drain_proc_connector() < 0) {
+                int dropped = reconcile_table();
+                log_warn("Process telemetry: connector events lost, resynchronized (%d exited, %d tracked)",
+                         dropped, atomic_load(&num_tracked));
+            }
+        }
+
+        now = monotonic_ns();
+        if (now < next_pass) continue;
+
+        pthread_mutex_lock(&published_lock);
+        memcpy(&service_view, &published_services, sizeof(service_view));
+        pthread_mutex_unlock(&published_lock);
+
+        if (!all_processes) {
+            sync_service_processes();
+        } else if (connector_fd < 0) {
+            reconcile_table();
+        }
+        if (genl_fd >= 0) sample_processes(now);
+        sample_services(now);
+        next_pass = now + (uint64_t)TELEMETRY_INTERVAL_MS * 1000000ull;
+    }
+
+    close(epoll_fd);
+    return NULL;
+}
+
+// Decision loop: publish the services to collect cgroup counters for,
+// which the collector takes at its next pass
+void update_telemetry_services() {
+    pthread_mutex_lock(&published_lock);
+    update_process_view(&published_services);
+    pthread_mutex_unlock(&published_lock);
+}
+
+int start_process_telemetry() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long page_size = sysconf(_SC_PAGESIZE);
+    total_memory_kb = pages > 0 && page_size > 0 ? (long long)pages * (page_size / 1024) : 0;
+    update_telemetry_services();
+
+    memset(table, 0, sizeof(table));
+    atomic_store(&num_tracked, 0);
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        services[i].dir_fd = services[i].cpu_stat_fd = services[i].io_stat_fd = -1;
+    }
+
+    const char *setting = getenv(TELEMETRY_ALL_PROCESSES_ENV);
+    all_processes = setting && strcmp(setting, "1") == 0;
+
+    // Subscribe before listing /proc, so no process falls in between
+    if (all_processes) {
+        connector_fd = open_proc_connector();
+        if (connector_fd < 0) {
+            log_warn("Process telemetry: proc connector unavailable (%s), listing /proc every pass",
+                     strerror(errno));
+        }
+    }
+    if (open_taskstats() < 0) {
+        log_warn("Process telemetry: taskstats unavailable, cgroup counters only");
+    }
+    if (all_processes) scan_proc();
+
+    stop_fd = eventfd(0, EFD_CLOEXEC);
+    atomic_store(&telemetry_running, 1);
+    if (stop_fd < 0 || pthread_create(&telemetry_thread, NULL, telemetry_thread_func, NULL) != 0) {
+        log_error("Failed to create process telemetry thread");
+        atomic_store(&telemetry_running, 0);
+        return -1;
+    }
+
+    if (all_processes) {
+        log_info("Process telemetry started (%d processes)", atomic_load(&num_tracked));
+    } else {
+        log_info("Process telemetry started (governed services)");
+    }
+    return 0;
+}
+
+void stop_process_telemetry() {
+    if (!atomic_load(&telemetry_running)) return;
+
+    atomic_store(&telemetry_running, 0);
+    uint64_t one = 1;
+    if (write(stop_fd, &one, sizeof(one)) < 0) {
+        log_error("Process telemetry: cannot signal stop: %s", strerror(errno));
+    }
+    pthread_join(telemetry_thread, NULL);
+
+    for (unsigned int i = 0; i < TABLE_SLOTS; i++) {
+        if (table[i].pid != 0 && table[i].pidfd >= 0) close(table[i].pidfd);
+    }
+    memset(table, 0, sizeof(table));
+    atomic_store(&num_tracked, 0);
+
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        int fds[] = { services[i].cpu_stat_fd, services[i].io_stat_fd, services[i].dir_fd };
+        for (int f = 0; f < 3; f++) {
+            if (fds[f] >= 0) close(fds[f]);
+        }
+        services[i].dir_fd = services[i].cpu_stat_fd = services[i].io_stat_fd = -1;
+        memset(&services[i].telemetry, 0, sizeof(services[i].telemetry));
+    }
+
+    // Stale once the collector is gone
+    unsigned int seq = atomic_load_explicit(&load_seq, memory_order_relaxed);
+    atomic_store_explicit(&load_seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memset(&service_load, 0, sizeof(service_load));
+    atomic_store_explicit(&load_seq, seq + 2, memory_order_release);
+
+    if (connector_fd >= 0) close(connector_fd);
+    if (genl_fd >= 0) close(genl_fd);
+    close(stop_fd);
+    connector_fd = genl_fd = stop_fd = -1;
+}
+
+// Latest counters of pid. Returns 0, or -1 if it is not tracked: unless
+// host-wide tracking is on, only the services' main processes are.
+int get_process_telemetry(pid_t pid, ProcessTelemetry *telemetry) {
+    if (pid <= 0) return -1;
+
+    for (;;) {
+        unsigned int seq = atomic_load_explicit(&table_seq, memory_order_acquire);
+        if (seq & 1) continue;  // Collector is mid-update
+
+        int found = 0;
+        for (unsigned int i = slot_for_pid(pid), probes = 0; probes < TABLE_SLOTS;
+             i = (i + 1) & (TABLE_SLOTS - 1), probes++) {
+            if (table[i].pid == 0) break;
+            if (table[i].pid == pid) {
+                *telemetry = table[i].telemetry;
+                found = 1;
+                break;
+            }
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&table_seq, memory_order_relaxed) == seq) return found ? 0 : -1;
+    }
+}
+
+// Load of the governed services over the collector's last pass; zero while
+// it is not running
+void get_service_load(ServiceLoad *load) {
+    for (;;) {
+        unsigned int seq = atomic_load_explicit(&load_seq, memory_order_acquire);
+        if (seq & 1) continue;
+
+        *load = service_load;
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&load_seq, memory_order_relaxed) == seq) return;
+    }
+}
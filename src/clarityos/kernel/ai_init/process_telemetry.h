@@ -0,0 +1,74 @@
+#ifndef PROCESS_TELEMETRY_H
+#define PROCESS_TELEMETRY_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include "process_manager.h"
+
+// Per-process telemetry
+//
+// A thread that keeps per-process CPU time, RSS, storage I/O and wakeups,
+// without scanning /proc/<pid>/stat. By default it tracks only the main
+// processes of the governed services, which is all the ServiceLoad below
+// needs. Setting TELEMETRY_ALL_PROCESSES_ENV to 1 tracks every process on
+// the host instead, for get_process_telemetry(): /proc is listed once at
+// start, and after that the proc connector's fork and exit events add
+// processes to and remove them from a hash table. If the connector
+// overflows and events are lost, exited processes are found through their
+// pidfds and /proc is listed again for new ones.
+//
+// Each entry holds a pidfd, so a reused pid is never mistaken for the
+// process it replaced. Every TELEMETRY_INTERVAL_MS, up to
+// TELEMETRY_QUERIES_PER_PASS entries are refreshed round-robin with
+// taskstats queries, one netlink round trip and no text parsing each. The
+// cgroup counters of each governed service (cpu.stat, io.stat) are read as
+// well.
+//
+// The collector never reads the process table: the decision loop publishes
+// the services with update_telemetry_services(). Each pass also sums the
+// services up into a ServiceLoad, which the system monitor samples into
+// HardwareState as model inputs.
+
+#define TELEMETRY_ALL_PROCESSES_ENV "AI_INIT_TELEMETRY_ALL_PROCESSES"
+
+#define TELEMETRY_INTERVAL_MS 1000
+#define TELEMETRY_MAX_PROCESSES 8192        // Tracked at once; the table has twice the slots
+#define TELEMETRY_QUERIES_PER_PASS 1024
+
+typedef struct {
+    pid_t pid;
+    uint64_t cpu_ns;            // User and system time, all threads
+    uint64_t rss_kb;            // Average over the CPU time since the previous sample
+    uint64_t rss_peak_kb;
+    uint64_t read_bytes;        // Storage I/O
+    uint64_t write_bytes;
+    uint64_t wakeups;           // Voluntary context switches
+    uint64_t preemptions;       // Involuntary context switches
+    uint64_t updated_ns;        // CLOCK_MONOTONIC of the last sample, 0 if not sampled yet
+} ProcessTelemetry;
+
+// Cgroup counters of a governed service
+typedef struct {
+    uint64_t cpu_usage_us;
+    uint64_t cpu_throttled_us;
+    uint64_t io_read_bytes;
+    uint64_t io_write_bytes;
+    uint64_t updated_ns;        // 0 if the service has no cgroup
+} ServiceTelemetry;
+
+// Load of the governed services over the last pass
+typedef struct {
+    float cpu_max;              // Busiest service, in CPUs
+    float cpu_throttled;        // Throttled time of all services, per second
+    float io_mib_per_s;         // Storage reads and writes of all services
+    float rss_max;              // Largest main-process RSS, fraction of memory
+} ServiceLoad;
+
+// Function prototypes
+int start_process_telemetry();
+void stop_process_telemetry();
+int get_process_telemetry(pid_t pid, ProcessTelemetry *telemetry);
+void update_telemetry_services();
+void get_service_load(ServiceLoad *load);
+
+#endif /* PROCESS_TELEMETRY_H */
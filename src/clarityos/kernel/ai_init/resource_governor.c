@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "resource_governor.h"
+#include "cpu_topology.h"
+#include "init_log.h"
+#include "latency_stats.h"
+
+// cgroup v2 enforcement
+//
+// Every process under a policy gets RESOURCE_CGROUP_ROOT/<name>, tracked in
+// a table indexed by its ProcessId. The group directory and its knob files
+// stay open, and the governor remembers the last value written to each knob.
+// apply_resource_policy() compares the new policy against that and writes
+// only the knobs that changed, so an unchanged policy costs no syscalls and
+// no cgroup locking at all. Policies may be applied off the decision loop,
+// so names and pids come from a ProcessTableView, never from the process
+// table.
+//
+// Placement is enforced through cpuset.cpus and cpuset.mems. Those knobs
+// remember the placement rather than the cpulist written: the topology
+// does not change after startup, so equal placements give equal lists.
+
+typedef enum {
+    KNOB_CPU_MAX,
+    KNOB_MEMORY_HIGH,
+    KNOB_MEMORY_MAX,
+    KNOB_IO_WEIGHT,
+    KNOB_CPUSET_MEMS,
+    KNOB_CPUSET_CPUS,
+    KNOB_PROCS,
+    NUM_KNOBS
+} CgroupKnob;
+
+static const char *knob_files[NUM_KNOBS] = {
+    "cpu.max", "memory.high", "memory.max", "io.weight", "cpuset.mems", "cpuset.cpus", "cgroup.procs"
+};
+
+// Marks a knob whose value is unknown, forcing the next write
+#define KNOB_UNSET (-1LL)
+
+typedef struct {
+    char name[MAX_PROCESS_NAME];
+    int dir_fd;
+    int knob_fds[NUM_KNOBS];
+    long long applied[NUM_KNOBS];
+} GovernedGroup;
+
+static GovernedGroup groups[MAX_MANAGED_PROCESSES];   // Unused while name is empty
+static int root_fd = -1;
+
+int init_resource_governor() {
+    init_cpu_topology();
+
+    if (mkdir(RESOURCE_CGROUP_ROOT, 0755) < 0 && errno != EEXIST) {
+        log_error("Resource governor: cannot create %s: %s", RESOURCE_CGROUP_ROOT, strerror(errno));
+        return -1;
+    }
+
+    root_fd = open(RESOURCE_CGROUP_ROOT, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (root_fd < 0) {
+        log_error("Resource governor: cannot open %s: %s", RESOURCE_CGROUP_ROOT, strerror(errno));
+        return -1;
+    }
+
+    // Delegate the controllers to the per-process groups. The parent has to
+    // enable them for us first; either write failing just leaves the
+    // corresponding knobs absent.
+    static const char controllers[] = "+cpu +cpuset +memory +io";
+    int parent = open(RESOURCE_CGROUP_ROOT "/../cgroup.subtree_control", O_WRONLY | O_CLOEXEC);
+    if (parent >= 0) {
+        if (write(parent, controllers, sizeof(controllers) - 1) < 0) {
+            log_warn("Resource governor: parent controllers: %s", strerror(errno));
+        }
+        close(parent);
+    }
+    int subtree = openat(root_fd, "cgroup.subtree_control", O_WRONLY | O_CLOEXEC);
+    if (subtree < 0 || write(subtree, controllers, sizeof(controllers) - 1) < 0) {
+        log_warn("Resource governor: cannot enable controllers: %s", strerror(errno));
+    }
+    if (subtree >= 0) close(subtree);
+
+    log_info("Resource governor initialized (%s)", RESOURCE_CGROUP_ROOT);
+    return 0;
+}
+
+static GovernedGroup *get_group(ProcessId id, const ProcessTableView *processes) {
+    if (id < 0 || id >= processes->num_processes) return NULL;
+    GovernedGroup *group = &groups[id];
+    if (group->name[0]) return group;
+
+    const char *name = processes->names[id];
+    if (strchr(name, '/')) return NULL;
+
+    if (mkdirat(root_fd, name, 0755) < 0 && errno != EEXIST) {
+        log_error("Resource governor: cannot create group %s: %s", name, strerror(errno));
+        return NULL;
+    }
+    int dir_fd = openat(root_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return NULL;
+
+    memcpy(group->name, name, MAX_PROCESS_NAME);
+    group->dir_fd = dir_fd;
+    for (int k = 0; k < NUM_KNOBS; k++) {
+        // Absent when the controller is not enabled
+        group->knob_fds[k] = openat(dir_fd, knob_files[k], O_WRONLY | O_CLOEXEC);
+        group->applied[k] = KNOB_UNSET;
+    }
+    return group;
+}
+
+// Packed placement for the cpuset knobs: 0 for none, which inherits the
+// parent's set, otherwise node + 1, domain + 1 and the SMT flag
+#define PLACEMENT_NODE_SHIFT 32
+#define PLACEMENT_DOMAIN_SHIFT 1
+
+static long long placement_cpus(const ProcessResourcePolicy *p) {
+    if (p->numa_node < 0 && p->llc_domain < 0 && !p->smt_exclusive) return 0;
+    int node = p->llc_domain >= 0 ? -1 : p->numa_node;
+    return (long long)(node + 1) << PLACEMENT_NODE_SHIFT |
+           (long long)(p->llc_domain + 1) << PLACEMENT_DOMAIN_SHIFT | (p->smt_exclusive ? 1 : 0);
+}
+
+static long long placement_mems(const ProcessResourcePolicy *p) {
+    int node = p->llc_domain >= 0 ? topology_llc_node(p->llc_domain) : p->numa_node;
+    return node >= 0 ? node + 1 : 0;
+}
+
+static int format_cpus_placement(long long value, char *buf, size_t len) {
+    if (value <= 0) return snprintf(buf, len, "\n");
+
+    int node = (int)(value >> PLACEMENT_NODE_SHIFT) - 1;
+    int domain = (int)((value & 0xffffffffLL) >> PLACEMENT_DOMAIN_SHIFT) - 1;
+    CpuMask cpus;
+    if (topology_placement(node, domain, (int)(value & 1), &cpus) == 0) {
+        log_warn("Resource governor: no CPUs for node %d, LLC domain %d", node, domain);
+        return snprintf(buf, len, "\n");
+    }
+    return format_cpu_list(&cpus, buf, len);
+}
+
+static int format_knob(CgroupKnob knob, long long value, char *buf, size_t len) {
+    switch (knob) {
+        case KNOB_CPUSET_CPUS:
+            return format_cpus_placement(value, buf, len);
+        case KNOB_CPUSET_MEMS:
+            if (value <= 0) return snprintf(buf, len, "\n");
+            return snprintf(buf, len, "%lld", value - 1);
+        case KNOB_CPU_MAX:
+            if (value <= 0) return snprintf(buf, len, "max %d", CPU_MAX_PERIOD_US);
+            return snprintf(buf, len, "%lld %d", value, CPU_MAX_PERIOD_US);
+        case KNOB_MEMORY_HIGH:
+        case KNOB_MEMORY_MAX:
+            if (value <= 0) return snprintf(buf, len, "max");
+            return snprintf(buf, len, "%lld", value);
+        default:
+            return snprintf(buf, len, "%lld", value);
+    }
+}
+
+// Returns 1 if a write was issued
+static int set_knob(GovernedGroup *group, CgroupKnob knob, long long value) {
+    if (group->applied[knob] == value || group->knob_fds[knob] < 0) return 0;
+
+    char buf[TOPOLOGY_CPU_LIST_MAX];
+    int len = format_knob(knob, value, buf, sizeof(buf));
+    if (write(group->knob_fds[knob], buf, (size_t)len) < 0) {
+        log_error("Resource governor: %s/%s = %s: %s",
+                  group->name, knob_files[knob], buf, strerror(errno));
+    }
+
+    // Remembered even on failure so a rejected value is not retried every
+    // tick; a different value is attempted again
+    group->applied[knob] = value;
+    return 1;
+}
+
+// Best-effort ionice level to io.weight: level 4 is the default weight of
+// 100, each level up doubles it and each level down halves it
+static long long io_weight_for_priority(int priority) {
+    if (priority < 0) priority = 0;
+    if (priority > 7) priority = 7;
+    long long weight = priority <= 4 ? 100LL << (4 - priority) : 100LL >> (priority - 4);
+    return weight < 1 ? 1 : weight;
+}
+
+void apply_resource_policy(const ResourcePolicy *policy, const ProcessTableView *processes) {
+    if (root_fd < 0 || !policy) return;
+
+    uint64_t start = latency_now();
+    int writes = 0;
+    for (int i = 0; i < policy->num_processes; i++) {
+        const ProcessResourcePolicy *p = &policy->process_policies[i];
+        GovernedGroup *group = get_group(p->process, processes);
+        if (!group) continue;
+
+        long long cpu = p->cpu_quota > 0 ? (long long)p->cpu_quota * CPU_MAX_PERIOD_US / 100 : 0;
+        long long mem_max = p->memory_limit > 0 ? (long long)p->memory_limit << 20 : 0;
+        long long mem_high = mem_max / 10 * 9;
+
+        writes += set_knob(group, KNOB_CPU_MAX, cpu);
+        // Raising the limit: max first, so high never exceeds it; lowering: high first
+        if (group->applied[KNOB_MEMORY_MAX] == KNOB_UNSET || mem_max == 0 ||
+            (group->applied[KNOB_MEMORY_MAX] != 0 && mem_max > group->applied[KNOB_MEMORY_MAX])) {
+            writes += set_knob(group, KNOB_MEMORY_MAX, mem_max);
+            writes += set_knob(group, KNOB_MEMORY_HIGH, mem_high);
+        } else {
+            writes += set_knob(group, KNOB_MEMORY_HIGH, mem_high);
+            writes += set_knob(group, KNOB_MEMORY_MAX, mem_max);
+        }
+        writes += set_knob(group, KNOB_IO_WEIGHT, io_weight_for_priority(p->io_priority));
+        writes += set_knob(group, KNOB_CPUSET_MEMS, placement_mems(p));
+        writes += set_knob(group, KNOB_CPUSET_CPUS, placement_cpus(p));
+
+        // Move the process in once per pid (a restarted process has a new one)
+        pid_t pid = processes->pids[p->process];
+        if (pid > 0) writes += set_knob(group, KNOB_PROCS, pid);
+    }
+
+    if (writes > 0) {
+        log_debug("Resource policy applied (%d cgroup writes)", writes);
+    }
+    latency_record(LATENCY_RESOURCE_POLICY, start);
+}
+
+void shutdown_resource_governor() {
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        if (!groups[i].name[0]) continue;
+        for (int k = 0; k < NUM_KNOBS; k++) {
+            if (groups[i].knob_fds[k] >= 0) close(groups[i].knob_fds[k]);
+        }
+        close(groups[i].dir_fd);
+        groups[i].name[0] = '\0';
+    }
+
+    if (root_fd >= 0) close(root_fd);
+    root_fd = -1;
+}
@@ -0,0 +1,37 @@
+#ifndef RESOURCE_GOVERNOR_H
+#define RESOURCE_GOVERNOR_H
+
+#include "process_manager.h"
+
+// cgroup v2 hierarchy managed by the governor: one child group per process
+#ifndef RESOURCE_CGROUP_ROOT
+#define RESOURCE_CGROUP_ROOT "/sys/fs/cgroup/ai_init"
+#endif
+
+// Period used for cpu.max, in microseconds
+#define CPU_MAX_PERIOD_US 100000
+
+// Resource policy for one process
+typedef struct {
+    ProcessId process;
+    int cpu_quota;              // Percent of one CPU (cpu.max), <= 0 for no limit
+    int memory_limit;           // MiB (memory.max, memory.high at 90%), <= 0 for no limit
+    int io_priority;            // 0 (highest) to 7, best-effort ionice levels (io.weight)
+    int network_priority;       // No cgroup v2 controller; recorded only
+    int numa_node;              // Node to run and allocate on (cpuset), < 0 for any
+    int llc_domain;             // LLC domain to run on (cpu_topology.h), implies its node;
+                                //   < 0 for the whole node
+    int smt_exclusive;          // Run on one hardware thread per core only
+} ProcessResourcePolicy;
+
+typedef struct {
+    ProcessResourcePolicy *process_policies;
+    int num_processes;
+} ResourcePolicy;
+
+// Function prototypes
+int init_resource_governor();
+void apply_resource_policy(const ResourcePolicy *policy, const ProcessTableView *processes);
+void shutdown_resource_governor();
+
+#endif /* RESOURCE_GOVERNOR_H */
@@ -0,0 +1,306 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include "restart_snapshot.h"
+#include "process_manager.h"
+#include "state_history.h"
+#include "decision_cache.h"
+#include "learning_engine.h"
+#include "init_log.h"
+
+extern char **environ;
+
+// Prefix of a decision cache section: the slot and the model it caches for
+typedef struct {
+    uint32_t slot;
+    uint32_t reserved;
+    char path[sizeof(((ModelHandle *)0)->path)];
+} CacheSectionHeader;
+
+static char **exec_argv;
+static int signal_fd = -1;
+
+// Inherited snapshot, mapped read-only until release_restart_snapshot()
+static const unsigned char *snapshot;
+static size_t snapshot_size;
+static int resumed = 0;         // The process table was restored
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static size_t padded(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+static int map_inherited_snapshot(const char *fd_text) {
+    char *end;
+    long fd = strtol(fd_text, &end, 10);
+    if (*end != '\0' || fd < 0 || fd > INT_MAX) return -1;
+    fcntl((int)fd, F_SETFD, FD_CLOEXEC);
+
+    struct stat st;
+    if (fstat((int)fd, &st) < 0 || (size_t)st.st_size < sizeof(RestartSnapshotHeader)) {
+        close((int)fd);
+        return -1;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, (int)fd, 0);
+    close((int)fd);
+    if (data == MAP_FAILED) return -1;
+
+    const RestartSnapshotHeader *header = data;
+    if (header->magic != RESTART_SNAPSHOT_MAGIC || header->version != RESTART_SNAPSHOT_VERSION ||
+        header->size != (uint64_t)st.st_size) {
+        munmap(data, (size_t)st.st_size);
+        return -1;
+    }
+    snapshot = data;
+    snapshot_size = (size_t)st.st_size;
+    return 0;
+}
+
+// Must run before the process manager and any thread: the services must
+// not inherit RESTART_SNAPSHOT_ENV, and every thread must block
+// REEXEC_SIGNAL. Returns 1 if this image was started with a snapshot.
+int init_restart(char **argv) {
+    exec_argv = argv;
+
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, REEXEC_SIGNAL);
+    if (pthread_sigmask(SIG_BLOCK, &mask, NULL) == 0) {
+        signal_fd = signalfd(-1, &mask, SFD_CLOEXEC | SFD_NONBLOCK);
+    }
+    if (signal_fd < 0) log_warn("Re-exec: signalfd: %s", strerror(errno));
+
+    const char *fd_text = getenv(RESTART_SNAPSHOT_ENV);
+    if (!fd_text) return 0;
+
+    int rc = map_inherited_snapshot(fd_text);
+    unsetenv(RESTART_SNAPSHOT_ENV);
+    if (rc < 0) {
+        log_error("Re-exec: unusable snapshot, starting cold");
+        return 0;
+    }
+    return 1;
+}
+
+int restart_signal_fd() {
+    return signal_fd;
+}
+
+// Returns 1 if REEXEC_SIGNAL arrived since the last call
+int take_reexec_request() {
+    struct signalfd_siginfo info;
+    int requested = 0;
+    while (signal_fd >= 0 && read(signal_fd, &info, sizeof(info)) == sizeof(info)) requested = 1;
+    return requested;
+}
+
+// Next section with tag after *offset (0 to start); NULL if there is none
+static const RestartSectionHeader *find_section(RestartSection tag, size_t *offset) {
+    if (*offset == 0) *offset = sizeof(RestartSnapshotHeader);
+
+    while (*offset + sizeof(RestartSectionHeader) <= snapshot_size) {
+        const RestartSectionHeader *section = (const RestartSectionHeader *)(snapshot + *offset);
+        if (section->size > snapshot_size - *offset - sizeof(*section)) return NULL;
+        *offset += sizeof(*section) + padded(section->size);
+        if (section->tag == tag) return section;
+    }
+    return NULL;
+}
+
+static int restore_decision_caches() {
+    int restored = 0;
+    size_t offset = 0;
+    const RestartSectionHeader *section;
+    int token = models_read_lock();
+
+    while ((section = find_section(SNAPSHOT_DECISION_CACHE, &offset)) != NULL) {
+        const CacheSectionHeader *cache = (const CacheSectionHeader *)(section + 1);
+        if (section->size < sizeof(*cache) || cache->slot >= NUM_MODEL_SLOTS) continue;
+
+        // A slot whose model was replaced by another file starts cold
+        ModelHandle *model = get_slot_model((ModelSlot)cache->slot);
+        if (!model || strncmp(model->path, cache->path, sizeof(cache->path)) != 0) continue;
+        if (restore_decision_cache(model, cache + 1, section->size - sizeof(*cache)) == 0) restored++;
+    }
+    models_read_unlock(token);
+
+    if (restored > 0) log_info("Decision caches restored (%d models)", restored);
+    return restored > 0 ? 0 : -1;
+}
+
+// Returns 0 if the section was restored
+int restore_snapshot(RestartSection section) {
+    if (!snapshot) return -1;
+    if (section == SNAPSHOT_DECISION_CACHE) return restore_decision_caches();
+
+    size_t offset = 0;
+    const RestartSectionHeader *header = find_section(section, &offset);
+    if (!header) return -1;
+
+    int rc = -1;
+    if (section == SNAPSHOT_PROCESS_TABLE) {
+        rc = restore_process_table(header + 1, header->size);
+        resumed = rc == 0;
+    }
+    if (section == SNAPSHOT_STATE_HISTORY) rc = restore_state_history(header + 1, header->size);
+    if (rc < 0) log_warn("Re-exec: snapshot section %d not restored", section);
+    return rc;
+}
+
+void release_restart_snapshot() {
+    if (!snapshot) return;
+
+    const RestartSnapshotHeader *header = (const RestartSnapshotHeader *)snapshot;
+    if (resumed) log_info("Resumed after re-exec in %.1f ms", (monotonic_ns() - header->exec_ns) / 1e6);
+
+    munmap((void *)snapshot, snapshot_size);
+    snapshot = NULL;
+    snapshot_size = 0;
+}
+
+static unsigned char *begin_section(unsigned char *out, RestartSection tag, size_t size) {
+    RestartSectionHeader *section = (RestartSectionHeader *)out;
+    section->tag = tag;
+    section->reserved = 0;
+    section->size = size;
+    return out + sizeof(*section);
+}
+
+// Call with the decision pipeline and the model updater stopped, so that
+// the process table and the decision caches do not change. Returns the
+// memfd, which exec_restart() seals, or -1.
+int write_restart_snapshot() {
+    int history_samples = state_history_size();
+    size_t table_size = process_table_snapshot_size();
+    size_t history_size = state_history_snapshot_size(history_samples);
+    size_t cache_sizes[NUM_MODEL_SLOTS];
+
+    int token = models_read_lock();
+    int num_sections = 2;
+    size_t total = sizeof(RestartSnapshotHeader) + 2 * sizeof(RestartSectionHeader) +
+                   padded(table_size) + padded(history_size);
+    for (int s = 0; s < NUM_MODEL_SLOTS; s++) {
+        ModelHandle *model = get_slot_model((ModelSlot)s);
+        cache_sizes[s] = model ? decision_cache_snapshot_size(model) : 0;
+        if (cache_sizes[s] == 0) continue;
+        total += sizeof(RestartSectionHeader) + padded(sizeof(CacheSectionHeader) + cache_sizes[s]);
+        num_sections++;
+    }
+
+    // Not close-on-exec: the new image inherits it
+    int fd = memfd_create("ai_init-snapshot", MFD_ALLOW_SEALING);
+    unsigned char *data = MAP_FAILED;
+    if (fd >= 0 && ftruncate(fd, (off_t)total) == 0) {
+        data = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (data == MAP_FAILED) {
+        models_read_unlock(token);
+        log_error("Re-exec: cannot create snapshot: %s", strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+
+    RestartSnapshotHeader *header = (RestartSnapshotHeader *)data;
+    header->magic = RESTART_SNAPSHOT_MAGIC;
+    header->version = RESTART_SNAPSHOT_VERSION;
+    header->num_sections = (uint16_t)num_sections;
+    header->size = total;
+    header->exec_ns = 0;
+
+    unsigned char *out = data + sizeof(*header);
+    snapshot_process_table(begin_section(out, SNAPSHOT_PROCESS_TABLE, table_size));
+    out += sizeof(RestartSectionHeader) + padded(table_size);
+    snapshot_state_history(begin_section(out, SNAPSHOT_STATE_HISTORY, history_size), history_samples);
+    out += sizeof(RestartSectionHeader) + padded(history_size);
+
+    for (int s = 0; s < NUM_MODEL_SLOTS; s++) {
+        if (cache_sizes[s] == 0) continue;
+        ModelHandle *model = get_slot_model((ModelSlot)s);
+        size_t size = sizeof(CacheSectionHeader) + cache_sizes[s];
+        CacheSectionHeader *cache = (CacheSectionHeader *)begin_section(out, SNAPSHOT_DECISION_CACHE, size);
+        cache->slot = (uint32_t)s;
+        cache->reserved = 0;
+        snprintf(cache->path, sizeof(cache->path), "%s", model->path);
+        snapshot_decision_cache(model, cache + 1);
+        out += sizeof(RestartSectionHeader) + padded(size);
+    }
+    models_read_unlock(token);
+
+    munmap(data, total);
+
+    log_info("Re-exec: snapshot of %d processes, %d history samples, %d sections (%zu KiB)",
+             process_table_size(), history_samples, num_sections, total / 1024);
+    return fd;
+}
+
+// The binary at the path this image was started from, which an upgrade
+// may have replaced
+static int exec_path(char *path, size_t len) {
+    ssize_t n = readlink("/proc/self/exe", path, len - 1);
+    if (n <= 0) return -1;
+    path[n] = '\0';
+
+    const char *suffix = " (deleted)";
+    size_t suffix_len = strlen(suffix);
+    if ((size_t)n > suffix_len && strcmp(path + n - suffix_len, suffix) == 0) path[n - suffix_len] = '\0';
+    return 0;
+}
+
+// Only returns on failure, with the snapshot closed and the listeners
+// close-on-exec again
+int exec_restart(int snapshot_fd) {
+    char path[PATH_MAX];
+    char fd_env[sizeof(RESTART_SNAPSHOT_ENV) + 16];
+    snprintf(fd_env, sizeof(fd_env), RESTART_SNAPSHOT_ENV "=%d", snapshot_fd);
+
+    int n = 0;
+    while (environ && environ[n]) n++;
+    char **envp = calloc((size_t)n + 2, sizeof(char *));
+    if (!envp || exec_path(path, sizeof(path)) < 0) {
+        log_error("Re-exec: cannot find own binary");
+        free(envp);
+        close(snapshot_fd);
+        return -1;
+    }
+    int e = 0;
+    for (int i = 0; i < n; i++) {
+        if (strncmp(environ[i], RESTART_SNAPSHOT_ENV "=", sizeof(RESTART_SNAPSHOT_ENV)) != 0) {
+            envp[e++] = environ[i];
+        }
+    }
+    envp[e++] = fd_env;
+    envp[e] = NULL;
+
+    // Stamped last, then sealed: the new image reads exactly what was written
+    uint64_t exec_ns = monotonic_ns();
+    if (pwrite(snapshot_fd, &exec_ns, sizeof(exec_ns), offsetof(RestartSnapshotHeader, exec_ns)) < 0 ||
+        fcntl(snapshot_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        log_warn("Re-exec: cannot seal snapshot: %s", strerror(errno));
+    }
+
+    set_listen_fds_inherited(1);
+    execve(path, exec_argv, envp);
+
+    int err = errno;
+    set_listen_fds_inherited(0);
+    free(envp);
+    close(snapshot_fd);
+    log_error("Re-exec of %s failed: %s", path, strerror(err));
+    return -1;
+}
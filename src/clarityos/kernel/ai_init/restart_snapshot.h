@@ -0,0 +1,63 @@
+#ifndef RESTART_SNAPSHOT_H
+#define RESTART_SNAPSHOT_H
+
+#include <stdint.h>
+#include <signal.h>
+
+// Re-exec with state
+//
+// REEXEC_SIGNAL makes ai_init execve its binary again, e.g. after an
+// upgrade, without losing what takes longest to rebuild. Before the exec,
+// write_restart_snapshot() stores the process table, the SystemState
+// history and the decision caches in a sealed memfd. The memfd and the
+// socket activation listeners are left open across the exec, and
+// RESTART_SNAPSHOT_ENV gives the new image the memfd's number. ai_init
+// keeps its pid, so the services stay its children and keep running;
+// their listeners never close, and those that exit meanwhile are reaped
+// once the new image runs (SIGCHLD stays blocked and pending across
+// execve). The new image restores the snapshot instead of running the
+// boot sequence and loads every model before its first decision. Models
+// are reloaded from their files, whose pages are still in the page cache.
+//
+// Readiness notifications sent while the notify socket is rebound are
+// lost; they only matter during boot. The snapshot is sectioned, and each
+// section checks its own layout, so a section an upgraded binary cannot
+// read is skipped and only that part starts cold.
+
+#define RESTART_SNAPSHOT_ENV "AI_INIT_SNAPSHOT_FD"
+#define REEXEC_SIGNAL SIGUSR2
+
+#define RESTART_SNAPSHOT_MAGIC   0x4E534C43u  // "CLSN"
+#define RESTART_SNAPSHOT_VERSION 1
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_sections;
+    uint64_t size;              // Whole snapshot, headers included
+    uint64_t exec_ns;           // CLOCK_MONOTONIC just before the execve
+} RestartSnapshotHeader;
+
+// Sections follow the header, each padded to a multiple of 8 bytes
+typedef struct {
+    uint32_t tag;               // SNAPSHOT_*
+    uint32_t reserved;
+    uint64_t size;              // Payload bytes following this header
+} RestartSectionHeader;
+
+typedef enum {
+    SNAPSHOT_PROCESS_TABLE = 1,
+    SNAPSHOT_STATE_HISTORY = 2,
+    SNAPSHOT_DECISION_CACHE = 3     // One per model slot with cached decisions
+} RestartSection;
+
+// Function prototypes
+int init_restart(char **argv);
+int restart_signal_fd();
+int take_reexec_request();
+int restore_snapshot(RestartSection section);
+void release_restart_snapshot();
+int write_restart_snapshot();
+int exec_restart(int snapshot_fd);
+
+#endif /* RESTART_SNAPSHOT_H */
@@ -0,0 +1,212 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/bpf.h>
+#include "sched_policy.h"
+#include "init_log.h"
+#include "../ai_sched/ai_sched.h"
+
+#ifndef ENOTSUPP
+#define ENOTSUPP 524    // Kernel-internal; returned by maps without batch operations
+#endif
+
+// Parameters queued for one process. The map is keyed by pid, so a process
+// restarted under a new pid has its old key deleted on the next flush.
+typedef struct {
+    pid_t pid;                      // 0 if the process has no parameters
+    pid_t stale_pid;                // Key written under a previous pid, 0 if none
+    int dirty;
+    struct ai_sched_params params;
+} SchedEntry;
+
+static SchedEntry entries[MAX_MANAGED_PROCESSES];
+static int map_fd = -1;
+static uint64_t next_open_ns = 0;
+static int warned_missing = 0;
+
+// Kernel CFS load weights by nice value (sched_prio_to_weight[]), nice 0 = 1024
+static const int nice_to_weight[40] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15,
+};
+
+static uint64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static long bpf_call(enum bpf_cmd cmd, union bpf_attr *attr) {
+    return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+static void priority_to_params(int priority, struct ai_sched_params *params) {
+    if (priority < -20) priority = -20;
+    if (priority > 19) priority = 19;
+
+    // Same proportions as the fair scheduler, on the sched_ext scale
+    int weight = nice_to_weight[priority + 20] * AI_SCHED_WEIGHT_DEFAULT / 1024;
+    if (weight < 1) weight = 1;
+    if (weight > AI_SCHED_WEIGHT_MAX) weight = AI_SCHED_WEIGHT_MAX;
+
+    memset(params, 0, sizeof(*params));
+    params->weight = (__u32)weight;
+    if (priority <= SCHED_LATENCY_PRIORITY) {
+        params->flags = AI_SCHED_LATENCY_CRITICAL;
+        params->slice_ns = SCHED_LATENCY_SLICE_NS;
+    } else if (priority < 0) {
+        params->slice_ns = SCHED_INTERACTIVE_SLICE_NS;
+    }
+}
+
+void sched_policy_set(ProcessId process, pid_t pid, int priority) {
+    if (process < 0 || process >= MAX_MANAGED_PROCESSES || pid <= 0) return;
+
+    SchedEntry *entry = &entries[process];
+    struct ai_sched_params params;
+    priority_to_params(priority, &params);
+
+    if (entry->pid == pid && memcmp(&entry->params, &params, sizeof(params)) == 0) return;
+    if (entry->pid && entry->pid != pid) entry->stale_pid = entry->pid;
+    entry->pid = pid;
+    entry->params = params;
+    entry->dirty = 1;
+}
+
+void sched_policy_forget(ProcessId process) {
+    if (process < 0 || process >= MAX_MANAGED_PROCESSES) return;
+
+    SchedEntry *entry = &entries[process];
+    if (!entry->pid) return;
+    entry->stale_pid = entry->pid;
+    entry->pid = 0;
+    entry->dirty = 0;
+}
+
+// Open the pinned map, at most once per SCHED_MAP_RETRY_MS. On success,
+// every queued entry is written again: the map may be new.
+static int open_task_map(uint64_t now) {
+    if (map_fd >= 0) return 0;
+    if (now < next_open_ns) return -1;
+    next_open_ns = now + (uint64_t)SCHED_MAP_RETRY_MS * 1000000ull;
+
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.pathname = (__u64)(uintptr_t)AI_SCHED_TASK_MAP;
+    map_fd = (int)bpf_call(BPF_OBJ_GET, &attr);
+    if (map_fd < 0) {
+        if (!warned_missing) {
+            log_info("sched_ext map %s unavailable (%s), using nice values only", AI_SCHED_TASK_MAP,
+                     strerror(errno));
+            warned_missing = 1;
+        }
+        return -1;
+    }
+
+    log_info("sched_ext map %s opened", AI_SCHED_TASK_MAP);
+    warned_missing = 0;
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        if (entries[i].pid) entries[i].dirty = 1;
+    }
+    return 0;
+}
+
+static void close_task_map(const char *op) {
+    log_warn("sched_ext map %s failed: %s", op, strerror(errno));
+    close(map_fd);
+    map_fd = -1;
+}
+
+// Write count entries with one batch call, one call per entry where the
+// kernel lacks batch operations. Returns -1 if the map is unusable.
+static int update_entries(__u32 *keys, struct ai_sched_params *values, __u32 count) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.batch.map_fd = (__u32)map_fd;
+    attr.batch.keys = (__u64)(uintptr_t)keys;
+    attr.batch.values = (__u64)(uintptr_t)values;
+    attr.batch.count = count;
+    attr.batch.elem_flags = BPF_ANY;
+    if (bpf_call(BPF_MAP_UPDATE_BATCH, &attr) == 0) return 0;
+    if (errno != EINVAL && errno != ENOTSUPP && errno != EOPNOTSUPP) return -1;
+
+    for (__u32 i = 0; i < count; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = (__u32)map_fd;
+        attr.key = (__u64)(uintptr_t)&keys[i];
+        attr.value = (__u64)(uintptr_t)&values[i];
+        attr.flags = BPF_ANY;
+        if (bpf_call(BPF_MAP_UPDATE_ELEM, &attr) < 0) return -1;
+    }
+    return 0;
+}
+
+// Deletes of keys that are already gone (the scheduler restarted with a
+// fresh map) are not errors
+static int delete_entries(__u32 *keys, __u32 count) {
+    union bpf_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.batch.map_fd = (__u32)map_fd;
+    attr.batch.keys = (__u64)(uintptr_t)keys;
+    attr.batch.count = count;
+    if (bpf_call(BPF_MAP_DELETE_BATCH, &attr) == 0) return 0;
+    if (errno != EINVAL && errno != ENOTSUPP && errno != EOPNOTSUPP && errno != ENOENT) return -1;
+
+    for (__u32 i = 0; i < count; i++) {
+        memset(&attr, 0, sizeof(attr));
+        attr.map_fd = (__u32)map_fd;
+        attr.key = (__u64)(uintptr_t)&keys[i];
+        if (bpf_call(BPF_MAP_DELETE_ELEM, &attr) < 0 && errno != ENOENT) return -1;
+    }
+    return 0;
+}
+
+// Write the parameters queued since the last flush. Returns the number of
+// map entries written or deleted, -1 if the map is unavailable.
+int sched_policy_flush() {
+    if (open_task_map(monotonic_ns()) < 0) return -1;
+
+    __u32 keys[MAX_MANAGED_PROCESSES];
+    struct ai_sched_params values[MAX_MANAGED_PROCESSES];
+    __u32 count = 0;
+
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        if (!entries[i].stale_pid) continue;
+        keys[count++] = (__u32)entries[i].stale_pid;
+    }
+    if (count > 0 && delete_entries(keys, count) < 0) {
+        close_task_map("delete");
+        return -1;
+    }
+    __u32 deleted = count;
+
+    count = 0;
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        if (!entries[i].dirty) continue;
+        keys[count] = (__u32)entries[i].pid;
+        values[count] = entries[i].params;
+        count++;
+    }
+    if (count > 0 && update_entries(keys, values, count) < 0) {
+        close_task_map("update");
+        return -1;
+    }
+
+    for (int i = 0; i < MAX_MANAGED_PROCESSES; i++) {
+        entries[i].stale_pid = 0;
+        entries[i].dirty = 0;
+    }
+    if (deleted + count > 0) log_debug("sched_ext map: %u updated, %u deleted", count, deleted);
+    return (int)(deleted + count);
+}
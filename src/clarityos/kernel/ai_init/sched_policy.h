@@ -0,0 +1,27 @@
+#ifndef SCHED_POLICY_H
+#define SCHED_POLICY_H
+
+#include "process_manager.h"
+
+// Scheduling parameters for the ai_sched sched_ext scheduler
+//
+// Each priority a process adjustment carries is also translated into a
+// weight, a slice and a latency flag, for ai_sched's pinned task map
+// (../ai_sched/ai_sched.h). These are queued per process and written in one
+// batch per decision tick. Without the scheduler loaded, only the nice value
+// applies; the map is looked for again every SCHED_MAP_RETRY_MS, and all
+// queued parameters are written once it appears.
+
+#define SCHED_MAP_RETRY_MS 10000
+
+// Priorities at or below this nice value are latency-critical
+#define SCHED_LATENCY_PRIORITY (-10)
+#define SCHED_LATENCY_SLICE_NS 1000000ull        // Latency-critical processes
+#define SCHED_INTERACTIVE_SLICE_NS 5000000ull    // Other negative nice values; others use the default
+
+// Function prototypes
+void sched_policy_set(ProcessId process, pid_t pid, int priority);
+void sched_policy_forget(ProcessId process);
+int sched_policy_flush();
+
+#endif /* SCHED_POLICY_H */
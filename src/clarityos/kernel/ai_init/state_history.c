@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdatomic.h>
+#include "state_history.h"
+#include "init_log.h"
+
+// SystemState history
+//
+// A preallocated ring buffer stored struct-of-arrays: each metric has its own
+// contiguous series, so a window over one metric is at most two contiguous
+// runs (before and after the wrap point) that the compiler can vectorize.
+// Appending writes one slot per series and never allocates.
+//
+// There is a single writer (the monitoring thread). The sample count is
+// published with release semantics after the slot is written, so readers see
+// complete samples. A reader that spends longer than a full ring revolution
+// on one query may observe overwritten samples; windows are expected to be
+// far shorter than the capacity.
+
+static double series[HISTORY_NUM_METRICS][STATE_HISTORY_CAPACITY] __attribute__((aligned(64)));
+static time_t timestamps[STATE_HISTORY_CAPACITY];
+static unsigned int anomaly_flags[STATE_HISTORY_CAPACITY];
+static _Atomic unsigned long long sample_count;
+static int restored = 0;        // Samples came from a snapshot; keep them
+
+// A window of the ring expressed as up to two contiguous runs, oldest first
+typedef struct {
+    const double *first;
+    int first_len;
+    const double *second;
+    int second_len;
+} HistoryWindow;
+
+void init_state_history() {
+    if (restored) return;
+    atomic_store_explicit(&sample_count, 0, memory_order_relaxed);
+    log_info("State history initialized (%d samples)", STATE_HISTORY_CAPACITY);
+}
+
+double state_metric_value(const SystemState *state, HistoryMetric metric) {
+    switch (metric) {
+        case HISTORY_CPU_USAGE: return state->cpu_usage;
+        case HISTORY_MEMORY_USAGE: return state->memory_usage;
+        case HISTORY_IO_USAGE: return state->io_usage;
+        case HISTORY_NETWORK_USAGE: return state->network_usage;
+        case HISTORY_NUM_PROCESSES: return state->num_processes;
+        case HISTORY_NUM_USERS: return state->num_users;
+        case HISTORY_BATTERY_LEVEL: return state->battery_level;
+        case HISTORY_ON_AC_POWER: return state->on_ac_power;
+        default: return 0.0;
+    }
+}
+
+void state_history_append(const SystemState *state) {
+    unsigned long long count = atomic_load_explicit(&sample_count, memory_order_relaxed);
+    int slot = (int)(count % STATE_HISTORY_CAPACITY);
+
+    for (int m = 0; m < HISTORY_NUM_METRICS; m++) {
+        series[m][slot] = state_metric_value(state, (HistoryMetric)m);
+    }
+    timestamps[slot] = state->last_update_time;
+    anomaly_flags[slot] = 0;
+
+    atomic_store_explicit(&sample_count, count + 1, memory_order_release);
+}
+
+void state_history_mark_anomaly(unsigned int anomalies) {
+    unsigned long long count = atomic_load_explicit(&sample_count, memory_order_relaxed);
+    if (count == 0) return;
+
+    anomaly_flags[(count - 1) % STATE_HISTORY_CAPACITY] |= anomalies;
+}
+
+int state_history_size() {
+    unsigned long long count = atomic_load_explicit(&sample_count, memory_order_acquire);
+    return count < STATE_HISTORY_CAPACITY ? (int)count : STATE_HISTORY_CAPACITY;
+}
+
+static HistoryWindow get_window(HistoryMetric metric, int n) {
+    HistoryWindow window = { NULL, 0, NULL, 0 };
+    unsigned long long count = atomic_load_explicit(&sample_count, memory_order_acquire);
+    int size = count < STATE_HISTORY_CAPACITY ? (int)count : STATE_HISTORY_CAPACITY;
+
+    if (metric < 0 || metric >= HISTORY_NUM_METRICS) return window;
+    if (n > size) n = size;
+    if (n <= 0) return window;
+
+    const double *data = series[metric];
+    int end = (int)(count % STATE_HISTORY_CAPACITY);  // One past the newest sample
+    int start = end - n;
+
+    if (start >= 0) {
+        window.first = data + start;
+        window.first_len = n;
+    } else {
+        window.first = data + STATE_HISTORY_CAPACITY + start;
+        window.first_len = -start;
+        window.second = data;
+        window.second_len = end;
+    }
+
+    return window;
+}
+
+static int slot_for_age(int age) {
+    unsigned long long count = atomic_load_explicit(&sample_count, memory_order_acquire);
+    if (age < 0 || (unsigned long long)age >= count || age >= STATE_HISTORY_CAPACITY) return -1;
+
+    return (int)((count - 1 - age) % STATE_HISTORY_CAPACITY);
+}
+
+static double sum_run(const double *data, int len) {
+    double sum = 0.0;
+    for (int i = 0; i < len; i++) sum += data[i];
+    return sum;
+}
+
+static double sum_squared_deviation(const double *data, int len, double mean) {
+    double sum = 0.0;
+    for (int i = 0; i < len; i++) {
+        double d = data[i] - mean;
+        sum += d * d;
+    }
+    return sum;
+}
+
+// Sum of (x0 + i) * data[i], used for the least-squares slope
+static double sum_weighted(const double *data, int len, double x0) {
+    double sum = 0.0;
+    for (int i = 0; i < len; i++) sum += (x0 + i) * data[i];
+    return sum;
+}
+
+int state_history_copy(HistoryMetric metric, int n, double *out) {
+    HistoryWindow window = get_window(metric, n);
+
+    memcpy(out, window.first, sizeof(double) * window.first_len);
+    if (window.second_len > 0) {
+        memcpy(out + window.first_len, window.second, sizeof(double) * window.second_len);
+    }
+
+    return window.first_len + window.second_len;
+}
+
+time_t state_history_timestamp(int age) {
+    int slot = slot_for_age(age);
+    return slot < 0 ? 0 : timestamps[slot];
+}
+
+unsigned int state_history_anomalies(int age) {
+    int slot = slot_for_age(age);
+    return slot < 0 ? 0 : anomaly_flags[slot];
+}
+
+double state_history_mean(HistoryMetric metric, int n) {
+    HistoryWindow window = get_window(metric, n);
+    int len = window.first_len + window.second_len;
+    if (len == 0) return 0.0;
+
+    return (sum_run(window.first, window.first_len) +
+            sum_run(window.second, window.second_len)) / len;
+}
+
+double state_history_stddev(HistoryMetric metric, int n) {
+    HistoryWindow window = get_window(metric, n);
+    int len = window.first_len + window.second_len;
+    if (len < 2) return 0.0;
+
+    double mean = (sum_run(window.first, window.first_len) +
+                   sum_run(window.second, window.second_len)) / len;
+    double ss = sum_squared_deviation(window.first, window.first_len, mean) +
+                sum_squared_deviation(window.second, window.second_len, mean);
+
+    return sqrt(ss / (len - 1));
+}
+
+double state_history_slope(HistoryMetric metric, int n) {
+    HistoryWindow window = get_window(metric, n);
+    int len = window.first_len + window.second_len;
+    if (len < 2) return 0.0;
+
+    // Least-squares fit of value against sample index 0..len-1; the result
+    // is the change per sample
+    double sum_y = sum_run(window.first, window.first_len) +
+                   sum_run(window.second, window.second_len);
+    double sum_xy = sum_weighted(window.first, window.first_len, 0.0) +
+                    sum_weighted(window.second, window.second_len, window.first_len);
+    double sum_x = (double)len * (len - 1) / 2.0;
+    double sum_xx = (double)len * (len - 1) * (2.0 * len - 1) / 6.0;
+
+    return (len * sum_xy - sum_x * sum_y) / (len * sum_xx - sum_x * sum_x);
+}
+
+// Hoare quickselect: partially orders data so data[k] is the k-th smallest
+static double select_kth(double *data, int len, int k) {
+    int lo = 0;
+    int hi = len - 1;
+
+    while (lo < hi) {
+        double pivot = data[lo + (hi - lo) / 2];
+        int i = lo;
+        int j = hi;
+
+        while (i <= j) {
+            while (data[i] < pivot) i++;
+            while (data[j] > pivot) j--;
+            if (i <= j) {
+                double tmp = data[i];
+                data[i] = data[j];
+                data[j] = tmp;
+                i++;
+                j--;
+            }
+        }
+
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+
+    return data[k];
+}
+
+// Nearest-rank percentile (0.0 to 1.0). scratch must hold n doubles; the
+// history itself is never reordered.
+double state_history_percentile(HistoryMetric metric, int n, double percentile, double *scratch) {
+    int len = state_history_copy(metric, n, scratch);
+    if (len == 0) return 0.0;
+
+    int rank = (int)ceil(percentile * len) - 1;
+    if (rank < 0) rank = 0;
+    if (rank >= len) rank = len - 1;
+
+    return select_kth(scratch, len, rank);
+}
+
+// History snapshot (see restart_snapshot.h): the newest samples, oldest
+// first, as one run per metric followed by their timestamps and anomaly
+// flags
+typedef struct {
+    uint32_t num_metrics;
+    uint32_t num_samples;
+} HistorySnapshot;
+
+#define HISTORY_SAMPLE_BYTES (HISTORY_NUM_METRICS * sizeof(double) + sizeof(int64_t) + sizeof(uint32_t))
+
+size_t state_history_snapshot_size(int n) {
+    return sizeof(HistorySnapshot) + (size_t)n * HISTORY_SAMPLE_BYTES;
+}
+
+// n from state_history_size(), which only grows. The monitoring thread may
+// keep appending meanwhile; only the oldest samples in a full ring can be
+// overwritten during the copy.
+void snapshot_state_history(void *buf, int n) {
+    unsigned long long count = atomic_load_explicit(&sample_count, memory_order_acquire);
+    HistorySnapshot *snapshot = buf;
+    snapshot->num_metrics = HISTORY_NUM_METRICS;
+    snapshot->num_samples = (uint32_t)n;
+
+    double *values = (double *)(snapshot + 1);
+    int64_t *times = (int64_t *)(values + (size_t)HISTORY_NUM_METRICS * n);
+    uint32_t *flags = (uint32_t *)(times + n);
+    for (int i = 0; i < n; i++) {
+        int slot = (int)((count - n + i) % STATE_HISTORY_CAPACITY);
+        for (int m = 0; m < HISTORY_NUM_METRICS; m++) values[(size_t)m * n + i] = series[m][slot];
+        times[i] = (int64_t)timestamps[slot];
+        flags[i] = anomaly_flags[slot];
+    }
+}
+
+// Before the monitoring thread starts
+int restore_state_history(const void *buf, size_t size) {
+    const HistorySnapshot *snapshot = buf;
+    if (size < sizeof(*snapshot) || snapshot->num_metrics != HISTORY_NUM_METRICS ||
+        size != state_history_snapshot_size((int)snapshot->num_samples)) {
+        return -1;
+    }
+
+    int n = (int)snapshot->num_samples;
+    const double *values = (const double *)(snapshot + 1);
+    const int64_t *times = (const int64_t *)(values + (size_t)HISTORY_NUM_METRICS * n);
+    const uint32_t *flags = (const uint32_t *)(times + n);
+
+    // A smaller ring keeps the newest samples
+    int skip = n > STATE_HISTORY_CAPACITY ? n - STATE_HISTORY_CAPACITY : 0;
+    for (int i = skip; i < n; i++) {
+        int slot = i - skip;
+        for (int m = 0; m < HISTORY_NUM_METRICS; m++) series[m][slot] = values[(size_t)m * n + i];
+        timestamps[slot] = (time_t)times[i];
+        anomaly_flags[slot] = flags[i];
+    }
+    atomic_store_explicit(&sample_count, (unsigned long long)(n - skip), memory_order_release);
+    restored = 1;
+
+    log_info("State history restored (%d samples)", n - skip);
+    return 0;
+}
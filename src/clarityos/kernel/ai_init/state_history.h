@@ -0,0 +1,50 @@
+#ifndef STATE_HISTORY_H
+#define STATE_HISTORY_H
+
+#include <stddef.h>
+#include "system_state.h"
+
+// Number of samples retained (24 hours at 1 second resolution)
+#ifndef STATE_HISTORY_CAPACITY
+#define STATE_HISTORY_CAPACITY 86400
+#endif
+
+// A sample is appended at this fixed interval, however often each metric
+// is actually sampled; metrics not refreshed since keep their last value
+#define STATE_HISTORY_INTERVAL_MS 1000
+
+// Metrics stored in the history, one contiguous series per metric
+typedef enum {
+    HISTORY_CPU_USAGE,
+    HISTORY_MEMORY_USAGE,
+    HISTORY_IO_USAGE,
+    HISTORY_NETWORK_USAGE,
+    HISTORY_NUM_PROCESSES,
+    HISTORY_NUM_USERS,
+    HISTORY_BATTERY_LEVEL,
+    HISTORY_ON_AC_POWER,
+    HISTORY_NUM_METRICS
+} HistoryMetric;
+
+// Function prototypes
+void init_state_history();
+double state_metric_value(const SystemState *state, HistoryMetric metric);
+void state_history_append(const SystemState *state);
+void state_history_mark_anomaly(unsigned int anomalies);
+int state_history_size();
+
+// Windowed queries over the last n samples (n is clamped to the history size)
+int state_history_copy(HistoryMetric metric, int n, double *out);
+time_t state_history_timestamp(int age);
+unsigned int state_history_anomalies(int age);
+double state_history_mean(HistoryMetric metric, int n);
+double state_history_stddev(HistoryMetric metric, int n);
+double state_history_slope(HistoryMetric metric, int n);
+double state_history_percentile(HistoryMetric metric, int n, double percentile, double *scratch);
+
+// Re-exec (see restart_snapshot.h)
+size_t state_history_snapshot_size(int n);
+void snapshot_state_history(void *buf, int n);
+int restore_state_history(const void *buf, size_t size);
+
+#endif /* STATE_HISTORY_H */
@@ -1,88 +1,597 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include "system_monitor.h"
 #include "system_state.h"
+#include "state_history.h"
+#include "anomaly_detector.h"
+#include "cpu_topology.h"
+#include "learning_log.h"
+#include "init_log.h"
 
 // Thread handle for the monitoring thread
 static pthread_t monitor_thread;
-static int monitor_running = 0;
+static atomic_int monitor_running = 0;
 
 // Monitoring interval in microseconds
-static int monitoring_interval = 1000000;  // 1 second
+static atomic_int monitoring_interval = 1000000;  // 1 second
+
+// Adaptive sampling
+//
+// By default, each metric group runs on its own cadence instead of the
+// fixed monitoring interval. After every sample the metric's volatility
+// (standard deviation over its own last ADAPTIVE_WINDOW samples, relative to
+// its scale) decides the next interval: stable metrics back off exponentially up to
+// ADAPTIVE_MAX_INTERVAL_US, volatile ones ramp down to
+// ADAPTIVE_FAST_INTERVAL_US, and a metric involved in an anomaly or a PSI
+// stall jumps straight to ADAPTIVE_MIN_INTERVAL_US. The timerfd is then armed
+// one-shot for the earliest deadline, so an idle system wakes rarely.
+#define ADAPTIVE_MIN_INTERVAL_US   10000     // 10 ms
+#define ADAPTIVE_FAST_INTERVAL_US  50000     // 50 ms
+#define ADAPTIVE_MAX_INTERVAL_US   10000000  // 10 s
+#define ADAPTIVE_WINDOW            64        // Samples of the metric considered
+#define ADAPTIVE_STABLE_THRESHOLD  0.01
+#define ADAPTIVE_VOLATILE_THRESHOLD 0.05
+
+typedef struct {
+    unsigned int metric;         // METRIC_* group sampled
+    HistoryMetric series;        // Series used to judge volatility
+    double scale;                // Normalizer for volatility (0 = relative to mean)
+    unsigned int anomaly_mask;   // ANOMALY_* flags that force fast sampling
+    long interval_us;            // Current cadence
+    uint64_t next_deadline_ns;   // Absolute CLOCK_MONOTONIC deadline
+} MetricSchedule;
+
+// Owned by the monitoring thread
+static MetricSchedule metric_schedules[] = {
+    { METRIC_CPU,       HISTORY_CPU_USAGE,     1.0,   ANOMALY_HIGH_CPU,      0, 0 },
+    { METRIC_MEMORY,    HISTORY_MEMORY_USAGE,  1.0,   ANOMALY_HIGH_MEMORY,   0, 0 },
+    { METRIC_IO,        HISTORY_IO_USAGE,      1.0,   ANOMALY_HIGH_IO,       0, 0 },
+    { METRIC_NETWORK,   HISTORY_NETWORK_USAGE, 1.0,   ANOMALY_HIGH_NETWORK,  0, 0 },
+    { METRIC_PROCESSES, HISTORY_NUM_PROCESSES, 0.0,   ANOMALY_PROCESS_SURGE, 0, 0 },
+    { METRIC_USERS,     HISTORY_NUM_USERS,     0.0,   0,                     0, 0 },
+    { METRIC_POWER,     HISTORY_BATTERY_LEVEL, 100.0, ANOMALY_LOW_BATTERY,   0, 0 },
+    // Judged on the mean per-core load, which tracks the CPU
+    { METRIC_HARDWARE,  HISTORY_CPU_USAGE,     1.0,   ANOMALY_HIGH_CPU,      0, 0 },
+};
+#define NUM_METRIC_SCHEDULES (int)(sizeof(metric_schedules) / sizeof(metric_schedules[0]))
+
+// The last ADAPTIVE_WINDOW values each schedule actually sampled. The
+// history cannot serve here: it holds one row per STATE_HISTORY_INTERVAL_MS,
+// repeating whatever was last sampled.
+typedef struct {
+    double values[ADAPTIVE_WINDOW];
+    int count;
+    int next;
+} SampleWindow;
+
+static SampleWindow sample_windows[NUM_METRIC_SCHEDULES];
+
+static atomic_int adaptive_sampling = 1;
+
+// Mode the timer is currently armed for (monitoring thread only)
+static int adaptive_active = 0;
+
+// Anomalies found by the most recent detect_anomalies() call
+static unsigned int last_anomalies = 0;
+
+// Anomalies found since the last history row, tagged on the next one
+static unsigned int pending_anomalies = 0;
+
+// Event loop file descriptors
+//
+// The monitoring thread blocks in epoll_wait() on a periodic timerfd armed
+// with an absolute deadline (so sampling does not drift by the time the work
+// takes), a control eventfd used to deliver interval changes and shutdown
+// immediately, and PSI trigger fds that wake the monitor as soon as the
+// kernel reports resource stalls. A second periodic timerfd appends the
+// current state to the history and the learning log every
+// STATE_HISTORY_INTERVAL_MS, however often the metrics are sampled.
+static int epoll_fd = -1;
+static int timer_fd = -1;
+static int history_fd = -1;
+static int control_fd = -1;
+
+// PSI triggers: wake when tasks stall for 150 ms within any 1 s window
+#define PSI_TRIGGER "some 150000 1000000"
+
+static const char *psi_paths[] = {
+    "/proc/pressure/cpu",
+    "/proc/pressure/memory",
+    "/proc/pressure/io",
+};
+
+// Metric groups refreshed at high rate when the matching PSI trigger fires;
+// the hardware group carries the stall percentages themselves
+static const unsigned int psi_metrics[] = {
+    METRIC_CPU | METRIC_HARDWARE,
+    METRIC_MEMORY | METRIC_HARDWARE,
+    METRIC_IO | METRIC_HARDWARE,
+};
+#define NUM_PSI_RESOURCES (int)(sizeof(psi_paths) / sizeof(psi_paths[0]))
+
+static int psi_fds[NUM_PSI_RESOURCES] = { -1, -1, -1 };
+
+// epoll tags identifying the source of each event
+enum {
+    EVENT_TIMER,
+    EVENT_HISTORY,
+    EVENT_CONTROL,
+    EVENT_PSI_BASE
+};
+
+static uint64_t monotonic_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+// Arm the timer one-shot for an absolute deadline (adaptive mode)
+static void arm_timer_at(uint64_t deadline_ns) {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_value.tv_sec = deadline_ns / 1000000000ULL;
+    spec.it_value.tv_nsec = deadline_ns % 1000000000ULL;
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        log_error("timerfd_settime: %s", strerror(errno));
+    }
+}
+
+static void arm_next_metric_deadline() {
+    uint64_t earliest = metric_schedules[0].next_deadline_ns;
+
+    for (int i = 1; i < NUM_METRIC_SCHEDULES; i++) {
+        if (metric_schedules[i].next_deadline_ns < earliest) {
+            earliest = metric_schedules[i].next_deadline_ns;
+        }
+    }
+
+    arm_timer_at(earliest);
+}
+
+// Restart every metric on the base interval
+static void reset_metric_schedules() {
+    long interval_us = atomic_load(&monitoring_interval);
+    uint64_t now = monotonic_ns();
+
+    for (int i = 0; i < NUM_METRIC_SCHEDULES; i++) {
+        metric_schedules[i].interval_us = interval_us;
+        metric_schedules[i].next_deadline_ns = now + (uint64_t)interval_us * 1000;
+    }
+    memset(sample_windows, 0, sizeof(sample_windows));
+}
+
+// Append the value the schedule's metric group just sampled to its window
+static void record_sample(int index, const SystemState *state, const HardwareState *hardware) {
+    const MetricSchedule *schedule = &metric_schedules[index];
+    SampleWindow *window = &sample_windows[index];
+    double value = state_metric_value(state, schedule->series);
+
+    if (schedule->metric == METRIC_HARDWARE && hardware->num_cpus > 0) {
+        value = 0.0;
+        for (int c = 0; c < hardware->num_cpus; c++) value += hardware->core_usage[c];
+        value /= hardware->num_cpus;
+    }
+
+    window->values[window->next] = value;
+    window->next = (window->next + 1) % ADAPTIVE_WINDOW;
+    if (window->count < ADAPTIVE_WINDOW) window->count++;
+}
+
+static double window_mean(const SampleWindow *window) {
+    double sum = 0.0;
+    for (int i = 0; i < window->count; i++) sum += window->values[i];
+    return window->count > 0 ? sum / window->count : 0.0;
+}
+
+static double window_stddev(const SampleWindow *window) {
+    if (window->count < 2) return 0.0;
+
+    double mean = window_mean(window);
+    double sum = 0.0;
+    for (int i = 0; i < window->count; i++) {
+        double d = window->values[i] - mean;
+        sum += d * d;
+    }
+    return sqrt(sum / window->count);
+}
+
+// Pull the given metric groups forward to the minimum interval
+static void expedite_metrics(unsigned int metrics) {
+    uint64_t deadline = monotonic_ns() + ADAPTIVE_MIN_INTERVAL_US * 1000ULL;
+
+    for (int i = 0; i < NUM_METRIC_SCHEDULES; i++) {
+        MetricSchedule *schedule = &metric_schedules[i];
+        if (!(schedule->metric & metrics)) continue;
+
+        schedule->interval_us = ADAPTIVE_MIN_INTERVAL_US;
+        if (schedule->next_deadline_ns > deadline) schedule->next_deadline_ns = deadline;
+    }
+}
+
+// Pick the next interval for a metric that was just sampled
+static void adapt_metric_interval(MetricSchedule *schedule, const SampleWindow *window,
+                                  unsigned int anomalies) {
+    long base_us = atomic_load(&monitoring_interval);
+    long interval_us = schedule->interval_us;
+
+    if (anomalies & schedule->anomaly_mask) {
+        schedule->interval_us = ADAPTIVE_MIN_INTERVAL_US;
+        return;
+    }
+
+    double scale = schedule->scale;
+    if (scale <= 0.0) {
+        scale = window_mean(window);
+        if (scale < 1.0) scale = 1.0;
+    }
+    double volatility = window_stddev(window) / scale;
+
+    if (volatility > ADAPTIVE_VOLATILE_THRESHOLD) {
+        // Changing fast: ramp up sampling
+        interval_us /= 2;
+        if (interval_us < ADAPTIVE_FAST_INTERVAL_US) interval_us = ADAPTIVE_FAST_INTERVAL_US;
+    } else if (volatility < ADAPTIVE_STABLE_THRESHOLD) {
+        // Stable: back off
+        interval_us *= 2;
+        if (interval_us > ADAPTIVE_MAX_INTERVAL_US) interval_us = ADAPTIVE_MAX_INTERVAL_US;
+    } else if (interval_us < base_us) {
+        // Moderate: settle back towards the configured interval
+        interval_us *= 2;
+        if (interval_us > base_us) interval_us = base_us;
+    } else if (interval_us > base_us) {
+        interval_us /= 2;
+        if (interval_us < base_us) interval_us = base_us;
+    }
+
+    schedule->interval_us = interval_us;
+}
+
+// Sample the metric groups whose deadline has passed (adaptive mode)
+static void sample_due_metrics(unsigned int extra_metrics) {
+    uint64_t now = monotonic_ns();
+    unsigned int due = extra_metrics;
+
+    for (int i = 0; i < NUM_METRIC_SCHEDULES; i++) {
+        if (metric_schedules[i].next_deadline_ns <= now) due |= metric_schedules[i].metric;
+    }
+
+    if (!due) return;
+
+    update_system_state_metrics(due);
+    detect_anomalies(due);
+
+    SystemState state;
+    HardwareState hardware;
+    get_published_state(&state, &hardware);
+
+    for (int i = 0; i < NUM_METRIC_SCHEDULES; i++) {
+        MetricSchedule *schedule = &metric_schedules[i];
+        if (!(schedule->metric & due)) continue;
+
+        record_sample(i, &state, &hardware);
+        adapt_metric_interval(schedule, &sample_windows[i], last_anomalies);
+
+        // Advance from the previous deadline so cadence does not drift,
+        // unless we fell behind by more than a full period
+        uint64_t interval_ns = (uint64_t)schedule->interval_us * 1000;
+        uint64_t next = schedule->next_deadline_ns + interval_ns;
+        if (next <= now) next = now + interval_ns;
+        schedule->next_deadline_ns = next;
+    }
+}
+
+static void arm_monitoring_timer() {
+    long interval_us = atomic_load(&monitoring_interval);
+    struct itimerspec spec;
+    struct timespec now;
+
+    adaptive_active = atomic_load(&adaptive_sampling);
+    if (adaptive_active) {
+        reset_metric_schedules();
+        arm_next_metric_deadline();
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    spec.it_interval.tv_sec = interval_us / 1000000;
+    spec.it_interval.tv_nsec = (interval_us % 1000000) * 1000;
+
+    // First deadline is one period from now; the kernel advances it by
+    // it_interval from there, independent of how long each sample takes
+    spec.it_value.tv_sec = now.tv_sec + spec.it_interval.tv_sec;
+    spec.it_value.tv_nsec = now.tv_nsec + spec.it_interval.tv_nsec;
+    if (spec.it_value.tv_nsec >= 1000000000L) {
+        spec.it_value.tv_sec++;
+        spec.it_value.tv_nsec -= 1000000000L;
+    }
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+        log_error("timerfd_settime: %s", strerror(errno));
+    }
+}
+
+static void arm_history_timer() {
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = STATE_HISTORY_INTERVAL_MS / 1000;
+    spec.it_interval.tv_nsec = (STATE_HISTORY_INTERVAL_MS % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(history_fd, 0, &spec, NULL) < 0) {
+        log_error("timerfd_settime: %s", strerror(errno));
+    }
+}
+
+// One history row and STATE record per tick, tagged with the anomalies
+// detected since the previous one
+static void append_history_row() {
+    SystemState state;
+    HardwareState hardware;
+    get_published_state(&state, &hardware);
+    record_state_update(&state, &hardware);
+
+    if (pending_anomalies) state_history_mark_anomaly(pending_anomalies);
+    pending_anomalies = 0;
+}
+
+static int watch_fd(int fd, uint32_t events, uint32_t tag) {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u32 = tag;
+
+    return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+}
+
+static void open_psi_triggers() {
+    for (int i = 0; i < NUM_PSI_RESOURCES; i++) {
+        int fd = open(psi_paths[i], O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            log_warn("System monitor: PSI unavailable (%s)", psi_paths[i]);
+            continue;
+        }
+
+        // The kernel expects the trigger string including its terminator
+        if (write(fd, PSI_TRIGGER, strlen(PSI_TRIGGER) + 1) < 0 ||
+            watch_fd(fd, EPOLLPRI, EVENT_PSI_BASE + i) < 0) {
+            log_warn("System monitor: cannot arm PSI trigger on %s", psi_paths[i]);
+            close(fd);
+            continue;
+        }
+
+        psi_fds[i] = fd;
+    }
+}
+
+static void close_event_loop() {
+    for (int i = 0; i < NUM_PSI_RESOURCES; i++) {
+        if (psi_fds[i] >= 0) close(psi_fds[i]);
+        psi_fds[i] = -1;
+    }
+
+    if (timer_fd >= 0) close(timer_fd);
+    if (history_fd >= 0) close(history_fd);
+    if (control_fd >= 0) close(control_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    timer_fd = history_fd = control_fd = epoll_fd = -1;
+}
+
+static int init_event_loop() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    history_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    control_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (epoll_fd < 0 || timer_fd < 0 || history_fd < 0 || control_fd < 0 ||
+        watch_fd(timer_fd, EPOLLIN, EVENT_TIMER) < 0 ||
+        watch_fd(history_fd, EPOLLIN, EVENT_HISTORY) < 0 ||
+        watch_fd(control_fd, EPOLLIN, EVENT_CONTROL) < 0) {
+        log_error("System monitor event loop: %s", strerror(errno));
+        close_event_loop();
+        return -1;
+    }
+
+    open_psi_triggers();
+    arm_monitoring_timer();
+    arm_history_timer();
+
+    return 0;
+}
+
+// Wake the monitoring thread to re-read its configuration
+static void notify_monitor() {
+    uint64_t one = 1;
+
+    if (control_fd >= 0 && write(control_fd, &one, sizeof(one)) < 0) {
+        log_error("System monitor: control eventfd: %s", strerror(errno));
+    }
+}
 
 // Monitoring thread function
 void *monitoring_thread_func(void *arg) {
-    while (monitor_running) {
-        // Update system state
-        update_system_state();
-        
-        // Analyze for anomalies
-        detect_anomalies();
-        
-        // Sleep for monitoring interval
-        usleep(monitoring_interval);
-    }
-    
+    (void)arg;
+    struct epoll_event events[3 + NUM_PSI_RESOURCES];
+
+    while (atomic_load(&monitor_running)) {
+        int n = epoll_wait(epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            log_error("epoll_wait: %s", strerror(errno));
+            break;
+        }
+
+        int sample = 0;
+        int append = 0;
+        unsigned int stalled_metrics = 0;
+        uint64_t counter;
+
+        for (int i = 0; i < n; i++) {
+            uint32_t tag = events[i].data.u32;
+
+            if (tag == EVENT_TIMER) {
+                // Missed expirations are collapsed into a single sample
+                if (read(timer_fd, &counter, sizeof(counter)) == sizeof(counter)) {
+                    sample = 1;
+                }
+            } else if (tag == EVENT_HISTORY) {
+                if (read(history_fd, &counter, sizeof(counter)) == sizeof(counter)) {
+                    append = 1;
+                }
+            } else if (tag == EVENT_CONTROL) {
+                if (read(control_fd, &counter, sizeof(counter)) == sizeof(counter) &&
+                    atomic_load(&monitor_running)) {
+                    arm_monitoring_timer();
+                }
+            } else {
+                // PSI stall reported: sample now rather than at the next tick
+                sample = 1;
+                stalled_metrics |= psi_metrics[tag - EVENT_PSI_BASE];
+            }
+        }
+
+        if (!atomic_load(&monitor_running)) break;
+
+        if (adaptive_active) {
+            if (sample) {
+                sample_due_metrics(stalled_metrics);
+                if (stalled_metrics) expedite_metrics(stalled_metrics);
+                arm_next_metric_deadline();
+            }
+        } else if (sample) {
+            // Update system state
+            update_system_state();
+
+            // Analyze for anomalies
+            detect_anomalies(METRIC_ALL);
+        }
+
+        // After sampling, so a row due at the same tick is fresh
+        if (append) append_history_row();
+    }
+
     return NULL;
 }
 
 void init_system_monitor() {
     // Initialize system state
     init_system_state();
-    
+
+    if (init_anomaly_detector() < 0) {
+        log_error("Failed to initialize anomaly detector");
+        exit(EXIT_FAILURE);
+    }
+
+    if (init_event_loop() < 0) {
+        log_error("Failed to initialize monitoring event loop");
+        exit(EXIT_FAILURE);
+    }
+
     // Start monitoring thread
-    monitor_running = 1;
+    atomic_store(&monitor_running, 1);
     if (pthread_create(&monitor_thread, NULL, monitoring_thread_func, NULL) != 0) {
-        fprintf(stderr, "Failed to create monitoring thread\n");
+        log_error("Failed to create monitoring thread");
         exit(EXIT_FAILURE);
     }
-    
-    printf("System monitor initialized\n");
+
+    log_info("System monitor initialized");
+}
+
+// Call once the housekeeping CPUs are known (cpu_topology.h)
+void pin_system_monitor() {
+    pin_housekeeping_thread(monitor_thread, HOUSEKEEPING_MONITOR);
+}
+
+// Stop only the monitoring thread, keeping the state and event loop, while
+// the log writers it appends to are down (see reexec() in init_main.c)
+void pause_system_monitor() {
+    atomic_store(&monitor_running, 0);
+    notify_monitor();
+    pthread_join(monitor_thread, NULL);
+}
+
+int resume_system_monitor() {
+    atomic_store(&monitor_running, 1);
+    if (pthread_create(&monitor_thread, NULL, monitoring_thread_func, NULL) != 0) {
+        log_error("Failed to restart monitoring thread");
+        atomic_store(&monitor_running, 0);
+        return -1;
+    }
+    pin_system_monitor();
+    return 0;
 }
 
 void stop_system_monitor() {
-    // Stop monitoring thread
-    monitor_running = 0;
+    // Stop monitoring thread; the control event wakes it immediately
+    atomic_store(&monitor_running, 0);
+    notify_monitor();
     pthread_join(monitor_thread, NULL);
-    
-    printf("System monitor stopped\n");
+
+    close_event_loop();
+
+    log_info("System monitor stopped");
 }
 
 void set_monitoring_interval(int interval_ms) {
-    monitoring_interval = interval_ms * 1000;  // Convert to microseconds
-    printf("Monitoring interval set to %d ms\n", interval_ms);
-}
-
-void detect_anomalies() {
-    // Get current system state
-    SystemState state = get_current_system_state();
-    
-    // Check for high CPU usage
-    if (state.cpu_usage > 0.9) {
-        printf("ANOMALY: High CPU usage detected (%.1f%%)\n", state.cpu_usage * 100);
-        // In a real implementation, would take corrective action
-    }
-    
-    // Check for high memory usage
-    if (state.memory_usage > 0.9) {
-        printf("ANOMALY: High memory usage detected (%.1f%%)\n", state.memory_usage * 100);
-        // In a real implementation, would take corrective action
-    }
-    
-    // Check for low battery
-    if (!state.on_ac_power && state.battery_level < 10.0) {
-        printf("ANOMALY: Low battery level (%.1f%%)\n", state.battery_level);
-        // In a real implementation, would take corrective action
-    }
-    
+    if (interval_ms <= 0) {
+        log_error("Invalid monitoring interval: %d ms", interval_ms);
+        return;
+    }
+
+    atomic_store(&monitoring_interval, interval_ms * 1000);  // Convert to microseconds
+
+    // Re-arm the timer from the monitoring thread right away
+    notify_monitor();
+
+    log_info("Monitoring interval set to %d ms", interval_ms);
+}
+
+void set_adaptive_sampling(int enabled) {
+    atomic_store(&adaptive_sampling, enabled ? 1 : 0);
+
+    // The monitoring thread switches timer mode on the control event
+    notify_monitor();
+
+    log_info("Adaptive sampling %s", enabled ? "enabled" : "disabled");
+}
+
+// Feed the series refreshed by the METRIC_* groups in metrics to the
+// streaming detector, and hand new anomalies to the decision loop
+void detect_anomalies(unsigned int metrics) {
+    AnomalyEvent events[HISTORY_NUM_METRICS];
+    int num_events;
+    unsigned int anomalies = anomaly_detector_update(metrics, monotonic_ns(), events,
+                                                     HISTORY_NUM_METRICS, &num_events);
+
     // Record anomaly detection for learning
-    record_anomaly_detection();
+    last_anomalies = anomalies;
+    record_anomaly_detection(anomalies, events, num_events);
+    anomaly_queue_events(events, num_events);
 }
 
-void record_anomaly_detection() {
-    // In a real implementation, this would record anomaly detection for learning
-    // For this prototype, just print the action
-    printf("Recording anomaly detection\n");
-}
\ No newline at end of file
+void record_anomaly_detection(unsigned int anomalies, const AnomalyEvent *events, int num_events) {
+    // Tag the next history row so the learning engine can correlate
+    // anomalies with the state around them
+    pending_anomalies |= anomalies;
+
+    for (int i = 0; i < num_events; i++) {
+        const AnomalyEvent *event = &events[i];
+        log_warn("ANOMALY: %s %s: %.3f against %.3f (score %.1f)", anomaly_series_name(event->series),
+                 anomaly_kind_name(event->kind), event->value, event->expected, event->score);
+        float values[] = { (float)event->series, (float)event->kind, (float)event->value,
+                           (float)event->expected, (float)event->score };
+        learning_log_event(LOG_PRODUCER_MONITOR, LOG_RECORD_ANOMALY, event->flag, values, 5);
+    }
+}
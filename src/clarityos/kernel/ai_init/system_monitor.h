@@ -1,11 +1,30 @@
 #ifndef SYSTEM_MONITOR_H
 #define SYSTEM_MONITOR_H
 
+#include "anomaly_detector.h"
+
+// Anomaly flags recorded alongside the state history, one per detected
+// series (see anomaly_detector.h)
+#define ANOMALY_HIGH_CPU      0x1
+#define ANOMALY_HIGH_MEMORY   0x2
+#define ANOMALY_LOW_BATTERY   0x4
+#define ANOMALY_HIGH_IO       0x8
+#define ANOMALY_HIGH_NETWORK  0x10
+#define ANOMALY_PROCESS_SURGE 0x20
+
+// Adaptive sampling (see system_monitor.c) is on by default; setting
+// ADAPTIVE_SAMPLING_ENV to 0 samples every metric at the monitoring interval
+#define ADAPTIVE_SAMPLING_ENV "AI_INIT_ADAPTIVE_SAMPLING"
+
 // Function prototypes
 void init_system_monitor();
 void stop_system_monitor();
+void pin_system_monitor();
+void pause_system_monitor();
+int resume_system_monitor();
 void set_monitoring_interval(int interval_ms);
-void detect_anomalies();
-void record_anomaly_detection();
+void set_adaptive_sampling(int enabled);
+void detect_anomalies(unsigned int metrics);
+void record_anomaly_detection(unsigned int anomalies, const AnomalyEvent *events, int num_events);
 
 #endif /* SYSTEM_MONITOR_H */
\ No newline at end of file
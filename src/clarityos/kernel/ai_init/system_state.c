@@ -2,13 +2,220 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <utmpx.h>
+#include <stdatomic.h>
 #include "system_state.h"
+#include "state_history.h"
+#include "learning_log.h"
+#include "process_telemetry.h"
+#include "init_log.h"
+#include "latency_stats.h"
 
+// State publication
+//
+// The monitor thread builds each update in current_state, which only it
+// touches, and then publishes a complete copy into one of two slots. Each slot
+// is guarded by a sequence counter (seqlock): odd while being written, even
+// once stable. Readers copy the most recently published slot and retry only
+// if the writer lapped them mid-copy. Readers never write shared memory, so
+// the read path takes no locks and causes no cache-line ping-pong.
+typedef struct {
+    _Atomic unsigned int seq;
+    SystemState state;
+    HardwareState hardware;
+} __attribute__((aligned(64))) StateSlot;
+
+static StateSlot state_slots[2];
+static _Atomic unsigned int published_slot __attribute__((aligned(64)));
+
+// Working copies owned by the monitoring thread
 static SystemState current_state;
+static HardwareState current_hardware;
+
+static void publish_system_state(const SystemState *state, const HardwareState *hardware) {
+    unsigned int index = atomic_load_explicit(&published_slot, memory_order_relaxed) ^ 1;
+    StateSlot *slot = &state_slots[index];
+    unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+
+    // Mark the slot as being written before touching the payload
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    slot->state = *state;
+    slot->hardware = *hardware;
+
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    atomic_store_explicit(&published_slot, index, memory_order_release);
+}
+
+// /proc collectors
+//
+// Each collector keeps its /proc file open for the lifetime of ai_init and
+// re-reads it with pread() at offset 0 into a fixed buffer, so a sample costs
+// one syscall and no allocation. Rates are computed from the previous
+// counter snapshot, which the collectors keep in static storage.
+
+#define PROC_STAT_BUF_SIZE      16384
+#define PROC_MEMINFO_BUF_SIZE   4096
+#define PROC_DISKSTATS_BUF_SIZE 16384
+#define PROC_NETDEV_BUF_SIZE    8192
+#define PROC_LOADAVG_BUF_SIZE   128
+#define PROC_PRESSURE_BUF_SIZE  256
+#define NODE_MEMINFO_BUF_SIZE   2048
+#define SYSFS_VALUE_BUF_SIZE    32
+
+#define MAX_TRACKED_DISKS 64
+#define MAX_CPUFREQ_POLICIES 16
+#define MAX_THERMAL_ZONES 16
+#define MAX_POWER_SUPPLIES 8
+#define MAX_COUNTED_USERS 64
+
+// Nominal link capacity used to normalize network throughput (1 Gbit/s)
+#define NETWORK_CAPACITY_BYTES_PER_SEC 125000000.0
+
+typedef struct {
+    char path[64];
+    int fd;
+} ProcFile;
+
+static ProcFile proc_stat = { "/proc/stat", -1 };
+static ProcFile proc_meminfo = { "/proc/meminfo", -1 };
+static ProcFile proc_diskstats = { "/proc/diskstats", -1 };
+static ProcFile proc_netdev = { "/proc/net/dev", -1 };
+static ProcFile proc_loadavg = { "/proc/loadavg", -1 };
+
+// PSI, in HardwareState field order: cpu some, memory some/full, io some/full
+static ProcFile proc_pressure[] = {
+    { "/proc/pressure/cpu", -1 },
+    { "/proc/pressure/memory", -1 },
+    { "/proc/pressure/io", -1 },
+};
+#define NUM_PRESSURE_FILES (int)(sizeof(proc_pressure) / sizeof(proc_pressure[0]))
+
+// Hardware collectors found at init; any of them may be absent (containers,
+// VMs without cpufreq, machines without thermal zones)
+static ProcFile node_meminfo[HW_MAX_NUMA_NODES];
+static int num_numa_nodes = 0;
+static ProcFile cpufreq_cur[MAX_CPUFREQ_POLICIES];
+static double cpufreq_max_khz[MAX_CPUFREQ_POLICIES];
+static int num_cpufreq_policies = 0;
+static ProcFile thermal_zones[MAX_THERMAL_ZONES];
+static int num_thermal_zones = 0;
+
+// Power supplies: "online" of each mains adapter, "capacity" and "status"
+// of each battery. A machine with neither counts as on AC at 100%.
+static ProcFile mains_online[MAX_POWER_SUPPLIES];
+static int num_mains = 0;
+static ProcFile battery_capacity[MAX_POWER_SUPPLIES];
+static ProcFile battery_status[MAX_POWER_SUPPLIES];
+static int num_batteries = 0;
+
+static void open_proc_file(ProcFile *file) {
+    if (file->fd >= 0) return;
+
+    file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    if (file->fd < 0) {
+        log_error("System state: cannot open %s", file->path);
+    }
+}
+
+// Open an optional sysfs file, formatted from a path pattern and an index.
+// Returns -1, without complaint, if it does not exist.
+static int open_sys_file(ProcFile *file, const char *pattern, int index) {
+    snprintf(file->path, sizeof(file->path), pattern, index);
+    file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    return file->fd >= 0 ? 0 : -1;
+}
+
+static ssize_t read_proc_file(ProcFile *file, char *buf, size_t size);
+
+// Open a file of a power supply; -1 if it is missing or its path too long
+static int open_supply_file(ProcFile *file, const char *supply, const char *name) {
+    int n = snprintf(file->path, sizeof(file->path), "/sys/class/power_supply/%s/%s", supply, name);
+    if (n < 0 || n >= (int)sizeof(file->path)) return -1;
+    file->fd = open(file->path, O_RDONLY | O_CLOEXEC);
+    return file->fd >= 0 ? 0 : -1;
+}
+
+static void open_power_supplies() {
+    DIR *dir = opendir("/sys/class/power_supply");
+    if (!dir) return;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        ProcFile type_file;
+        if (open_supply_file(&type_file, entry->d_name, "type") < 0) continue;
+        char type[SYSFS_VALUE_BUF_SIZE];
+        ssize_t len = read_proc_file(&type_file, type, sizeof(type));
+        close(type_file.fd);
+        if (len <= 0) continue;
+
+        if (strncmp(type, "Mains", 5) == 0 && num_mains < MAX_POWER_SUPPLIES) {
+            if (open_supply_file(&mains_online[num_mains], entry->d_name, "online") == 0) num_mains++;
+        } else if (strncmp(type, "Battery", 7) == 0 && num_batteries < MAX_POWER_SUPPLIES) {
+            if (open_supply_file(&battery_capacity[num_batteries], entry->d_name, "capacity") < 0) continue;
+            if (open_supply_file(&battery_status[num_batteries], entry->d_name, "status") < 0) {
+                battery_status[num_batteries].fd = -1;
+            }
+            num_batteries++;
+        }
+    }
+    closedir(dir);
+}
+
+static void open_hardware_collectors() {
+    for (int i = 0; i < NUM_PRESSURE_FILES; i++) {
+        proc_pressure[i].fd = open(proc_pressure[i].path, O_RDONLY | O_CLOEXEC);
+    }
+
+    while (num_numa_nodes < HW_MAX_NUMA_NODES &&
+           open_sys_file(&node_meminfo[num_numa_nodes], "/sys/devices/system/node/node%d/meminfo",
+                         num_numa_nodes) == 0) {
+        num_numa_nodes++;
+    }
+
+    // Policies are named after their first CPU, so the numbering has gaps
+    for (int cpu = 0; cpu < HW_MAX_CPUS && num_cpufreq_policies < MAX_CPUFREQ_POLICIES; cpu++) {
+        ProcFile max_file;
+        if (open_sys_file(&max_file, "/sys/devices/system/cpu/cpufreq/policy%d/cpuinfo_max_freq", cpu) < 0) {
+            continue;
+        }
+
+        char buf[SYSFS_VALUE_BUF_SIZE];
+        double max_khz = read_proc_file(&max_file, buf, sizeof(buf)) > 0 ? atof(buf) : 0.0;
+        close(max_file.fd);
+
+        ProcFile *cur = &cpufreq_cur[num_cpufreq_policies];
+        if (max_khz <= 0.0 ||
+            open_sys_file(cur, "/sys/devices/system/cpu/cpufreq/policy%d/scaling_cur_freq", cpu) < 0) {
+            continue;
+        }
+        cpufreq_max_khz[num_cpufreq_policies++] = max_khz;
+    }
+
+    while (num_thermal_zones < MAX_THERMAL_ZONES &&
+           open_sys_file(&thermal_zones[num_thermal_zones], "/sys/class/thermal/thermal_zone%d/temp",
+                         num_thermal_zones) == 0) {
+        num_thermal_zones++;
+    }
+
+    open_power_supplies();
+
+    log_info("System state: %d NUMA nodes, %d cpufreq policies, %d thermal zones, "
+             "%d mains adapters, %d batteries",
+             num_numa_nodes, num_cpufreq_policies, num_thermal_zones, num_mains, num_batteries);
+}
 
 void init_system_state() {
     // Initialize system state
+    init_state_history();
     memset(&current_state, 0, sizeof(SystemState));
+    memset(&current_hardware, 0, sizeof(HardwareState));
     
     // Set initial values
     current_state.boot_time = time(NULL);
@@ -22,104 +229,502 @@ void init_system_state() {
     current_state.battery_level = 100.0;  // Assume fully charged
     current_state.on_ac_power = 1;        // Assume AC power
     
-    printf("System state initialized\n");
+    // Open the /proc collectors once and take the first counter snapshot,
+    // so the first real update already has a baseline to diff against
+    open_proc_file(&proc_stat);
+    open_proc_file(&proc_meminfo);
+    open_proc_file(&proc_diskstats);
+    open_proc_file(&proc_netdev);
+    open_proc_file(&proc_loadavg);
+    open_hardware_collectors();
+    get_cpu_usage();
+    get_io_usage();
+    get_network_usage();
+    update_hardware_state(&current_hardware);
+    
+    publish_system_state(&current_state, &current_hardware);
+    
+    log_info("System state initialized");
+}
+
+// Copy the requested parts of the most recently published slot
+static void read_published_state(SystemState *state, HardwareState *hardware) {
+    for (;;) {
+        unsigned int index = atomic_load_explicit(&published_slot, memory_order_acquire);
+        const StateSlot *slot = &state_slots[index];
+
+        unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq & 1) continue;  // Writer is mid-update on this slot
+
+        if (state) *state = slot->state;
+        if (hardware) *hardware = slot->hardware;
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == seq) {
+            return;
+        }
+    }
 }
 
 SystemState get_current_system_state() {
-    return current_state;
+    SystemState snapshot;
+    read_published_state(&snapshot, NULL);
+    return snapshot;
+}
+
+HardwareState get_current_hardware_state() {
+    HardwareState snapshot;
+    read_published_state(NULL, &snapshot);
+    return snapshot;
+}
+
+// Both halves of the same published sample
+void get_published_state(SystemState *state, HardwareState *hardware) {
+    read_published_state(state, hardware);
 }
 
 void update_system_state() {
+    update_system_state_metrics(METRIC_ALL);
+}
+
+// Refresh only the requested METRIC_* groups; the others keep their last
+// sampled value in the published state
+void update_system_state_metrics(unsigned int metrics) {
+    uint64_t start = latency_now();
+    
     // Update timestamp
     current_state.last_update_time = time(NULL);
     
-    // Update resource usage (in a real implementation, would read from /proc)
-    current_state.cpu_usage = get_cpu_usage();
-    current_state.memory_usage = get_memory_usage();
-    current_state.io_usage = get_io_usage();
-    current_state.network_usage = get_network_usage();
+    // Update resource usage from /proc
+    if (metrics & METRIC_CPU) LATENCY_TIMED(LATENCY_COLLECT_CPU, current_state.cpu_usage = get_cpu_usage());
+    if (metrics & METRIC_MEMORY) LATENCY_TIMED(LATENCY_COLLECT_MEMORY, current_state.memory_usage = get_memory_usage());
+    if (metrics & METRIC_IO) LATENCY_TIMED(LATENCY_COLLECT_IO, current_state.io_usage = get_io_usage());
+    if (metrics & METRIC_NETWORK) LATENCY_TIMED(LATENCY_COLLECT_NETWORK, current_state.network_usage = get_network_usage());
     
-    // Update process count (in a real implementation, would read from /proc)
-    current_state.num_processes = count_processes();
+    // Update process count from /proc/loadavg
+    if (metrics & METRIC_PROCESSES) LATENCY_TIMED(LATENCY_COLLECT_PROCESSES, current_state.num_processes = count_processes());
     
     // Update user count (in a real implementation, would use getutent())
-    current_state.num_users = count_users();
+    if (metrics & METRIC_USERS) LATENCY_TIMED(LATENCY_COLLECT_USERS, current_state.num_users = count_users());
+    
+    // Mains adapters and batteries
+    if (metrics & METRIC_POWER) LATENCY_TIMED(LATENCY_COLLECT_POWER, update_power_state());
+    
+    // Per-core, per-node, PSI, cpufreq and thermal state for model inputs
+    if (metrics & METRIC_HARDWARE) LATENCY_TIMED(LATENCY_COLLECT_HARDWARE, update_hardware_state(&current_hardware));
     
-    // Update power state (in a real implementation, would read from /sys)
-    update_power_state();
+    // Make the complete snapshot visible to readers. It is recorded by the
+    // monitor's fixed-rate history tick, not on every partial sample.
+    publish_system_state(&current_state, &current_hardware);
     
-    // Record state update for learning
-    record_state_update();
+    latency_record(LATENCY_STATE_UPDATE, start);
 }
 
 // Helper functions to get system metrics
+
+// Re-read a /proc file into buf and NUL-terminate it. Returns the number of
+// bytes read, or -1 if the file is unavailable. Content that does not fit in
+// the buffer is truncated; every collector only needs the leading lines.
+static ssize_t read_proc_file(ProcFile *file, char *buf, size_t size) {
+    if (file->fd < 0) return -1;
+
+    ssize_t len = pread(file->fd, buf, size - 1, 0);
+    if (len < 0) return -1;
+
+    buf[len] = '\0';
+    return len;
+}
+
+static const char *skip_spaces(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+static const char *next_line(const char *p) {
+    while (*p && *p != '\n') p++;
+    return *p ? p + 1 : p;
+}
+
+// Parse an unsigned decimal number, advancing *p past it
+static unsigned long long parse_ull(const char **p) {
+    const char *s = skip_spaces(*p);
+    unsigned long long value = 0;
+
+    while (*s >= '0' && *s <= '9') {
+        value = value * 10 + (unsigned long long)(*s - '0');
+        s++;
+    }
+
+    *p = s;
+    return value;
+}
+
+// Find the value following "key" at the start of a line, or NULL
+static const char *find_field(const char *buf, const char *key) {
+    size_t key_len = strlen(key);
+
+    for (const char *line = buf; *line; line = next_line(line)) {
+        if (strncmp(line, key, key_len) == 0) return line + key_len;
+    }
+
+    return NULL;
+}
+
+static double elapsed_seconds(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) +
+           (double)(to->tv_nsec - from->tv_nsec) / 1e9;
+}
+
+static unsigned long long counter_delta(unsigned long long now, unsigned long long prev) {
+    // Counters can go backwards when a device disappears or wraps
+    return now >= prev ? now - prev : 0;
+}
+
+static double clamp_unit(double value) {
+    if (value < 0.0) return 0.0;
+    if (value > 1.0) return 1.0;
+    return value;
+}
+
 double get_cpu_usage() {
-    // In a real implementation, this would read from /proc/stat
-    // For this prototype, return a dummy value that changes slightly each time
-    static double last_cpu = 0.3;
-    double change = ((double)rand() / RAND_MAX - 0.5) * 0.1;  // -0.05 to +0.05
-    double new_cpu = last_cpu + change;
-    
-    // Keep within bounds
-    if (new_cpu < 0.05) new_cpu = 0.05;
-    if (new_cpu > 0.95) new_cpu = 0.95;
-    
-    last_cpu = new_cpu;
-    return new_cpu;
+    static char buf[PROC_STAT_BUF_SIZE];
+    static unsigned long long prev_total = 0;
+    static unsigned long long prev_idle = 0;
+
+    if (read_proc_file(&proc_stat, buf, sizeof(buf)) < 0) return 0.0;
+
+    const char *p = find_field(buf, "cpu ");
+    if (!p) return 0.0;
+
+    // user nice system idle iowait irq softirq steal
+    unsigned long long fields[8];
+    unsigned long long total = 0;
+    for (int i = 0; i < 8; i++) {
+        fields[i] = parse_ull(&p);
+        total += fields[i];
+    }
+    unsigned long long idle = fields[3] + fields[4];
+
+    unsigned long long d_total = counter_delta(total, prev_total);
+    unsigned long long d_idle = counter_delta(idle, prev_idle);
+    int primed = prev_total != 0;
+
+    prev_total = total;
+    prev_idle = idle;
+
+    if (!primed || d_total == 0) return 0.0;
+    return clamp_unit(1.0 - (double)d_idle / (double)d_total);
 }
 
 double get_memory_usage() {
-    // In a real implementation, this would read from /proc/meminfo
-    // For this prototype, return a dummy value
-    return 0.4 + ((double)rand() / RAND_MAX - 0.5) * 0.1;  // 0.35 to 0.45
+    static char buf[PROC_MEMINFO_BUF_SIZE];
+
+    if (read_proc_file(&proc_meminfo, buf, sizeof(buf)) < 0) return 0.0;
+
+    const char *total_field = find_field(buf, "MemTotal:");
+    const char *avail_field = find_field(buf, "MemAvailable:");
+    if (!total_field || !avail_field) return 0.0;
+
+    unsigned long long total_kb = parse_ull(&total_field);
+    unsigned long long avail_kb = parse_ull(&avail_field);
+    if (total_kb == 0) return 0.0;
+
+    return clamp_unit(1.0 - (double)avail_kb / (double)total_kb);
 }
 
 double get_io_usage() {
-    // In a real implementation, this would read from /proc/diskstats
-    // For this prototype, return a dummy value
-    return 0.2 + ((double)rand() / RAND_MAX - 0.5) * 0.1;  // 0.15 to 0.25
+    static char buf[PROC_DISKSTATS_BUF_SIZE];
+    static unsigned long long prev_dev[MAX_TRACKED_DISKS];
+    static unsigned long long prev_io_ticks[MAX_TRACKED_DISKS];
+    static int num_disks = 0;
+    static struct timespec prev_time;
+
+    if (read_proc_file(&proc_diskstats, buf, sizeof(buf)) < 0) return 0.0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed_ms = elapsed_seconds(&prev_time, &now) * 1000.0;
+    int primed = num_disks > 0;
+    prev_time = now;
+
+    // Report the busiest device: io_ticks is the time (ms) the device had
+    // I/O in flight, so its rate is the device utilization
+    double busiest = 0.0;
+
+    for (const char *line = buf; *line; line = next_line(line)) {
+        const char *p = line;
+        unsigned long long major = parse_ull(&p);
+        unsigned long long minor = parse_ull(&p);
+
+        p = skip_spaces(p);
+        const char *name = p;
+        while (*p && *p != ' ') p++;
+        if (strncmp(name, "loop", 4) == 0 || strncmp(name, "ram", 3) == 0) continue;
+
+        // Skip reads/writes counters up to io_ticks (10th field after the name)
+        for (int i = 0; i < 9; i++) parse_ull(&p);
+        unsigned long long io_ticks = parse_ull(&p);
+
+        unsigned long long dev = (major << 20) | minor;
+        int slot = 0;
+        while (slot < num_disks && prev_dev[slot] != dev) slot++;
+
+        if (slot == num_disks) {
+            if (num_disks == MAX_TRACKED_DISKS) continue;
+            num_disks++;
+            prev_dev[slot] = dev;
+            prev_io_ticks[slot] = io_ticks;
+            continue;
+        }
+
+        unsigned long long d_ticks = counter_delta(io_ticks, prev_io_ticks[slot]);
+        prev_io_ticks[slot] = io_ticks;
+
+        if (primed && elapsed_ms > 0.0) {
+            double utilization = (double)d_ticks / elapsed_ms;
+            if (utilization > busiest) busiest = utilization;
+        }
+    }
+
+    return clamp_unit(busiest);
 }
 
 double get_network_usage() {
-    // In a real implementation, this would read from /proc/net/dev
-    // For this prototype, return a dummy value
-    return 0.1 + ((double)rand() / RAND_MAX - 0.5) * 0.05;  // 0.075 to 0.125
+    static char buf[PROC_NETDEV_BUF_SIZE];
+    static unsigned long long prev_bytes = 0;
+    static struct timespec prev_time;
+    static int primed = 0;
+
+    if (read_proc_file(&proc_netdev, buf, sizeof(buf)) < 0) return 0.0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    // Skip the two header lines, then sum rx+tx bytes over all interfaces
+    // except loopback
+    unsigned long long bytes = 0;
+    const char *line = next_line(next_line(buf));
+
+    for (; *line; line = next_line(line)) {
+        const char *p = skip_spaces(line);
+        const char *colon = strchr(p, ':');
+        if (!colon) break;
+        if (strncmp(p, "lo:", 3) == 0) continue;
+
+        p = colon + 1;
+        unsigned long long rx_bytes = parse_ull(&p);
+        for (int i = 0; i < 7; i++) parse_ull(&p);
+        unsigned long long tx_bytes = parse_ull(&p);
+
+        bytes += rx_bytes + tx_bytes;
+    }
+
+    double elapsed = elapsed_seconds(&prev_time, &now);
+    unsigned long long d_bytes = counter_delta(bytes, prev_bytes);
+    int was_primed = primed;
+
+    prev_bytes = bytes;
+    prev_time = now;
+    primed = 1;
+
+    if (!was_primed || elapsed <= 0.0) return 0.0;
+    return clamp_unit((double)d_bytes / elapsed / NETWORK_CAPACITY_BYTES_PER_SEC);
 }
 
 int count_processes() {
-    // In a real implementation, this would read from /proc
-    // For this prototype, return a dummy value
-    return 50 + rand() % 10;  // 50 to 59
+    static char buf[PROC_LOADAVG_BUF_SIZE];
+
+    if (read_proc_file(&proc_loadavg, buf, sizeof(buf)) < 0) return 0;
+
+    // Format: "0.00 0.01 0.05 running/total last_pid"
+    const char *p = strchr(buf, '/');
+    if (!p) return 0;
+    p++;
+
+    return (int)parse_ull(&p);
 }
 
+// Distinct users with a login session in utmp
 int count_users() {
-    // In a real implementation, this would use getutent()
-    // For this prototype, return a dummy value
-    return 1 + rand() % 2;  // 1 to 2
+    char users[MAX_COUNTED_USERS][sizeof(((struct utmpx *)0)->ut_user)];
+    int num_users = 0;
+
+    setutxent();
+    struct utmpx *entry;
+    while ((entry = getutxent()) != NULL && num_users < MAX_COUNTED_USERS) {
+        if (entry->ut_type != USER_PROCESS || entry->ut_user[0] == '\0') continue;
+
+        int seen = 0;
+        for (int i = 0; i < num_users && !seen; i++) {
+            seen = strncmp(users[i], entry->ut_user, sizeof(users[i])) == 0;
+        }
+        if (!seen) memcpy(users[num_users++], entry->ut_user, sizeof(users[0]));
+    }
+    endutxent();
+    return num_users;
 }
 
+// On AC if any mains adapter is online or, without adapters, unless a
+// battery is discharging. The battery level is the mean capacity.
 void update_power_state() {
-    // In a real implementation, this would read from /sys
-    // For this prototype, use dummy values
-    
-    // Only update occasionally to simulate stability
-    if (rand() % 10 == 0) {
-        current_state.on_ac_power = rand() % 2;  // 0 or 1
+    char buf[SYSFS_VALUE_BUF_SIZE];
+
+    int online = 0;
+    for (int i = 0; i < num_mains; i++) {
+        if (read_proc_file(&mains_online[i], buf, sizeof(buf)) > 0 && buf[0] == '1') online = 1;
     }
-    
-    // If on battery, decrease battery level
-    if (!current_state.on_ac_power) {
-        current_state.battery_level -= 0.1;
-        if (current_state.battery_level < 0) current_state.battery_level = 0;
-    } else {
-        // If on AC, charge battery
-        current_state.battery_level += 0.2;
-        if (current_state.battery_level > 100) current_state.battery_level = 100;
+
+    int discharging = 0;
+    double capacity = 0.0;
+    int num_read = 0;
+    for (int i = 0; i < num_batteries; i++) {
+        if (read_proc_file(&battery_capacity[i], buf, sizeof(buf)) > 0) {
+            capacity += atof(buf);
+            num_read++;
+        }
+        if (read_proc_file(&battery_status[i], buf, sizeof(buf)) > 0 &&
+            strncmp(buf, "Discharging", 11) == 0) {
+            discharging = 1;
+        }
     }
+
+    current_state.on_ac_power = num_mains > 0 ? online : !discharging;
+    current_state.battery_level = num_read > 0 ? capacity / num_read : 100.0;
+}
+
+// avg10 of the "some" or "full" line of a PSI file, in percent
+static float parse_pressure(const char *buf, const char *line_key) {
+    const char *line = find_field(buf, line_key);
+    if (!line) return 0.0f;
+
+    const char *avg10 = strstr(line, "avg10=");
+    return avg10 ? strtof(avg10 + 6, NULL) : 0.0f;
+}
+
+static void update_core_usage(HardwareState *hw) {
+    static char buf[PROC_STAT_BUF_SIZE];
+    static unsigned long long prev_total[HW_MAX_CPUS];
+    static unsigned long long prev_idle[HW_MAX_CPUS];
+
+    if (read_proc_file(&proc_stat, buf, sizeof(buf)) < 0) return;
+
+    // The aggregate "cpu " line comes first; per-core lines follow it
+    int cores = 0;
+    for (const char *line = next_line(buf); strncmp(line, "cpu", 3) == 0 && cores < HW_MAX_CPUS;
+         line = next_line(line)) {
+        const char *p = line + 3;
+        int cpu = (int)parse_ull(&p);
+        if (cpu >= HW_MAX_CPUS) break;
+
+        unsigned long long fields[8];
+        unsigned long long total = 0;
+        for (int i = 0; i < 8; i++) {
+            fields[i] = parse_ull(&p);
+            total += fields[i];
+        }
+        unsigned long long idle = fields[3] + fields[4];
+
+        unsigned long long d_total = counter_delta(total, prev_total[cpu]);
+        unsigned long long d_idle = counter_delta(idle, prev_idle[cpu]);
+        int primed = prev_total[cpu] != 0;
+        prev_total[cpu] = total;
+        prev_idle[cpu] = idle;
+
+        hw->core_usage[cpu] = primed && d_total
+            ? (float)clamp_unit(1.0 - (double)d_idle / (double)d_total) : 0.0f;
+        if (cpu + 1 > cores) cores = cpu + 1;
+    }
+    hw->num_cpus = cores;
+}
+
+// NUMA node meminfo has no MemAvailable; free plus inactive page cache is
+// what the node can hand out without reclaiming active memory
+static void update_node_memory(HardwareState *hw) {
+    static char buf[NODE_MEMINFO_BUF_SIZE];
+
+    for (int node = 0; node < num_numa_nodes; node++) {
+        if (read_proc_file(&node_meminfo[node], buf, sizeof(buf)) < 0) continue;
+
+        // Lines read "Node <n> <Field>: <kB> kB"
+        char key[32];
+        const char *p;
+        snprintf(key, sizeof(key), "Node %d MemTotal:", node);
+        unsigned long long total_kb = (p = find_field(buf, key)) ? parse_ull(&p) : 0;
+        snprintf(key, sizeof(key), "Node %d MemFree:", node);
+        unsigned long long free_kb = (p = find_field(buf, key)) ? parse_ull(&p) : 0;
+        snprintf(key, sizeof(key), "Node %d Inactive(file):", node);
+        unsigned long long inactive_kb = (p = find_field(buf, key)) ? parse_ull(&p) : 0;
+
+        if (total_kb) {
+            hw->node_memory_usage[node] = (float)clamp_unit(1.0 - (double)(free_kb + inactive_kb) / (double)total_kb);
+        }
+    }
+    hw->num_numa_nodes = num_numa_nodes;
+}
+
+static void update_cpufreq(HardwareState *hw) {
+    char buf[SYSFS_VALUE_BUF_SIZE];
+    double sum = 0.0;
+    double min = 1.0;
+    int policies = 0;
+
+    for (int i = 0; i < num_cpufreq_policies; i++) {
+        if (read_proc_file(&cpufreq_cur[i], buf, sizeof(buf)) <= 0) continue;
+
+        double ratio = clamp_unit(atof(buf) / cpufreq_max_khz[i]);
+        sum += ratio;
+        if (ratio < min) min = ratio;
+        policies++;
+    }
+
+    // Without cpufreq, report the cores as running at full speed
+    hw->cpufreq_mean_ratio = policies ? (float)(sum / policies) : 1.0f;
+    hw->cpufreq_min_ratio = policies ? (float)min : 1.0f;
+}
+
+static void update_thermal(HardwareState *hw) {
+    char buf[SYSFS_VALUE_BUF_SIZE];
+    float hottest = 0.0f;
+
+    for (int i = 0; i < num_thermal_zones; i++) {
+        if (read_proc_file(&thermal_zones[i], buf, sizeof(buf)) <= 0) continue;
+
+        float celsius = (float)atol(buf) / 1000.0f;   // Millidegrees
+        if (celsius > hottest) hottest = celsius;
+    }
+    hw->thermal_max_celsius = hottest;
+}
+
+void update_hardware_state(HardwareState *hw) {
+    static char buf[PROC_PRESSURE_BUF_SIZE];
+    float *pressure[NUM_PRESSURE_FILES][2] = {
+        { &hw->psi_cpu_some, NULL },
+        { &hw->psi_memory_some, &hw->psi_memory_full },
+        { &hw->psi_io_some, &hw->psi_io_full },
+    };
+
+    for (int i = 0; i < NUM_PRESSURE_FILES; i++) {
+        if (read_proc_file(&proc_pressure[i], buf, sizeof(buf)) < 0) continue;
+        *pressure[i][0] = parse_pressure(buf, "some ");
+        if (pressure[i][1]) *pressure[i][1] = parse_pressure(buf, "full ");
+    }
+
+    update_core_usage(hw);
+    update_node_memory(hw);
+    update_cpufreq(hw);
+    update_thermal(hw);
+
+    ServiceLoad load;
+    get_service_load(&load);
+    hw->service_cpu_max = load.cpu_max;
+    hw->service_cpu_throttled = load.cpu_throttled;
+    hw->service_io_mib_per_s = load.io_mib_per_s;
+    hw->service_rss_max = load.rss_max;
 }
 
-void record_state_update() {
-    // In a real implementation, this would record the state for learning
-    // For this prototype, just print the action
-    printf("Recording system state update\n");
+void record_state_update(const SystemState *state, const HardwareState *hardware) {
+    // Append to the in-memory history the learning engine queries, and to
+    // the learning log for training
+    state_history_append(state);
+    learning_log_state(LOG_PRODUCER_MONITOR, state, hardware);
 }
\ No newline at end of file
@@ -17,10 +17,51 @@ typedef struct {
     int on_ac_power;           // Whether on AC power (1) or battery (0)
 } SystemState;
 
+// Limits of the per-core and per-node hardware features; cores and nodes
+// beyond them are not reported
+#define HW_MAX_CPUS 64
+#define HW_MAX_NUMA_NODES 8
+
+// Hardware state sampled alongside SystemState. It is kept separately
+// because it is only needed to build model inputs: the state history keeps
+// SystemState alone, while the learning log records both.
+typedef struct {
+    float psi_cpu_some;                     // PSI avg10 stall percentages (0.0 to 100.0)
+    float psi_memory_some;
+    float psi_memory_full;
+    float psi_io_some;
+    float psi_io_full;
+    float cpufreq_mean_ratio;               // Current / maximum frequency, mean over policies
+    float cpufreq_min_ratio;                // ... and of the slowest policy (throttling)
+    float thermal_max_celsius;              // Hottest thermal zone
+    float node_memory_usage[HW_MAX_NUMA_NODES]; // Used fraction of each NUMA node's memory
+    float core_usage[HW_MAX_CPUS];          // Per-core utilization (0.0 to 1.0)
+    float service_cpu_max;                  // Governed services, from process telemetry:
+    float service_cpu_throttled;            // see ServiceLoad
+    float service_io_mib_per_s;
+    float service_rss_max;
+    int num_numa_nodes;                     // Nodes and cores reported above
+    int num_cpus;
+} HardwareState;
+
+// Metric groups that can be sampled independently
+#define METRIC_CPU        0x01
+#define METRIC_MEMORY     0x02
+#define METRIC_IO         0x04
+#define METRIC_NETWORK    0x08
+#define METRIC_PROCESSES  0x10
+#define METRIC_USERS      0x20
+#define METRIC_POWER      0x40
+#define METRIC_HARDWARE   0x80
+#define METRIC_ALL        0xff
+
 // Function prototypes
 void init_system_state();
 SystemState get_current_system_state();
+HardwareState get_current_hardware_state();
+void get_published_state(SystemState *state, HardwareState *hardware);
 void update_system_state();
+void update_system_state_metrics(unsigned int metrics);
 
 // Helper functions
 double get_cpu_usage();
@@ -30,6 +71,7 @@ double get_network_usage();
 int count_processes();
 int count_users();
 void update_power_state();
-void record_state_update();
+void update_hardware_state(HardwareState *hw);
+void record_state_update(const SystemState *state, const HardwareState *hardware);
 
 #endif /* SYSTEM_STATE_H */
\ No newline at end of file
@@ -0,0 +1,121 @@
+// ai_sched: weighted virtual-time sched_ext scheduler
+//
+// Every task runs from one of two global dispatch queues ordered by virtual
+// time: latency-critical tasks from their own queue, always drained first,
+// the rest from a shared one. Virtual time advances by the CPU time used,
+// divided by the task's weight. Weight, slice and latency flag come from
+// task_params (see ai_sched.h), which ai_init fills from its process
+// adjustments, so scheduling never waits on userspace.
+
+#include <scx/common.bpf.h>
+#include "ai_sched.h"
+
+char _license[] SEC("license") = "GPL";
+
+UEI_DEFINE(uei);
+
+#define SHARED_DSQ 0
+#define LATENCY_DSQ 1
+
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __uint(max_entries, AI_SCHED_MAX_TASKS);
+    __type(key, u32);
+    __type(value, struct ai_sched_params);
+} task_params SEC(".maps");
+
+// Virtual time of the most recently started task
+static u64 vtime_now;
+
+static const struct ai_sched_params *lookup_params(const struct task_struct *p)
+{
+    u32 tgid = p->tgid;
+    return bpf_map_lookup_elem(&task_params, &tgid);
+}
+
+static u64 task_slice(const struct ai_sched_params *params)
+{
+    return params && params->slice_ns ? params->slice_ns : SCX_SLICE_DFL;
+}
+
+static u32 task_weight(const struct task_struct *p, const struct ai_sched_params *params)
+{
+    if (params && params->weight) return params->weight;
+    return p->scx.weight ? p->scx.weight : AI_SCHED_WEIGHT_DEFAULT;
+}
+
+s32 BPF_STRUCT_OPS(ai_sched_select_cpu, struct task_struct *p, s32 prev_cpu, u64 wake_flags)
+{
+    bool is_idle = false;
+    s32 cpu = scx_bpf_select_cpu_dfl(p, prev_cpu, wake_flags, &is_idle);
+
+    // An idle CPU runs the task directly, skipping the global queues
+    if (is_idle) scx_bpf_dsq_insert(p, SCX_DSQ_LOCAL, task_slice(lookup_params(p)), 0);
+    return cpu;
+}
+
+void BPF_STRUCT_OPS(ai_sched_enqueue, struct task_struct *p, u64 enq_flags)
+{
+    const struct ai_sched_params *params = lookup_params(p);
+    u64 vtime = p->scx.dsq_vtime;
+
+    // A task that slept does not bank more than one slice of credit
+    if (time_before(vtime, vtime_now - SCX_SLICE_DFL)) vtime = vtime_now - SCX_SLICE_DFL;
+
+    if (params && (params->flags & AI_SCHED_LATENCY_CRITICAL)) {
+        scx_bpf_dsq_insert_vtime(p, LATENCY_DSQ, task_slice(params), vtime, enq_flags);
+        // No CPU was idle at select_cpu time: make room on the task's CPU
+        scx_bpf_kick_cpu(scx_bpf_task_cpu(p), SCX_KICK_PREEMPT);
+        return;
+    }
+    scx_bpf_dsq_insert_vtime(p, SHARED_DSQ, task_slice(params), vtime, enq_flags);
+}
+
+void BPF_STRUCT_OPS(ai_sched_dispatch, s32 cpu, struct task_struct *prev)
+{
+    if (!scx_bpf_dsq_move_to_local(LATENCY_DSQ)) scx_bpf_dsq_move_to_local(SHARED_DSQ);
+}
+
+void BPF_STRUCT_OPS(ai_sched_running, struct task_struct *p)
+{
+    if (time_before(vtime_now, p->scx.dsq_vtime)) vtime_now = p->scx.dsq_vtime;
+}
+
+void BPF_STRUCT_OPS(ai_sched_stopping, struct task_struct *p, bool runnable)
+{
+    const struct ai_sched_params *params = lookup_params(p);
+    u64 slice = task_slice(params);
+
+    // The slice counts down while the task runs; its parameters may have
+    // changed since it started, so clamp
+    u64 used = slice > p->scx.slice ? slice - p->scx.slice : 0;
+    p->scx.dsq_vtime += used * AI_SCHED_WEIGHT_DEFAULT / task_weight(p, params);
+}
+
+void BPF_STRUCT_OPS(ai_sched_enable, struct task_struct *p)
+{
+    p->scx.dsq_vtime = vtime_now;
+}
+
+s32 BPF_STRUCT_OPS_SLEEPABLE(ai_sched_init)
+{
+    s32 ret = scx_bpf_create_dsq(SHARED_DSQ, -1);
+    if (ret) return ret;
+    return scx_bpf_create_dsq(LATENCY_DSQ, -1);
+}
+
+void BPF_STRUCT_OPS(ai_sched_exit, struct scx_exit_info *ei)
+{
+    UEI_RECORD(uei, ei);
+}
+
+SCX_OPS_DEFINE(ai_sched_ops,
+               .select_cpu = (void *)ai_sched_select_cpu,
+               .enqueue = (void *)ai_sched_enqueue,
+               .dispatch = (void *)ai_sched_dispatch,
+               .running = (void *)ai_sched_running,
+               .stopping = (void *)ai_sched_stopping,
+               .enable = (void *)ai_sched_enable,
+               .init = (void *)ai_sched_init,
+               .exit = (void *)ai_sched_exit,
+               .name = "ai_sched");
@@ -0,0 +1,80 @@
+// ai_sched loader: attaches the sched_ext scheduler and pins its task map
+//
+// Runs as an ai_init service. The map is pinned at AI_SCHED_TASK_MAP and
+// left pinned on exit, so the parameters ai_init wrote survive a scheduler
+// restart; when the scheduler exits or is killed, the kernel falls back to
+// the fair scheduler.
+
+#include <errno.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <bpf/bpf.h>
+#include <scx/common.h>
+#include "ai_sched.h"
+#include "ai_sched.bpf.skel.h"
+
+static volatile sig_atomic_t exit_requested = 0;
+
+static void handle_signal(int sig) {
+    (void)sig;
+    exit_requested = 1;
+}
+
+// Tell the service manager the scheduler is attached (sd_notify protocol)
+static void notify_ready() {
+    const char *path = getenv("NOTIFY_SOCKET");
+    if (!path || !*path) return;
+
+    struct sockaddr_un addr;
+    size_t len = strlen(path);
+    if (len >= sizeof(addr.sun_path)) return;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, len);
+    if (addr.sun_path[0] == '@') addr.sun_path[0] = '\0';
+
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    sendto(fd, "READY=1", 7, 0, (struct sockaddr *)&addr, offsetof(struct sockaddr_un, sun_path) + len);
+    close(fd);
+}
+
+int main() {
+    signal(SIGINT, handle_signal);
+    signal(SIGTERM, handle_signal);
+
+    if (mkdir(AI_SCHED_PIN_DIR, 0700) < 0 && errno != EEXIST) {
+        fprintf(stderr, "ai_sched: cannot create %s: %s\n", AI_SCHED_PIN_DIR, strerror(errno));
+        return 1;
+    }
+
+    struct ai_sched *skel = SCX_OPS_OPEN(ai_sched_ops, ai_sched);
+
+    // An existing pin is reused at load time rather than replaced
+    if (bpf_map__set_pin_path(skel->maps.task_params, AI_SCHED_TASK_MAP) < 0) {
+        fprintf(stderr, "ai_sched: cannot pin task map at %s\n", AI_SCHED_TASK_MAP);
+        ai_sched__destroy(skel);
+        return 1;
+    }
+
+    SCX_OPS_LOAD(skel, ai_sched_ops, ai_sched, uei);
+    struct bpf_link *link = SCX_OPS_ATTACH(skel, ai_sched_ops, ai_sched);
+
+    notify_ready();
+    fprintf(stderr, "ai_sched: attached, task map at %s\n", AI_SCHED_TASK_MAP);
+
+    while (!exit_requested && !UEI_EXITED(skel, uei)) sleep(1);
+
+    bpf_link__destroy(link);
+    int ecode = UEI_REPORT(skel, uei);
+    ai_sched__destroy(skel);
+    return ecode < 0 ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+#ifndef AI_SCHED_H
+#define AI_SCHED_H
+
+// Interface between the ai_sched sched_ext scheduler and ai_init, shared by
+// the BPF program and userspace
+//
+// ai_init writes one ai_sched_params entry per managed process into the
+// task_params hash map, keyed by tgid, in batches at each decision tick.
+// The scheduler reads it on every enqueue; processes without an entry are
+// scheduled by their nice weight with the default slice.
+
+#ifndef __VMLINUX_H__
+#include <linux/types.h>
+#endif
+
+// The loader pins the map here; a restarted scheduler reuses the pinned
+// map, so ai_init's entries survive it
+#define AI_SCHED_PIN_DIR "/sys/fs/bpf/ai_sched"
+#define AI_SCHED_TASK_MAP AI_SCHED_PIN_DIR "/task_params"
+
+#define AI_SCHED_MAX_TASKS 4096
+
+// Weights use the sched_ext scale: 100 is nice 0, 1 to 10000
+#define AI_SCHED_WEIGHT_DEFAULT 100
+#define AI_SCHED_WEIGHT_MAX 10000
+
+// Flags
+#define AI_SCHED_LATENCY_CRITICAL 0x1   // Queued ahead of other tasks, preempting if no CPU is idle
+
+struct ai_sched_params {
+    __u32 weight;
+    __u32 flags;
+    __u64 slice_ns;                     // 0 for the default slice
+};
+
+#endif /* AI_SCHED_H */